@@ -0,0 +1,326 @@
+/*******************************************************************************
+ *                                                                             *
+ *  @file   libplate.c                                                         *
+ *  @author Christos Kaldis                                                    *
+ *  @date   17 Sept 2025                                                       *
+ *                                                                             *
+ *  @brief      libplate, the API of plate.h over the solver core.             *
+ *  @details    Built with plate_solver.c into bin/libplate.a and              *
+ *  bin/libplate.so by 'make lib'; it has no program of its own.               *
+ *                                                                             *
+ ******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "plate.h"
+#include "plate_solver.h"
+
+void setup_library(void);
+void start_steps(const Plate_context_t * context);
+void share_threads(const Plate_context_t * context);
+void stop_steps(void);
+
+/*  The libplate context, see plate.h. cells and lines are the doubles of
+    one grid and the rows of partial sums its allocation has room for. */
+struct plate_context_t {
+    Plate_t plate;
+    size_t cells;
+    int lines;
+    int threads;
+    long time;
+};
+
+/*  select_kernel runs once, for the first context. */
+static pthread_once_t library_once = PTHREAD_ONCE_INIT;
+
+/*  The default OpenMP team size, and the contexts stepping right now,
+    which share it when they were created with 0 threads. */
+static int library_threads = 1;
+static int library_stepping = 0;
+
+/**
+ * @brief Sets up libplate: picks the row kernel of this CPU and notes the
+ * default team size.
+ */
+void setup_library(void) {
+    select_kernel("auto");
+#ifdef _OPENMP
+    library_threads = omp_get_max_threads();
+#endif
+
+    return;
+}
+
+/**
+ * @brief Counts a context as stepping and sets the calling thread's team
+ * size for it, see share_threads.
+ *
+ * @param[in] context The context.
+ */
+void start_steps(const Plate_context_t * context) {
+    __atomic_add_fetch(&library_stepping, 1, __ATOMIC_RELAXED);
+    share_threads(context);
+
+    return;
+}
+
+/**
+ * @brief Sets the calling thread's team size for a context.
+ * @details A context of 0 threads gets an even share of the default team
+ * size among the contexts stepping now, at least one thread, so contexts
+ * stepped at the same time do not oversubscribe the machine.
+ *
+ * @param[in] context The context.
+ */
+void share_threads(const Plate_context_t * context) {
+#ifdef _OPENMP
+    int threads = context->threads;
+
+    if (threads == 0) {
+        threads = library_threads /
+            __atomic_load_n(&library_stepping, __ATOMIC_RELAXED);
+        if (threads < 1)
+            threads = 1;
+    }
+    if (threads != omp_get_max_threads())
+        omp_set_num_threads(threads);
+#else
+    (void) context;
+#endif
+
+    return;
+}
+
+/**
+ * @brief Counts a context as no longer stepping.
+ */
+void stop_steps(void) {
+    __atomic_sub_fetch(&library_stepping, 1, __ATOMIC_RELAXED);
+
+    return;
+}
+
+/**
+ * @brief Creates a libplate context, see plate.h.
+ * @details Its plate has two grids and is zero until plate_init.
+ *
+ * @param[in] rows Rows of the plate, 3 or more.
+ * @param[in] cols Columns of the plate, 3 or more.
+ * @param[in] threads OpenMP threads of a step, or 0 for a share of the
+ * default, see share_threads.
+ *
+ * @return The context, or NULL.
+ */
+Plate_context_t * plate_create(int rows, int cols, int threads) {
+    Plate_context_t * context;
+
+    if (rows < 3 || cols < 3 || threads < 0)
+        return NULL;
+    pthread_once(&library_once, setup_library);
+    context = calloc(1, sizeof(Plate_context_t));
+    if (context == NULL)
+        return NULL;
+    if (create_plate(&context->plate, rows, cols, 2) != EXIT_SUCCESS) {
+        free(context);
+        return NULL;
+    }
+    context->cells = (size_t) context->plate.pitch * rows;
+    context->lines = rows;
+    context->threads = threads;
+
+    return context;
+}
+
+/**
+ * @brief Starts a job on a libplate context, see plate.h.
+ * @details If both grids of the new size fit in the allocation the
+ * context has, they are laid out in it again and nothing is allocated.
+ * Otherwise a new plate replaces the old one.
+ *
+ * @param[in,out] context The context.
+ * @param[in] rows Rows of the plate, 3 or more.
+ * @param[in] cols Columns of the plate, 3 or more.
+ * @param[in] boundary The temperatures of the edges and the interior.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the size is invalid or the
+ * plate could not be allocated.
+ */
+int plate_init(
+    Plate_context_t * context, int rows, int cols,
+    const Plate_boundary_t * boundary
+) {
+    const int line = PLATE_ALIGN / sizeof(double);
+    const int pitch = (PLATE_LEAD + cols + line - 1) / line * line;
+    Plate_t * plate = &context->plate;
+    Boundary_t edges;
+    Plate_t grown;
+
+    if (rows < 3 || cols < 3)
+        return EXIT_FAILURE;
+    if ((size_t) pitch * rows <= context->cells && rows <= context->lines) {
+        /*  The second grid moves to where the first one ends. */
+        plate->rows = rows;
+        plate->cols = cols;
+        plate->pitch = pitch;
+        plate->grid[1] = plate->grid[0] + (size_t) pitch * rows;
+    } else {
+        if (create_plate(&grown, rows, cols, 2) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        destroy_plate(plate);
+        *plate = grown;
+        context->cells = (size_t) pitch * rows;
+        context->lines = rows;
+    }
+    plate->current = 0;
+    context->time = 0;
+
+    edges.top = boundary->top;
+    edges.bottom = boundary->bottom;
+    edges.left = boundary->left;
+    edges.right = boundary->right;
+    edges.inner = boundary->inner;
+    /*  Only the volumes of the simulation have faces. */
+    edges.front = edges.back = 0;
+    start_steps(context);
+    init_plate(plate, &edges);
+    stop_steps();
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Advances a libplate context, see plate.h.
+ * @details Only the last step measures the change. The context's thread
+ * count becomes that of the calling thread's OpenMP regions.
+ *
+ * @param[in,out] context The context.
+ * @param[in] steps The time steps to take.
+ *
+ * @return The total absolute change of the last step, or 0 if steps is
+ * not positive.
+ */
+double plate_step(Plate_context_t * context, int steps) {
+    double change = 0;
+    int t;
+
+    start_steps(context);
+    for (t = 0; t < steps; t++) {
+        share_threads(context);
+        change = stencil_step(&context->plate, t == steps - 1);
+    }
+    stop_steps();
+    if (steps > 0)
+        context->time += steps;
+
+    return change;
+}
+
+/**
+ * @brief Steps a libplate context to a tolerance, see plate.h.
+ * @details The test of the simulation's default l1 norm: the total
+ * absolute change of a step below the tolerance.
+ *
+ * @param[in,out] context The context.
+ * @param[in] tolerance The change at which the plate has converged.
+ * @param[in] max_steps The most steps to take.
+ * @param[out] change The change of the last step, or NULL.
+ *
+ * @return The steps taken.
+ */
+long plate_solve(
+    Plate_context_t * context, double tolerance, long max_steps,
+    double * change
+) {
+    double last = 0;
+    long steps = 0;
+
+    start_steps(context);
+    while (steps < max_steps) {
+        share_threads(context);
+        last = calc_temp(&context->plate);
+        steps++;
+        if (last < tolerance)
+            break;
+    }
+    stop_steps();
+    context->time += steps;
+    if (change != NULL)
+        *change = last;
+
+    return steps;
+}
+
+/**
+ * @brief Copies the plate of a libplate context, see plate.h.
+ *
+ * @param[in] context The context.
+ * @param[out] cells Room for rows * cols doubles.
+ */
+void plate_snapshot(const Plate_context_t * context, double * cells) {
+    const Plate_t * plate = &context->plate;
+    const double * data = plate_data(plate);
+    int i;
+
+    for (i = 0; i < plate->rows; i++) {
+        memcpy(
+            cells + (size_t) i * plate->cols,
+            data + (size_t) i * plate->pitch, sizeof(double) * plate->cols
+        );
+    }
+
+    return;
+}
+
+/**
+ * @brief Rows of the plate of a libplate context.
+ *
+ * @param[in] context The context.
+ *
+ * @return The rows, edges included.
+ */
+int plate_rows(const Plate_context_t * context) {
+    return context->plate.rows;
+}
+
+/**
+ * @brief Columns of the plate of a libplate context.
+ *
+ * @param[in] context The context.
+ *
+ * @return The columns, edges included.
+ */
+int plate_cols(const Plate_context_t * context) {
+    return context->plate.cols;
+}
+
+/**
+ * @brief Time steps taken by a libplate context since plate_init.
+ *
+ * @param[in] context The context.
+ *
+ * @return The steps.
+ */
+long plate_time(const Plate_context_t * context) {
+    return context->time;
+}
+
+/**
+ * @brief Frees a libplate context, see plate.h.
+ *
+ * @param[in] context The context, or NULL.
+ */
+void plate_destroy(Plate_context_t * context) {
+    if (context == NULL)
+        return;
+    destroy_plate(&context->plate);
+    free(context);
+
+    return;
+}
@@ -0,0 +1,271 @@
+/*******************************************************************************
+ *                                                                             *
+ *  @file   libplate_test.c                                                    *
+ *  @author Christos Kaldis                                                    *
+ *  @date   17 Sept 2025                                                       *
+ *                                                                             *
+ *  @brief      Checks libplate against the plate heat simulation.             *
+ *  @details    Solves the plate of a raw snapshot file written by the         *
+ *  simulation and compares the final frame bit for bit. Then runs jobs of     *
+ *  several sizes on TEST_CONTEXTS contexts, first one after the other and     *
+ *  then all at once, one thread each, and compares those bit for bit too.     *
+ *  Run by 'make test-lib' against both the static and the shared library.     *
+ *                                                                             *
+ ******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "plate.h"
+#include "plate_snapshot.h"
+
+/*  Contexts run at the same time, and the jobs each of them runs. */
+#define TEST_CONTEXTS 8
+#define TEST_JOBS 3
+
+/*  The largest plate of a job, see run_jobs. */
+#define TEST_ROWS (40 + TEST_CONTEXTS)
+#define TEST_COLS 50
+
+#define TEST_TOLERANCE 1.0
+#define TEST_STEPS 1000000L
+
+/*  The jobs of one context and what they gave. */
+typedef struct test_context_t {
+    int index;
+    int failed;
+    long steps[TEST_JOBS];
+    double cells[TEST_JOBS][TEST_ROWS * TEST_COLS];
+} Test_context_t;
+
+int check_snapshot(const char * path);
+int read_last_frame(
+    const char * path, Snapshot_header_t * header, int64_t * time,
+    double ** cells
+);
+int check_contexts(void);
+void * run_jobs(void * argument);
+
+
+int main(int argc, char * argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s SNAPSHOT\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (check_snapshot(argv[1]) != EXIT_SUCCESS ||
+        check_contexts() != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    puts("libplate: all checks passed");
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Solves the plate of a snapshot file and compares it with the
+ * file's last frame.
+ * @details The simulation's default run stops on the same l1 change as
+ * plate_solve, so the steps must be the time of the frame and the cells
+ * must be equal bit for bit.
+ *
+ * @param[in] path A raw snapshot file of a default run.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE after printing the difference.
+ */
+int check_snapshot(const char * path) {
+    Snapshot_header_t header;
+    Plate_boundary_t boundary;
+    Plate_context_t * context;
+    double * expected, * cells;
+    int64_t time;
+    long steps;
+    size_t count;
+    int status = EXIT_SUCCESS;
+
+    if (read_last_frame(path, &header, &time, &expected) != EXIT_SUCCESS) {
+        fprintf(stderr, "'%s' is not a raw snapshot file.\n", path);
+        return EXIT_FAILURE;
+    }
+    count = (size_t) header.rows * header.cols;
+    boundary.top = header.temp_top;
+    boundary.bottom = header.temp_bottom;
+    boundary.left = header.temp_left;
+    boundary.right = header.temp_right;
+    boundary.inner = header.temp_inner;
+
+    cells = malloc(sizeof(double) * count);
+    context = plate_create(header.rows, header.cols, 0);
+    if (cells == NULL || context == NULL ||
+        plate_init(context, header.rows, header.cols, &boundary)
+            != EXIT_SUCCESS) {
+        fputs("Could not create the plate.\n", stderr);
+        plate_destroy(context);
+        free(cells);
+        free(expected);
+        return EXIT_FAILURE;
+    }
+    steps = plate_solve(context, TEST_TOLERANCE, TEST_STEPS, NULL);
+    plate_snapshot(context, cells);
+    if (steps != time || memcmp(cells, expected, sizeof(double) * count)) {
+        fprintf(stderr, "The %u x %u plate took %ld steps and differs from "
+            "the simulation's, which took %ld.\n", header.rows, header.cols,
+            steps, (long) time);
+        status = EXIT_FAILURE;
+    } else {
+        printf("libplate: %u x %u plate as the simulation's, %ld steps\n",
+            header.rows, header.cols, steps);
+    }
+    plate_destroy(context);
+    free(cells);
+    free(expected);
+
+    return status;
+}
+
+/**
+ * @brief Reads the header and the last frame of a raw snapshot file.
+ *
+ * @param[in] path The file.
+ * @param[out] header Its header.
+ * @param[out] time The time of the last frame.
+ * @param[out] cells The cells of the last frame, to be freed.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or is
+ * not a raw snapshot with at least one frame.
+ */
+int read_last_frame(
+    const char * path, Snapshot_header_t * header, int64_t * time,
+    double ** cells
+) {
+    FILE * file = fopen(path, "rb");
+    Snapshot_frame_t frame;
+    size_t bytes;
+    int found = 0;
+
+    *cells = NULL;
+    if (file == NULL)
+        return EXIT_FAILURE;
+    if (fread(header, sizeof(*header), 1, file) != 1 ||
+        memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->byte_order != SNAPSHOT_BYTE_ORDER ||
+        header->encoding != SNAPSHOT_RAW || header->rows < 3 ||
+        header->cols < 3) {
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    bytes = sizeof(double) * header->rows * header->cols;
+    *cells = malloc(bytes);
+    while (*cells != NULL && fread(&frame, sizeof(frame), 1, file) == 1) {
+        if (frame.encoding != SNAPSHOT_RAW || frame.size != bytes ||
+            fread(*cells, bytes, 1, file) != 1) {
+            found = 0;
+            break;
+        }
+        *time = frame.time;
+        found = 1;
+    }
+    fclose(file);
+    if (!found) {
+        free(*cells);
+        *cells = NULL;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Runs the jobs of TEST_CONTEXTS contexts one after the other, then
+ * all at once, and compares the two.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE after printing the first
+ * difference.
+ */
+int check_contexts(void) {
+    static Test_context_t serial[TEST_CONTEXTS], concurrent[TEST_CONTEXTS];
+    pthread_t thread[TEST_CONTEXTS];
+    int c, j, started;
+
+    for (c = 0; c < TEST_CONTEXTS; c++) {
+        serial[c].index = concurrent[c].index = c;
+        run_jobs(&serial[c]);
+    }
+    for (started = 0; started < TEST_CONTEXTS; started++) {
+        if (pthread_create(
+                &thread[started], NULL, run_jobs, &concurrent[started]
+            ) != 0)
+            break;
+    }
+    for (c = 0; c < started; c++) {
+        pthread_join(thread[c], NULL);
+    }
+    if (started < TEST_CONTEXTS) {
+        fputs("Could not start the threads.\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    for (c = 0; c < TEST_CONTEXTS; c++) {
+        if (serial[c].failed || concurrent[c].failed) {
+            fprintf(stderr, "Context %d could not be allocated.\n", c);
+            return EXIT_FAILURE;
+        }
+        for (j = 0; j < TEST_JOBS; j++) {
+            if (serial[c].steps[j] != concurrent[c].steps[j] || memcmp(
+                    serial[c].cells[j], concurrent[c].cells[j],
+                    sizeof(serial[c].cells[j])
+                ) != 0) {
+                fprintf(stderr, "Job %d of context %d differs when the "
+                    "contexts run at the same time.\n", j, c);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    printf("libplate: %d contexts at once as one after the other\n",
+        TEST_CONTEXTS);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief The jobs of one context, on one thread.
+ * @details The sizes shrink and grow again, so the context reuses its
+ * grids and then has to replace them; every context has its own sizes
+ * and interior temperature.
+ *
+ * @param[in,out] argument The Test_context_t.
+ *
+ * @return NULL.
+ */
+void * run_jobs(void * argument) {
+    Test_context_t * test = argument;
+    Plate_boundary_t boundary = { 2, 3, 4, -5, 1 };
+    Plate_context_t * context;
+    int j, rows, cols;
+
+    memset(test->cells, 0, sizeof(test->cells));
+    context = plate_create(TEST_ROWS / 2, TEST_COLS, 1);
+    if (context == NULL) {
+        test->failed = 1;
+        return NULL;
+    }
+    for (j = 0; j < TEST_JOBS; j++) {
+        rows = j == 1 ? 20 + test->index : 40 + test->index;
+        cols = j == 2 ? TEST_COLS : TEST_COLS - 10;
+        boundary.inner = test->index;
+        if (plate_init(context, rows, cols, &boundary) != EXIT_SUCCESS) {
+            test->failed = 1;
+            break;
+        }
+        test->steps[j] = plate_solve(
+            context, TEST_TOLERANCE, TEST_STEPS, NULL
+        );
+        plate_snapshot(context, test->cells[j]);
+    }
+    plate_destroy(context);
+
+    return NULL;
+}
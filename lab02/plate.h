@@ -0,0 +1,89 @@
+/*******************************************************************************
+ *                                                                             *
+ *  @file   plate.h                                                            *
+ *  @author Christos Kaldis                                                    *
+ *  @date   17 Sept 2025                                                       *
+ *                                                                             *
+ *  @brief      libplate, the explicit solver of the plate heat simulation     *
+ *              as a library.                                                  *
+ *  @details    A Plate_context_t holds one plate and the state of its run.    *
+ *  Create it once, then plate_init it for every job: a job of the same or a   *
+ *  smaller size reuses its grids. Contexts share nothing, so any number of    *
+ *  them may be stepped at the same time, each from its own thread; a single   *
+ *  context must not be used by two threads at once. Build with 'make', which  *
+ *  makes bin/libplate.a and bin/libplate.so; a program linking the static     *
+ *  library also needs -fopenmp -pthread -lm.                                  *
+ *                                                                             *
+ ******************************************************************************/
+
+#ifndef PLATE_H
+#define PLATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*  Only the functions below are exported from libplate. */
+#if defined(__GNUC__)
+#define PLATE_API __attribute__((visibility("default")))
+#else
+#define PLATE_API
+#endif
+
+/*  A plate and its solver. Opaque, see plate_create. */
+typedef struct plate_context_t Plate_context_t;
+
+/*  The edge temperatures of a plate and the starting temperature of its
+    interior. The corners are the average of their two edges. */
+typedef struct plate_boundary_t {
+    double top;
+    double bottom;
+    double left;
+    double right;
+    double inner;
+} Plate_boundary_t;
+
+/*  A context for rows x cols plates, edges included, both 3 or more.
+    threads is the number of OpenMP threads a step uses. With 0 the
+    contexts stepping at the same time share the default number
+    (OMP_NUM_THREADS, or one per core) evenly, at least one thread each,
+    so several of them do not oversubscribe the machine; a context
+    stepping alone uses all of it. NULL if it could not be allocated. */
+PLATE_API Plate_context_t * plate_create(int rows, int cols, int threads);
+
+/*  Starts a job: a rows x cols plate set to boundary, at time 0.
+    EXIT_SUCCESS, or EXIT_FAILURE if a larger plate could not be
+    allocated, which leaves the context as it was. */
+PLATE_API int plate_init(
+    Plate_context_t * context, int rows, int cols,
+    const Plate_boundary_t * boundary
+);
+
+/*  Advances the plate steps time steps. The total absolute change of the
+    last one. */
+PLATE_API double plate_step(Plate_context_t * context, int steps);
+
+/*  Steps until the total absolute change of a step is below tolerance or
+    max_steps steps have been taken. The steps taken; the last change is
+    stored in change unless it is NULL. */
+PLATE_API long plate_solve(
+    Plate_context_t * context, double tolerance, long max_steps,
+    double * change
+);
+
+/*  Copies the plate's rows x cols temperatures, row by row, to cells. */
+PLATE_API void plate_snapshot(const Plate_context_t * context, double * cells);
+
+/*  The size of the plate and the time steps taken since plate_init. */
+PLATE_API int plate_rows(const Plate_context_t * context);
+PLATE_API int plate_cols(const Plate_context_t * context);
+PLATE_API long plate_time(const Plate_context_t * context);
+
+/*  Frees the context. */
+PLATE_API void plate_destroy(Plate_context_t * context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
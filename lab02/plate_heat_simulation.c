@@ -11,313 +11,7784 @@
  *                                                                             *
  ******************************************************************************/
 
+#define _POSIX_C_SOURCE 200112L
+/*  madvise(MADV_DONTNEED) and ru_majflt for --out-of-core, and the CPU
+    affinity calls for --pin. */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <complex.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#ifdef PLATE_USE_FFTW
+#include <fftw3.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(PLATE_TRACE) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "plate_snapshot.h"
+#include "plate_solver.h"
+
+/*  Default plate size, overridable with --rows and --cols. */
+#define ROWS 10
+#define COLS 20
+
+#define PLATE_FLOAT_LEAD ((int) (PLATE_ALIGN / sizeof(float)) - 1)
+
+#define TEMP_TOP 2.0
+#define TEMP_BOTTOM 3.0
+#define TEMP_LEFT 4.0
+#define TEMP_RIGHT -5.0
+#define TEMP_INNER 1.0
+/*  The two extra faces of a --layers volume. */
+#define TEMP_FRONT 6.0
+#define TEMP_BACK 0.0
+
+/*  Ensemble plates are interleaved this many to a group, the widest
+    vector of doubles the kernels use. */
+#define ENSEMBLE_LANES 8
+
+/*  Default number of histogram bins (heat levels), see --bins. */
+#define HEAT_LEVELS 10
+#define THRESHOLD 1.0
+
+/*  Default rows of an --out-of-core band, see --band-rows. */
+#define BAND_ROWS 256
+
+/*  --bench: untimed and timed runs of every case, the shortest timed
+    run, the plate sizes measured by default, the slowdown against
+    --bench-baseline that counts as a regression, and the length of each
+    STREAM array. */
+#define BENCH_WARMUP 3
+#define BENCH_REPEATS 15
+#define BENCH_MIN_SECONDS 0.005
+#define BENCH_SIZES "128,512,2048"
+#define BENCH_TOLERANCE 0.10
+#define STREAM_CELLS (1 << 23)
+
+/*  --autotune: timed runs of every trial, and the cache file of the tuned
+    variants in the home directory. */
+#define TUNE_REPEATS 5
+#define TUNE_CACHE ".plate_heat_tune"
+
+/*  --daemon: plates kept for reuse by the workers, the step limit of a
+    job that does not set one, and the most cells of a job's plate. A
+    command line may be DAEMON_LINE bytes long, newline included, and
+    the queue holds at most DAEMON_JOBS jobs, DAEMON_CLIENT_JOBS of them
+    (queued or running) from any one client. */
+#define DAEMON_POOL 16
+#define DAEMON_STEPS 1000000
+#define DAEMON_CELLS (1 << 26)
+#define DAEMON_LINE 4096
+#define DAEMON_JOBS 1024
+#define DAEMON_CLIENT_JOBS 64
+
+/*  make TRACE=1: events kept per thread by the tracer, older ones are
+    overwritten, and the most threads that can record events. */
+#define TRACE_EVENTS (1 << 14)
+#define TRACE_THREADS 64
+
+/*  Time steps of every run of the --scaling report. */
+#define SCALING_STEPS 200
+
+/*  Default side of an active-set tile, in cells. */
+#define ACTIVE_TILE 64
+
+/*  Initial room for the convergence history; it grows as needed. */
+#define HISTORY_SIZE 64
+
+/*  Default time steps between two checkpoints, see --checkpoint-every. */
+#define CHECKPOINT_EVERY 1000
+#define CHECKPOINT_MAGIC "PLATECKP"
+#define CHECKPOINT_VERSION 2
+
+/*  What a published plate is for: the analysis printed at the user's
+    time step, a frame of the snapshot file, and whether a full pipeline
+    may drop it (see --pipeline-drop). */
+#define FRAME_REPORT 1
+#define FRAME_SNAPSHOT 2
+#define FRAME_KEEP 4
+
+/*  Default tile of the temporally blocked stencil. Two scratch copies of a
+    tile plus its halo should fit in a per-core L2 cache. */
+#define TILE_ROWS 32
+#define TILE_COLS 512
+
+/*  Multigrid: smoothing sweeps before and after the coarse correction,
+    the most levels a hierarchy can have, the cycles without a new lowest
+    residual after which the solver has stalled, and the most cycles. */
+#define MG_PRE_SWEEPS 2
+#define MG_POST_SWEEPS 2
+#define MG_MAX_LEVELS 32
+#define MG_STALL_CYCLES 5
+#define MG_MAX_CYCLES 1000
+
+/*  The same plate in single precision, for --precision float and mixed. */
+typedef struct plate_float_t {
+    int rows;
+    int cols;
+    int pitch;
+    float * grid[2];
+    int current;
+    double * partial;
+} Plate_float_t;
+
+typedef enum solver_t {
+    SOLVER_EXPLICIT,
+    SOLVER_SOR,
+    SOLVER_MULTIGRID,
+    SOLVER_DIRECT
+} Solver_t;
+
+/*  Cell type of the explicit solver. PRECISION_MIXED stores and computes
+    in float but sums the change in double. */
+typedef enum precision_t {
+    PRECISION_DOUBLE,
+    PRECISION_FLOAT,
+    PRECISION_MIXED
+} Precision_t;
+
+/*  What a configuration uses that not every mode supports, see
+    check_features. FEATURE_MODES are the modes that replace the normal
+    run, one at a time. */
+#define FEATURE_SOLVER (1u << 0)
+#define FEATURE_BLOCK (1u << 1)
+#define FEATURE_ACTIVE (1u << 2)
+#define FEATURE_PRECISION (1u << 3)
+#define FEATURE_NORM (1u << 4)
+#define FEATURE_SNAPSHOT (1u << 5)
+#define FEATURE_CHECKPOINT (1u << 6)
+#define FEATURE_RESTART (1u << 7)
+#define FEATURE_PIPELINE (1u << 8)
+#define FEATURE_COMPARE (1u << 9)
+#define FEATURE_ENSEMBLE (1u << 10)
+#define FEATURE_OUT_OF_CORE (1u << 11)
+#define FEATURE_LAYERS (1u << 12)
+#define FEATURE_RANKS (1u << 13)
+#define FEATURE_BENCH (1u << 14)
+#define FEATURE_DAEMON (1u << 15)
+#define FEATURE_AUTOTUNE (1u << 16)
+#define FEATURE_DIRECT (1u << 17)
+#define FEATURE_CHECK_INTERVAL (1u << 18)
+#define FEATURE_EPSILON (1u << 19)
+#define FEATURE_DELTA (1u << 20)
+#define FEATURE_PIN (1u << 21)
+#define FEATURE_COUNTERS (1u << 22)
+#define FEATURE_RELATIVE (1u << 23)
+#define FEATURE_COUNT 24
+#define FEATURE_MODES (FEATURE_ENSEMBLE | FEATURE_OUT_OF_CORE | \
+    FEATURE_LAYERS | FEATURE_RANKS | FEATURE_BENCH | FEATURE_DAEMON)
+/*  Variants of the time step, and the per-plate output of a run. */
+#define FEATURE_STEPS (FEATURE_SOLVER | FEATURE_BLOCK | FEATURE_ACTIVE | \
+    FEATURE_PRECISION)
+#define FEATURE_OUTPUT (FEATURE_SNAPSHOT | FEATURE_CHECKPOINT | \
+    FEATURE_PIPELINE | FEATURE_COMPARE)
+
+/*  One level of the multigrid hierarchy: the unknown u, the right hand
+    side f and the residual r, all rows x cols with the same pitch. On the
+    finest level u is the plate itself and f is NULL, meaning zero. */
+typedef struct mg_level_t {
+    int rows;
+    int cols;
+    size_t pitch;
+    double * u;
+    double * f;
+    double * r;
+    double * partial;
+} Mg_level_t;
+
+/*  A discrete sine transform (DST-I) of length n, done as an FFT of the
+    odd extension of length 2 (n + 1). When that length is not a power of
+    two the FFT is Bluestein's: a chirp multiplication and a power-of-two
+    convolution of fft_size points. */
+typedef struct dst_plan_t {
+    int n;
+    int size;
+    int fft_size;
+    double complex * roots;
+    double complex * chirp;
+    double complex * kernel;
+} Dst_plan_t;
+
+/*  How the change of one step is turned into a single number. */
+typedef enum norm_t {
+    NORM_L1,
+    NORM_L1_MEAN,
+    NORM_L2,
+    NORM_LINF
+} Norm_t;
+
+/*  Statistics of the cell changes made by one step. A solver that only
+    measured the sum sets sum_sq and max to -1. */
+typedef struct change_t {
+    double sum;
+    double sum_sq;
+    double max;
+} Change_t;
+
+/*  Decides when the plate has converged and keeps the values it saw. */
+typedef struct monitor_t {
+    Norm_t norm;
+    double tolerance;
+    int relative;
+    int interval;
+    long cells;
+    double reference;
+    int checks;
+    int capacity;
+    int * steps;
+    double * values;
+} Monitor_t;
+
+/*  Active-set bookkeeping: the interior is cut into square tiles and only
+    tiles near a change above epsilon are recomputed. */
+typedef struct active_set_t {
+    int tile;
+    int tiles_down;
+    int tiles_across;
+    double epsilon;
+    double * change;
+    double * next_change;
+    /*  Per tile, the summed change of the last step (--deterministic). */
+    double * sum;
+    unsigned char * synced;
+    long computed;
+    long visited;
+} Active_set_t;
+
+/*  Memory a solver keeps between steps. */
+typedef struct workspace_t {
+    int levels;
+    Mg_level_t level[MG_MAX_LEVELS];
+    double residual;
+    Dst_plan_t dst_row;
+    Dst_plan_t dst_col;
+    /*  The direct solver's transform room: dst_threads blocks of twice
+        the larger fft_size, one per thread, or FFTW's buffer and plan. */
+    int dst_threads;
+    double complex * dst_work;
+#ifdef PLATE_USE_FFTW
+    double * fftw_buffer;
+    fftw_plan fftw;
+#endif
+    Active_set_t active;
+    /*  --precision float or mixed: the plate being stepped, and whether it
+        is ahead of the double plate (see sync_plate). */
+    Plate_float_t single;
+    int single_ahead;
+} Workspace_t;
+
+typedef struct config_t {
+    int rows;
+    int cols;
+    int threads;
+    const char * kernel;
+    int block_steps;
+    int tile_rows;
+    int tile_cols;
+    Solver_t solver;
+    double omega;
+    Norm_t norm;
+    double tolerance;
+    int relative;
+    int check_interval;
+    int history;
+    int active_tile;
+    double active_epsilon;
+    int bins;
+    const char * snapshot;
+    int snapshot_every;
+    Snapshot_encoding_t snapshot_encoding;
+    const char * checkpoint;
+    int checkpoint_every;
+    int restart;
+    int pipeline;
+    int pipeline_drop;
+    Precision_t precision;
+    int compare_double;
+    Boundary_t boundary;
+    const char * ensemble;
+    int deterministic;
+    int benchmark_reduction;
+    const char * out_of_core;
+    int band_rows;
+    Placement_t placement;
+    Huge_pages_t huge_pages;
+    int pin;
+    int benchmark_placement;
+    int layers;
+    int ranks;
+    int scaling;
+    const char * bench;
+    const char * bench_sizes;
+    const char * bench_baseline;
+    double bench_tolerance;
+    const char * trace;
+    int counters;
+    int autotune;
+    const char * tune_cache;
+    const char * daemon;
+    int workers;
+} Config_t;
+
+/*  The start of a checkpoint file. The convergence history (checks steps
+    as int, then checks values as double) and the plate's cells, row by
+    row without padding, follow it. */
+typedef struct checkpoint_header_t {
+    char magic[8];
+    int version;
+    int rows;
+    int cols;
+    int solver;
+    int norm;
+    int precision;
+    int time;
+    int checks;
+    double reference;
+    Boundary_t boundary;
+} Checkpoint_header_t;
+
+/*  Appends frames to a snapshot file, see plate_snapshot.h. */
+typedef struct snapshot_writer_t {
+    FILE * file;
+    Snapshot_encoding_t encoding;
+    int rows;
+    int cols;
+    long frames;
+    long bytes;
+    /*  SNAPSHOT_DELTA: the cells of the last frame written. */
+    double * previous;
+    /*  The encoded payload of one frame. */
+    unsigned char * buffer;
+} Snapshot_writer_t;
+
+/*  --ensemble: K plates of the same size with their own boundaries,
+    stepped together. Cell (i, j) of member m is at
+    (i * cols + j) * width + m, so a vector of neighbouring lanes holds
+    the same cell of neighbouring members. width is K rounded up to
+    ENSEMBLE_LANES; the extra lanes are frozen from the start. */
+typedef struct ensemble_t {
+    int rows;
+    int cols;
+    int members;
+    int width;
+    double * grid[2];
+    int current;
+    /*  Per lane: all bits set (a NaN) while the member is stepped, +0.0
+        once it has converged and keeps its state. */
+    double * mask;
+    /*  Per row and lane, the change of the last measured step. */
+    double * change;
+    Boundary_t * boundary;
+    Monitor_t * monitor;
+    /*  Per member, the step at which it converged, or 0. */
+    int * converged;
+} Ensemble_t;
+
+/*  --layers: a layers x rows x cols block. Its layers are stacked in one
+    plate of layers * rows rows, so layer k is rows k * rows .. (k + 1) *
+    rows - 1 of it, one plane further on. The stacked plate has the
+    alignment, placement and analytics of any plate; the edges of the
+    layers are boundary cells and never change. */
+typedef struct volume_t {
+    int layers;
+    int rows;
+    size_t plane;
+    Plate_t plate;
+} Volume_t;
+
+/*  One case of --bench and its timing. bytes and flops are the memory
+    traffic and the floating point operations of one call. */
+typedef struct bench_result_t {
+    const char * name;
+    const char * kernel;
+    int rows;
+    int cols;
+    int threads;
+    double median;
+    double p95;
+    double bytes;
+    double flops;
+} Bench_result_t;
+
+/*  A calc_temp variant of --autotune and its time per step. A block of
+    one step is the plain time step, whatever the tile. */
+typedef struct tune_t {
+    const char * kernel;
+    int threads;
+    int block_steps;
+    int tile_rows;
+    int tile_cols;
+    double seconds;
+} Tune_t;
+
+/*  --daemon: a job of a client, from its job line (see serve_client).
+    times are the steps to send the plate at, sorted. */
+typedef struct daemon_job_t {
+    long id;
+    struct daemon_client_t * client;
+    int rows;
+    int cols;
+    Boundary_t boundary;
+    double threshold;
+    int max_steps;
+    int * times;
+    int count;
+    double queued;
+    struct daemon_job_t * next;
+} Daemon_job_t;
+
+/*  A connection to the daemon. Its reader thread and the jobs it queued
+    each hold a reference, see release_client; the reader's is dropped
+    when the daemon has joined the thread. lock keeps the messages of
+    different jobs apart; failed is set once a send has failed. done and
+    next belong to the daemon's list of readers, under its lock. */
+typedef struct daemon_client_t {
+    int fd;
+    pthread_mutex_t lock;
+    int reading;
+    int pending;
+    int failed;
+    struct daemon_t * daemon;
+    pthread_t reader;
+    int done;
+    struct daemon_client_t * next;
+} Daemon_client_t;
+
+/*  --daemon: the job queue, the workers that run it, the pooled plates
+    they reuse, and the totals of format_stats, all under lock. */
+typedef struct daemon_t {
+    const Config_t * config;
+    int listener;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    Daemon_job_t * head;
+    Daemon_job_t * tail;
+    int queued;
+    int running;
+    int stop;
+    pthread_t * worker;
+    int workers;
+    /*  The clients whose reader thread has not been joined yet. */
+    Daemon_client_t * clients;
+    Plate_t pool[DAEMON_POOL];
+    int pooled;
+    long next_id;
+    long received;
+    long completed;
+    long failed;
+    /*  Seconds jobs waited in the queue, the longest wait, and seconds
+        the workers spent running jobs. */
+    double queue_seconds;
+    double queue_max;
+    double run_seconds;
+    double cells;
+    double started;
+} Daemon_t;
+
+/*  --ranks: the plate cut into a down x across grid of blocks, one per
+    process. Everything here lives in shared mappings made before the
+    processes are forked. Every rank publishes the outer cells of its
+    block after each step, as four edges (top and bottom row, left and
+    right column) in one of two slots chosen by the parity of the step,
+    and then sets published[rank] to the step. Its neighbours read them
+    as their halo once published has reached the step they need. */
+typedef struct domain_t {
+    int ranks;
+    int down;
+    int across;
+    int rows;
+    int cols;
+    /*  Doubles of one edge slot. */
+    size_t stride;
+    void * shared;
+    size_t shared_bytes;
+    /*  Per check parity and rank, the change summed by the rank. */
+    double * sums;
+    /*  Per rank, seconds spent waiting for halos. */
+    double * waited;
+    double * edges;
+    int * published;
+    /*  Per rank, the step whose block it last copied into plate. */
+    int * gathered;
+    /*  Set when a rank failed, so the others stop waiting for it. */
+    int * failed;
+    /*  The time rank 0 took to step. */
+    double * seconds;
+    /*  The whole plate, one grid, for the reports of rank 0. */
+    Plate_t plate;
+} Domain_t;
+
+/*  One buffer of the analysis pipeline: a copy of the plate (one grid)
+    and what to do with it. */
+typedef struct pipeline_slot_t {
+    Plate_t plate;
+    int time;
+    int work;
+} Pipeline_slot_t;
+
+/*  A ring of plate copies between the solver, which fills them, and one
+    analysis thread, which reports and writes them in order. */
+typedef struct pipeline_t {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    Pipeline_slot_t * slot;
+    int slots;
+    int head;
+    int used;
+    int drop;
+    int done;
+    int failed;
+    /*  Output of the analysis thread. */
+    Snapshot_writer_t * snapshot;
+    int bins;
+    long * histogram;
+    int * norm_plate;
+    /*  Metrics: frames handed over and dropped, the most slots in use,
+        the solver's time spent copying and waiting for a free slot, and
+        the analysis thread's time spent working. */
+    long published;
+    long dropped;
+    int peak;
+    double copy_seconds;
+    double wait_seconds;
+    double busy_seconds;
+} Pipeline_t;
+
+#ifdef PLATE_TRACE
+/*  One timed call, in nanoseconds since trace_start. */
+typedef struct trace_event_t {
+    Phase_t phase;
+    long long start;
+    long long end;
+} Trace_event_t;
+
+/*  The events of one thread, the last TRACE_EVENTS of count in a ring,
+    and the calls and nanoseconds of every phase over the whole run.
+    Only its thread writes it, so recording takes no lock. */
+typedef struct trace_ring_t {
+    Trace_event_t event[TRACE_EVENTS];
+    long count;
+    long calls[PHASE_COUNT];
+    long long total[PHASE_COUNT];
+} Trace_ring_t;
+#endif
+
+/*  A feature, the features it cannot be combined with and those it
+    needs. */
+typedef struct feature_rule_t {
+    unsigned feature;
+    unsigned excludes;
+    unsigned requires;
+} Feature_rule_t;
+
+int parse_args(int argc, char * argv[], Config_t * config);
+void print_usage(const char * program);
+unsigned config_features(const Config_t * config);
+int check_features(unsigned features);
+int parse_positive_int(const char * text, int * value);
+int parse_solver(const char * text, Solver_t * solver);
+int parse_norm(const char * text, Norm_t * norm);
+int parse_encoding(const char * text, Snapshot_encoding_t * encoding);
+int parse_precision(const char * text, Precision_t * precision);
+int parse_placement(const char * text, Placement_t * placement);
+int parse_huge_pages(const char * text, Huge_pages_t * huge_pages);
+int pin_threads(void);
+void benchmark_placement(const Config_t * config);
+int parse_boundary(const char * text, Boundary_t * boundary);
+double wall_seconds(void);
+int finish_trace(const Config_t * config, int status);
+int create_plate_float(Plate_float_t * plate, int rows, int cols);
+void destroy_plate_float(Plate_float_t * plate);
+void narrow_plate(Plate_float_t * single, const Plate_t * plate);
+void widen_plate(Plate_t * plate, const Plate_float_t * single);
+void sync_plate(Plate_t * plate, Workspace_t * workspace);
+void compare_precision(
+    const Plate_t * plate, const Boundary_t * boundary, int time,
+    double seconds
+);
+int run_ensemble(const Config_t * config);
+int read_ensemble(const char * path, Boundary_t ** boundary, int * members);
+int create_ensemble(
+    Ensemble_t * ensemble, const Config_t * config,
+    const Boundary_t * boundary, int members
+);
+void destroy_ensemble(Ensemble_t * ensemble);
+void member_plate(const Ensemble_t * ensemble, int member, Plate_t * plate);
+void ensemble_step(Ensemble_t * ensemble, int measure);
+int run_volume(const Config_t * config);
+int create_volume(Volume_t * volume, int layers, int rows, int cols);
+void destroy_volume(Volume_t * volume);
+void init_volume(Volume_t * volume, const Boundary_t * boundary);
+double volume_step(
+    Volume_t * volume, int measure, int tile_rows, int tile_cols
+);
+double volume_row(
+    const double * mid, size_t plane, size_t pitch, double * out,
+    int first, int n, int measure
+);
+void print_volume(const Volume_t * volume, int time, const int * norm);
+int run_decomposed(const Config_t * config);
+void report_scaling(const Config_t * config);
+int run_domain(
+    const Config_t * config, int ranks, int rows, int cols, int steps,
+    int time_print, double * seconds
+);
+int split_ranks(int ranks, int rows, int cols, int * down, int * across);
+int create_domain(
+    Domain_t * domain, int ranks, int rows, int cols,
+    const Boundary_t * boundary
+);
+void destroy_domain(Domain_t * domain);
+void block_of(
+    const Domain_t * domain, int rank, int * top, int * left, int * height,
+    int * width
+);
+int run_rank(
+    Domain_t * domain, const Config_t * config, int rank, int steps,
+    int time_print, double * seconds
+);
+double step_block(
+    Domain_t * domain, int rank, Plate_t * block, int time, int measure
+);
+void publish_edges(Domain_t * domain, int rank, const Plate_t * block,
+    int time);
+void receive_halos(Domain_t * domain, int rank, Plate_t * block, int time);
+void gather_block(Domain_t * domain, int rank, const Plate_t * block,
+    int time);
+int wait_for(const Domain_t * domain, const int * counter, int time);
+void fail_domain(Domain_t * domain);
+int run_bench(const Config_t * config);
+double measure_stream(void);
+void time_case(
+    Bench_result_t * result, Plate_t * plate, int bins, long * histogram,
+    int * norm_plate
+);
+int compare_doubles(const void * a, const void * b);
+void cpu_model(char * model, size_t size);
+int write_bench(
+    const char * path, const Bench_result_t * results, int count,
+    double stream
+);
+int compare_bench(
+    const char * path, const Bench_result_t * results, int count,
+    double tolerance
+);
+double json_number(const char * line, const char * key);
+int json_string(const char * line, const char * key, char * out, size_t size);
+int autotune(Config_t * config);
+int tune_trials(const Config_t * config, int max_threads, Tune_t * best);
+void time_variant(Plate_t * plate, Tune_t * tune);
+int load_tuning(
+    const char * path, const char * model, int rows, int cols,
+    int max_threads, int block_steps, Tune_t * tune
+);
+int save_tuning(
+    const char * path, const char * model, int rows, int cols,
+    int max_threads, const Tune_t * tune
+);
+int run_daemon(const Config_t * config);
+void stop_daemon(Daemon_t * daemon);
+void * serve_client(void * argument);
+void queue_job(Daemon_client_t * client, char * text);
+const char * parse_job(
+    const Daemon_t * daemon, char * text, Daemon_job_t * job
+);
+int compare_ints(const void * a, const void * b);
+void * run_worker(void * argument);
+void run_job(Daemon_t * daemon, const Daemon_job_t * job, double waited);
+void send_plate(
+    Daemon_client_t * client, const Plate_t * plate, long id, int time
+);
+void send_text(Daemon_client_t * client, const char * text);
+void release_client(Daemon_client_t * client, int job);
+void join_readers(Daemon_t * daemon, int all);
+int take_plate(Daemon_t * daemon, Plate_t * plate, int rows, int cols);
+void give_plate(Daemon_t * daemon, const Plate_t * plate);
+void format_stats(Daemon_t * daemon, char * text, size_t size);
+int create_workspace(
+    Workspace_t * workspace, const Plate_t * plate, const Config_t * config
+);
+void destroy_workspace(Workspace_t * workspace);
+void advance_plate(
+    Plate_t * plate, const Config_t * config, Workspace_t * workspace,
+    int steps, Change_t * change
+);
+int create_plate_mapped(
+    Plate_t * plate, int rows, int cols, const char * path
+);
+double stream_step(Plate_t * plate, int measure, int band_rows);
+void release_rows(const Plate_t * plate, double * grid, int first, int last);
+double read_storage(const Plate_t * plate, const char * path);
+double stencil_step_float(Plate_float_t * plate, int measure);
+void measure_change_float(const Plate_float_t * plate, Change_t * change);
+double calc_temp_blocked(
+    Plate_t * plate, int steps, int tile_rows, int tile_cols, int measure
+);
+double advance_tile(
+    const Plate_t * plate, double * scratch, int first_row, int first_col,
+    int tile_rows, int tile_cols, int steps, int measure
+);
+int create_active_set(
+    Active_set_t * set, const Plate_t * plate, int tile, double epsilon
+);
+void destroy_active_set(Active_set_t * set);
+double active_step(Plate_t * plate, Active_set_t * set);
+void measure_change(const Plate_t * plate, Change_t * change);
+void benchmark_reduction(const Config_t * config);
+void add_change(Change_t * total, const Change_t * part);
+int create_monitor(Monitor_t * monitor, const Config_t * config);
+void destroy_monitor(Monitor_t * monitor);
+double change_norm(const Monitor_t * monitor, const Change_t * change);
+int monitor_converged(Monitor_t * monitor, int step, const Change_t * change);
+void print_history(const Monitor_t * monitor);
+int save_checkpoint(
+    const char * path, const Plate_t * plate, const Config_t * config,
+    const Monitor_t * monitor, int time
+);
+int load_checkpoint(
+    const char * path, Plate_t * plate, const Config_t * config,
+    Monitor_t * monitor, int * time
+);
+int same_boundary(const Boundary_t * a, const Boundary_t * b);
+Change_t sor_sweep(Plate_t * plate, double omega);
+Change_t relax_grid(
+    double * u, const double * f, size_t pitch, int rows, int cols,
+    double omega, double * partial
+);
+Change_t multigrid_cycle(Workspace_t * workspace);
+Change_t v_cycle(Workspace_t * workspace, int index);
+void compute_residual(Mg_level_t * level);
+void restrict_residual(const Mg_level_t * fine, Mg_level_t * coarse);
+Change_t prolong_correction(const Mg_level_t * coarse, Mg_level_t * fine);
+double residual_norm(const Mg_level_t * level);
+void solve_direct(Plate_t * plate, Workspace_t * workspace);
+int create_dst_plan(Dst_plan_t * plan, int n);
+void destroy_dst_plan(Dst_plan_t * plan);
+void dst_transform(
+    const Dst_plan_t * plan, double * x, size_t stride,
+    double complex * work
+);
+void fft_radix2(double complex * a, int n, const double complex * roots);
+double estimate_omega(int rows, int cols);
+void analyze_plate(
+    const Plate_t * plate, int bins, long * histogram, int * norm_plate
+);
+void normalize_plate(const Plate_t * plate, int bins, int * norm_plate);
+void find_min_and_max(const Plate_t * plate, double * max, double * min);
+void create_histogram(
+    const Plate_t * plate, double min, double max, int bins,
+    long * histogram, int * norm_plate
+);
+int create_snapshot(
+    Snapshot_writer_t * writer, const Plate_t * plate, const Config_t * config
+);
+int write_snapshot(Snapshot_writer_t * writer, const Plate_t * plate, int time);
+int close_snapshot(Snapshot_writer_t * writer);
+size_t encode_delta(
+    const Snapshot_writer_t * writer, const Plate_t * plate,
+    unsigned char * out
+);
+size_t encode_lossy(
+    const Plate_t * plate, double min, double max, unsigned char * out
+);
+int create_pipeline(
+    Pipeline_t * pipeline, const Plate_t * plate, const Config_t * config,
+    Snapshot_writer_t * snapshot
+);
+int publish_plate(Pipeline_t * pipeline, const Plate_t * plate, int time,
+    int work);
+int finish_pipeline(Pipeline_t * pipeline);
+void * run_pipeline(void * argument);
+int process_frame(
+    const Plate_t * plate, int time, int work, Snapshot_writer_t * snapshot,
+    int bins, long * histogram, int * norm_plate
+);
+void copy_plate(Plate_t * copy, const Plate_t * plate);
+void print_plate(const Plate_t * plate, int time);
+void print_norm_plate(const int * norm_plate, int rows, int cols);
+void print_histogram(const long * histogram, int bins);
+int get_user_timestep(void);
+#ifdef PLATE_TRACE
+void trace_start(int counters);
+int open_counter(int event);
+void close_counters(void);
+int trace_report(const char * path);
+int write_trace(const char * path);
+#endif
+
+/*  The option that turns each feature on, by bit. */
+static const char * const feature_names[FEATURE_COUNT] = {
+    "--solver other than explicit", "--block-steps",
+    "--active-tiles", "--precision float or mixed", "--norm l2 or linf",
+    "--snapshot", "--checkpoint", "--restart", "--pipeline",
+    "--compare-double", "--ensemble", "--out-of-core", "--layers",
+    "--ranks or --scaling", "--bench", "--daemon", "--autotune",
+    "--solver direct", "--check-interval above 1", "--active-epsilon",
+    "--snapshot-encoding delta", "--pin", "--counters", "--relative"
+};
+
+/*  Which features go together. Only the explicit solver takes time steps
+    in blocks, the active set tracks single steps, and only the plain
+    explicit step has single-precision kernels. The modes
+    have loops of their own: an ensemble and the ranks only have the
+    fused change sums of the l1 norms, a mapped plate is streamed by plain
+    double steps, and none of them but out of core writes the per-plate
+    output. Out of core, nothing may keep a copy of the plate in memory,
+    as the pipeline and delta snapshots do. --pin and --counters start
+    OpenMP threads, which do not survive the fork of the ranks.
+    --autotune tunes the normal run. */
+static const Feature_rule_t feature_rules[] = {
+    { FEATURE_BLOCK, FEATURE_SOLVER, 0 },
+    { FEATURE_ACTIVE, FEATURE_SOLVER | FEATURE_BLOCK, 0 },
+    { FEATURE_PRECISION, FEATURE_SOLVER | FEATURE_BLOCK | FEATURE_ACTIVE,
+        0 },
+    { FEATURE_COMPARE, FEATURE_SOLVER, 0 },
+    { FEATURE_RESTART, 0, FEATURE_CHECKPOINT },
+    { FEATURE_EPSILON, 0, FEATURE_ACTIVE },
+    /*  The direct solver takes a single pass, which is checked against
+        the absolute tolerance. */
+    { FEATURE_DIRECT, FEATURE_CHECK_INTERVAL | FEATURE_RELATIVE, 0 },
+    { FEATURE_ENSEMBLE, FEATURE_MODES | FEATURE_STEPS | FEATURE_OUTPUT |
+        FEATURE_NORM, 0 },
+    { FEATURE_OUT_OF_CORE, FEATURE_MODES | FEATURE_STEPS | FEATURE_COMPARE |
+        FEATURE_PIPELINE | FEATURE_DELTA, 0 },
+    { FEATURE_LAYERS, FEATURE_MODES | FEATURE_STEPS | FEATURE_OUTPUT, 0 },
+    { FEATURE_RANKS, FEATURE_MODES | FEATURE_STEPS | FEATURE_OUTPUT |
+        FEATURE_NORM | FEATURE_PIN | FEATURE_COUNTERS, 0 },
+    { FEATURE_BENCH, FEATURE_MODES | FEATURE_STEPS | FEATURE_OUTPUT, 0 },
+    { FEATURE_DAEMON, FEATURE_MODES | FEATURE_STEPS | FEATURE_OUTPUT, 0 },
+    { FEATURE_AUTOTUNE, FEATURE_MODES | FEATURE_SOLVER | FEATURE_ACTIVE |
+        FEATURE_PRECISION, 0 }
+};
+
+#ifdef PLATE_TRACE
+/*  The tracer: when trace_start was called, the ring of every thread that
+    has recorded an event (a thread takes the next free one the first time
+    and keeps it in trace_mine) and, for --counters, the perf_event file
+    descriptors of cycles and LLC misses of every OpenMP thread, and the
+    names the phases are reported by. */
+static long long trace_epoch;
+static Trace_ring_t * trace_ring[TRACE_THREADS];
+static int trace_threads = 0;
+static __thread Trace_ring_t * trace_mine = NULL;
+static int trace_counter[TRACE_THREADS][2];
+static int trace_counters = 0;
+static const char * trace_phase[PHASE_COUNT] = {
+    "stencil", "reduction", "copy", "normalize", "histogram", "output"
+};
+#endif
+
+
+int main(int argc, char * argv[]) {
+    Config_t config;
+    Plate_t plate;
+    Workspace_t workspace;
+    Monitor_t monitor;
+    Change_t change;
+    Snapshot_writer_t snapshot;
+    Pipeline_t pipeline;
+    int * norm_plate_temp;
+    long * histogram;
+    int time_print, time = 0, steps, check, converged = 0, stopped = 0;
+    int status;
+    int checkpoints = 0, work, first_step, lowest_cycle = -1;
+    double started, solved, checkpoint_seconds = 0, storage = 0;
+    double lowest_residual = 0;
+
+    if (parse_args(argc, argv, &config) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (select_kernel(config.kernel) != EXIT_SUCCESS) {
+        fprintf(stderr, "Kernel '%s' is not available.\n", config.kernel);
+        return EXIT_FAILURE;
+    }
+#ifdef _OPENMP
+    if (config.threads > 0)
+        omp_set_num_threads(config.threads);
+#else
+    if (config.threads > 1)
+        fputs("Built without OpenMP, running on one thread.\n", stderr);
+#endif
+    deterministic = config.deterministic;
+    placement = config.placement;
+    huge_pages = config.huge_pages;
+    if (config.pin && pin_threads() != EXIT_SUCCESS)
+        fputs("Could not pin the threads to cores.\n", stderr);
+#ifdef PLATE_TRACE
+    trace_start(config.counters);
+#else
+    if (config.trace != NULL || config.counters)
+        fputs("Built without tracing (make TRACE=1), ignoring --trace "
+            "and --counters.\n", stderr);
+#endif
+    if (config.benchmark_placement > 0) {
+        benchmark_placement(&config);
+        return finish_trace(&config, EXIT_SUCCESS);
+    }
+    if (config.benchmark_reduction > 0) {
+        benchmark_reduction(&config);
+        return finish_trace(&config, EXIT_SUCCESS);
+    }
+    if (config.ensemble != NULL)
+        return finish_trace(&config, run_ensemble(&config));
+    if (config.layers > 0)
+        return finish_trace(&config, run_volume(&config));
+    if (config.bench != NULL)
+        return finish_trace(&config, run_bench(&config));
+    if (config.scaling > 0) {
+        report_scaling(&config);
+        return finish_trace(&config, EXIT_SUCCESS);
+    }
+    if (config.ranks > 0)
+        return run_decomposed(&config);
+    if (config.daemon != NULL)
+        return finish_trace(&config, run_daemon(&config));
+    if (config.autotune && autotune(&config) != EXIT_SUCCESS) {
+        fputs("Could not allocate the autotuning plate.\n", stderr);
+        return EXIT_FAILURE;
+    }
+    /*  The direct solver keeps a second grid to check its answer with one
+        calc_temp step. In single precision the double plate only holds
+        copies of the state. */
+    if (config.out_of_core != NULL ? create_plate_mapped(
+            &plate, config.rows, config.cols, config.out_of_core
+        ) : create_plate(
+            &plate, config.rows, config.cols,
+            (config.solver == SOLVER_EXPLICIT &&
+                config.precision == PRECISION_DOUBLE) ||
+            config.solver == SOLVER_DIRECT ? 2 : 1
+        ) != EXIT_SUCCESS) {
+        fputs("Could not allocate the plate.\n", stderr);
+        return EXIT_FAILURE;
+    }
+    norm_plate_temp = malloc(sizeof(int) * config.rows * config.cols);
+    histogram = malloc(sizeof(long) * config.bins);
+    if (norm_plate_temp == NULL || histogram == NULL) {
+        fputs("Could not allocate the normalized plate.\n", stderr);
+        free(norm_plate_temp);
+        free(histogram);
+        destroy_plate(&plate);
+        return EXIT_FAILURE;
+    }
+    if (config.solver == SOLVER_SOR && config.omega == 0)
+        config.omega = estimate_omega(config.rows, config.cols);
+    if (create_workspace(&workspace, &plate, &config) != EXIT_SUCCESS) {
+        fputs("Could not allocate the solver workspace.\n", stderr);
+        free(histogram);
+        free(norm_plate_temp);
+        destroy_plate(&plate);
+        return EXIT_FAILURE;
+    }
+    if (create_monitor(&monitor, &config) != EXIT_SUCCESS) {
+        fputs("Could not allocate the convergence history.\n", stderr);
+        destroy_workspace(&workspace);
+        free(histogram);
+        free(norm_plate_temp);
+        destroy_plate(&plate);
+        return EXIT_FAILURE;
+    }
+
+    init_plate(&plate, &config.boundary);
+    if (config.restart && load_checkpoint(
+            config.checkpoint, &plate, &config, &monitor, &time
+        ) != EXIT_SUCCESS) {
+        fprintf(stderr, "Could not restart from '%s'.\n", config.checkpoint);
+        destroy_monitor(&monitor);
+        destroy_workspace(&workspace);
+        free(histogram);
+        free(norm_plate_temp);
+        destroy_plate(&plate);
+        return EXIT_FAILURE;
+    }
+    if (config.precision != PRECISION_DOUBLE)
+        narrow_plate(&workspace.single, &plate);
+    if (config.out_of_core != NULL)
+        storage = read_storage(&plate, config.out_of_core);
+    snapshot.file = NULL;
+    if (config.snapshot != NULL &&
+        create_snapshot(&snapshot, &plate, &config) != EXIT_SUCCESS) {
+        fprintf(stderr, "Could not write the snapshot file '%s'.\n",
+            config.snapshot);
+        destroy_monitor(&monitor);
+        destroy_workspace(&workspace);
+        free(histogram);
+        free(norm_plate_temp);
+        destroy_plate(&plate);
+        return EXIT_FAILURE;
+    }
+    if (config.pipeline > 0 && create_pipeline(
+            &pipeline, &plate, &config, &snapshot
+        ) != EXIT_SUCCESS) {
+        fputs("Could not start the analysis pipeline.\n", stderr);
+        close_snapshot(&snapshot);
+        destroy_monitor(&monitor);
+        destroy_workspace(&workspace);
+        free(histogram);
+        free(norm_plate_temp);
+        destroy_plate(&plate);
+        return EXIT_FAILURE;
+    }
+    time_print = get_user_timestep();
+    first_step = time;
+    started = wall_seconds();
+    /*  The snapshot file starts with the initial plate. */
+    work = snapshot.file != NULL ? FRAME_SNAPSHOT | FRAME_KEEP : 0;
+    do {
+        if (work != 0)
+            sync_plate(&plate, &workspace);
+        if (work != 0 && (config.pipeline > 0 ?
+                publish_plate(&pipeline, &plate, time, work) :
+                process_frame(
+                    &plate, time, work, &snapshot, config.bins, histogram,
+                    norm_plate_temp
+                )) != EXIT_SUCCESS) {
+            converged = stopped = 0;
+            break;
+        }
+        if (converged || stopped)
+            break;
+        /*  A block never jumps over the step the user wants to see. */
+        steps = config.block_steps;
+        if (time < time_print && time + steps > time_print)
+            steps = time_print - time;
+        /*  Only the steps whose block reaches a multiple of the check
+            interval pay for measuring the change. */
+        check = (time + steps) / monitor.interval != time / monitor.interval;
+        advance_plate(
+            &plate, &config, &workspace, steps, check ? &change : NULL
+        );
+        time += steps;
+        if (check)
+            converged = monitor_converged(&monitor, time, &change);
+        /*  The change is only measured on the checked passes. */
+        if (config.solver == SOLVER_MULTIGRID && check)
+            printf(
+                "Cycle %d: residual %.6e, change %.6e\n",
+                time, workspace.residual, change.sum
+            );
+        /*  The direct solver is done after its solve and check step,
+            whether the check met the tolerance or not. */
+        if (config.solver == SOLVER_DIRECT)
+            stopped = 1;
+        /*  Multigrid stops once its residual is at round-off, where a
+            tolerance below the change it leaves can never be met. */
+        if (config.solver == SOLVER_MULTIGRID && !converged) {
+            if (lowest_cycle < 0 || workspace.residual < lowest_residual) {
+                lowest_residual = workspace.residual;
+                lowest_cycle = time;
+            }
+            if (time - lowest_cycle >= MG_STALL_CYCLES) {
+                printf(
+                    "Multigrid: stopped at cycle %d, the residual has not "
+                    "fallen below %.6e in %d cycles\n", time,
+                    lowest_residual, MG_STALL_CYCLES
+                );
+                stopped = 1;
+            } else if (time >= MG_MAX_CYCLES) {
+                printf(
+                    "Multigrid: stopped after %d cycles without reaching "
+                    "the tolerance\n", MG_MAX_CYCLES
+                );
+                stopped = 1;
+            }
+        }
+        if (config.checkpoint != NULL && !converged && !stopped &&
+            (time - steps) / config.checkpoint_every
+                != time / config.checkpoint_every) {
+            double start = wall_seconds();
+
+            sync_plate(&plate, &workspace);
+            if (save_checkpoint(
+                    config.checkpoint, &plate, &config, &monitor, time
+                ) != EXIT_SUCCESS)
+                fprintf(stderr, "Could not write the checkpoint at step %d.\n",
+                    time);
+            checkpoint_seconds += wall_seconds() - start;
+            checkpoints++;
+        }
+        if (config.solver == SOLVER_DIRECT)
+            printf(
+                "Direct solve: one calc_temp step changes the plate by "
+                "%.6e, %s the tolerance %.1e\n",
+                change_norm(&monitor, &change),
+                converged ? "below" : "not below", config.tolerance
+            );
+        /*  The frame is handled at the top of the next pass. The
+            converged state is always kept, whatever the cadence. */
+        work = 0;
+        if (snapshot.file != NULL &&
+            (time - steps) / config.snapshot_every
+                != time / config.snapshot_every)
+            work |= FRAME_SNAPSHOT;
+        if (snapshot.file != NULL && (converged || stopped))
+            work |= FRAME_SNAPSHOT | FRAME_KEEP;
+        if (time_print == time)
+            work |= FRAME_REPORT | FRAME_KEEP;
+    } while (1) ;
+    solved = wall_seconds() - started;
+    sync_plate(&plate, &workspace);
+    status = EXIT_SUCCESS;
+    if (config.pipeline > 0) {
+        if (finish_pipeline(&pipeline) != EXIT_SUCCESS)
+            converged = 0;
+        printf(
+            "Pipeline: %ld frames, %ld dropped, at most %d of %d slots "
+            "used\n"
+            "Pipeline: copying %.3f s, waiting for a slot %.3f s, "
+            "analysis %.3f s, %.1f%% of it overlapped\n",
+            pipeline.published, pipeline.dropped, pipeline.peak,
+            pipeline.slots, pipeline.copy_seconds, pipeline.wait_seconds,
+            pipeline.busy_seconds, pipeline.busy_seconds > 0 ?
+                100 * (1 - (pipeline.wait_seconds < pipeline.busy_seconds ?
+                    pipeline.wait_seconds : pipeline.busy_seconds)
+                    / pipeline.busy_seconds) : 100.0
+        );
+    }
+    if (checkpoints > 0)
+        printf(
+            "Checkpoints: %d written in %.3f s, %.3f ms each, "
+            "%.1f%% of the run\n", checkpoints, checkpoint_seconds,
+            1e3 * checkpoint_seconds / checkpoints,
+            100 * checkpoint_seconds / solved
+        );
+    if (snapshot.file != NULL) {
+        if (!(converged || stopped) ||
+            close_snapshot(&snapshot) != EXIT_SUCCESS) {
+            fprintf(stderr, "Could not write the snapshot file '%s'.\n",
+                config.snapshot);
+            status = EXIT_FAILURE;
+        }
+        printf(
+            "Snapshots: %ld frames, %ld bytes in %s\n",
+            snapshot.frames, snapshot.bytes, config.snapshot
+        );
+        close_snapshot(&snapshot);
+    }
+    if (config.out_of_core != NULL) {
+        struct rusage usage;
+        const double cells = (double) (config.rows - 2) * (config.cols - 2) *
+            (time - first_step);
+
+        getrusage(RUSAGE_SELF, &usage);
+        /*  A step reads one grid and writes the other. */
+        printf(
+            "Out of core: %.3e cells/s, %.1f MB/s streamed, storage reads "
+            "%.1f MB/s, %ld major page faults\n", cells / solved,
+            1e-6 * plate.mapped * (time - first_step) / solved,
+            1e-6 * storage, usage.ru_majflt
+        );
+    }
+    puts("Final State.");
+    print_plate(&plate, time);
+    if (config.history)
+        print_history(&monitor);
+    if (config.compare_double)
+        compare_precision(&plate, &config.boundary, time, solved);
+    if (config.active_tile > 0)
+        printf(
+            "Active tiles: %ld of %ld tile updates computed (%.1f%%)\n",
+            workspace.active.computed, workspace.active.visited,
+            100.0 * workspace.active.computed / workspace.active.visited
+        );
+    status = finish_trace(&config, status);
+
+    destroy_monitor(&monitor);
+    destroy_workspace(&workspace);
+    free(histogram);
+    free(norm_plate_temp);
+    destroy_plate(&plate);
+
+    return status;
+}
+
+/**
+ * @brief Reads the command line options into a configuration.
+ * @details See print_usage for the options. A plate needs at least one
+ * interior cell, so both sizes must be 3 or more.
+ *
+ * @param[in] argc The argument count passed to main.
+ * @param[in] argv The argument vector passed to main.
+ * @param[out] config The configuration, filled with defaults first.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE after printing a usage message.
+ */
+int parse_args(int argc, char * argv[], Config_t * config) {
+    int i;
+
+    config->rows = ROWS;
+    config->cols = COLS;
+    config->threads = 0;
+    config->kernel = "auto";
+    config->block_steps = 1;
+    config->tile_rows = TILE_ROWS;
+    config->tile_cols = TILE_COLS;
+    config->solver = SOLVER_EXPLICIT;
+    config->omega = 0;
+    config->norm = NORM_L1;
+    config->tolerance = THRESHOLD;
+    config->relative = 0;
+    config->check_interval = 1;
+    config->history = 0;
+    config->active_tile = 0;
+    config->active_epsilon = 0;
+    config->bins = HEAT_LEVELS;
+    config->snapshot = NULL;
+    config->snapshot_every = 1;
+    config->snapshot_encoding = SNAPSHOT_RAW;
+    config->checkpoint = NULL;
+    config->checkpoint_every = CHECKPOINT_EVERY;
+    config->restart = 0;
+    config->pipeline = 0;
+    config->pipeline_drop = 0;
+    config->precision = PRECISION_DOUBLE;
+    config->compare_double = 0;
+    config->boundary.top = TEMP_TOP;
+    config->boundary.bottom = TEMP_BOTTOM;
+    config->boundary.left = TEMP_LEFT;
+    config->boundary.right = TEMP_RIGHT;
+    config->boundary.inner = TEMP_INNER;
+    config->boundary.front = TEMP_FRONT;
+    config->boundary.back = TEMP_BACK;
+    config->ensemble = NULL;
+    config->deterministic = 0;
+    config->benchmark_reduction = 0;
+    config->out_of_core = NULL;
+    config->band_rows = BAND_ROWS;
+    config->placement = PLACEMENT_FIRST_TOUCH;
+    config->huge_pages = HUGE_PAGES_NONE;
+    config->pin = 0;
+    config->benchmark_placement = 0;
+    config->layers = 0;
+    config->ranks = 0;
+    config->scaling = 0;
+    config->bench = NULL;
+    config->bench_sizes = BENCH_SIZES;
+    config->bench_baseline = NULL;
+    config->bench_tolerance = BENCH_TOLERANCE;
+    config->trace = NULL;
+    config->counters = 0;
+    config->autotune = 0;
+    config->tune_cache = NULL;
+    config->daemon = NULL;
+    config->workers = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->rows) != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--cols") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->cols) != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->threads) != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            config->kernel = argv[++i];
+        } else if (strcmp(argv[i], "--block-steps") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->block_steps)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--tile-rows") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->tile_rows)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--tile-cols") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->tile_cols)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--solver") == 0 && i + 1 < argc) {
+            if (parse_solver(argv[++i], &config->solver) != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--omega") == 0 && i + 1 < argc) {
+            config->omega = atof(argv[++i]);
+            if (config->omega <= 0 || config->omega >= 2)
+                break;
+        } else if (strcmp(argv[i], "--norm") == 0 && i + 1 < argc) {
+            if (parse_norm(argv[++i], &config->norm) != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            config->tolerance = atof(argv[++i]);
+            if (config->tolerance <= 0)
+                break;
+        } else if (strcmp(argv[i], "--relative") == 0) {
+            config->relative = 1;
+        } else if (strcmp(argv[i], "--check-interval") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->check_interval)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--history") == 0) {
+            config->history = 1;
+        } else if (strcmp(argv[i], "--active-tiles") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->active_tile)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--active-epsilon") == 0 && i + 1 < argc) {
+            config->active_epsilon = atof(argv[++i]);
+            if (config->active_epsilon < 0)
+                break;
+        } else if (strcmp(argv[i], "--bins") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->bins) != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            config->snapshot = argv[++i];
+        } else if (strcmp(argv[i], "--snapshot-every") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->snapshot_every)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--snapshot-encoding") == 0 &&
+            i + 1 < argc) {
+            if (parse_encoding(argv[++i], &config->snapshot_encoding)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            config->checkpoint = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 &&
+            i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->checkpoint_every)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--restart") == 0) {
+            config->restart = 1;
+        } else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->pipeline)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--pipeline-drop") == 0) {
+            config->pipeline_drop = 1;
+        } else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc) {
+            if (parse_precision(argv[++i], &config->precision)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--compare-double") == 0) {
+            config->compare_double = 1;
+        } else if (strcmp(argv[i], "--temps") == 0 && i + 1 < argc) {
+            if (parse_boundary(argv[++i], &config->boundary) != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--ensemble") == 0 && i + 1 < argc) {
+            config->ensemble = argv[++i];
+        } else if (strcmp(argv[i], "--deterministic") == 0) {
+            config->deterministic = 1;
+        } else if (strcmp(argv[i], "--benchmark-reduction") == 0 &&
+            i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->benchmark_reduction)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--out-of-core") == 0 && i + 1 < argc) {
+            config->out_of_core = argv[++i];
+        } else if (strcmp(argv[i], "--band-rows") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->band_rows)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--placement") == 0 && i + 1 < argc) {
+            if (parse_placement(argv[++i], &config->placement)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--huge-pages") == 0 && i + 1 < argc) {
+            if (parse_huge_pages(argv[++i], &config->huge_pages)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            config->pin = 1;
+        } else if (strcmp(argv[i], "--benchmark-placement") == 0 &&
+            i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->benchmark_placement)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--ranks") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->ranks)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            config->bench = argv[++i];
+        } else if (strcmp(argv[i], "--bench-sizes") == 0 && i + 1 < argc) {
+            config->bench_sizes = argv[++i];
+        } else if (strcmp(argv[i], "--bench-baseline") == 0 &&
+            i + 1 < argc) {
+            config->bench_baseline = argv[++i];
+        } else if (strcmp(argv[i], "--bench-tolerance") == 0 &&
+            i + 1 < argc) {
+            config->bench_tolerance = atof(argv[++i]);
+            if (config->bench_tolerance <= 0)
+                break;
+        } else if (strcmp(argv[i], "--daemon") == 0 && i + 1 < argc) {
+            config->daemon = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->workers)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--autotune") == 0) {
+            config->autotune = 1;
+        } else if (strcmp(argv[i], "--tune-cache") == 0 && i + 1 < argc) {
+            config->tune_cache = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            config->trace = argv[++i];
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            config->counters = 1;
+        } else if (strcmp(argv[i], "--scaling") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->scaling)
+                != EXIT_SUCCESS)
+                break;
+        } else if (strcmp(argv[i], "--layers") == 0 && i + 1 < argc) {
+            if (parse_positive_int(argv[++i], &config->layers)
+                != EXIT_SUCCESS || config->layers < 3)
+                break;
+        } else {
+            break;
+        }
+    }
+
+    if (check_features(config_features(config)) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (i < argc || config->rows < 3 || config->cols < 3) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief The features a configuration uses, see feature_rules.
+ *
+ * @param[in] config The configuration.
+ *
+ * @return The FEATURE_* bits.
+ */
+unsigned config_features(const Config_t * config) {
+    unsigned features = 0;
+
+    if (config->solver != SOLVER_EXPLICIT)
+        features |= FEATURE_SOLVER;
+    if (config->solver == SOLVER_DIRECT)
+        features |= FEATURE_DIRECT;
+    if (config->check_interval > 1)
+        features |= FEATURE_CHECK_INTERVAL;
+    if (config->block_steps > 1)
+        features |= FEATURE_BLOCK;
+    if (config->active_tile > 0)
+        features |= FEATURE_ACTIVE;
+    if (config->active_epsilon > 0)
+        features |= FEATURE_EPSILON;
+    if (config->precision != PRECISION_DOUBLE)
+        features |= FEATURE_PRECISION;
+    if (config->norm != NORM_L1 && config->norm != NORM_L1_MEAN)
+        features |= FEATURE_NORM;
+    if (config->snapshot != NULL)
+        features |= FEATURE_SNAPSHOT;
+    if (config->snapshot != NULL &&
+        config->snapshot_encoding == SNAPSHOT_DELTA)
+        features |= FEATURE_DELTA;
+    if (config->checkpoint != NULL)
+        features |= FEATURE_CHECKPOINT;
+    if (config->restart)
+        features |= FEATURE_RESTART;
+    if (config->pipeline > 0)
+        features |= FEATURE_PIPELINE;
+    if (config->compare_double)
+        features |= FEATURE_COMPARE;
+    if (config->ensemble != NULL)
+        features |= FEATURE_ENSEMBLE;
+    if (config->out_of_core != NULL)
+        features |= FEATURE_OUT_OF_CORE;
+    if (config->layers > 0)
+        features |= FEATURE_LAYERS;
+    if (config->ranks > 0 || config->scaling > 0)
+        features |= FEATURE_RANKS;
+    if (config->bench != NULL)
+        features |= FEATURE_BENCH;
+    if (config->daemon != NULL)
+        features |= FEATURE_DAEMON;
+    if (config->autotune)
+        features |= FEATURE_AUTOTUNE;
+    if (config->pin)
+        features |= FEATURE_PIN;
+    if (config->counters)
+        features |= FEATURE_COUNTERS;
+    if (config->relative)
+        features |= FEATURE_RELATIVE;
+
+    return features;
+}
+
+/**
+ * @brief Checks that the features of a configuration go together.
+ * @details Every rule of feature_rules whose feature is used is checked;
+ * the first conflict or missing feature is reported.
+ *
+ * @param[in] features The FEATURE_* bits, see config_features.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE after printing the conflict.
+ */
+int check_features(unsigned features) {
+    const int count = sizeof(feature_rules) / sizeof(feature_rules[0]);
+    unsigned clash;
+    int r, bit, used;
+
+    for (r = 0; r < count; r++) {
+        if ((features & feature_rules[r].feature) == 0)
+            continue;
+        for (used = 0; (feature_rules[r].feature >> used) != 1; used++)
+            ;
+        clash = features & feature_rules[r].excludes &
+            ~feature_rules[r].feature;
+        if (clash == 0)
+            clash = feature_rules[r].requires & ~features;
+        if (clash == 0)
+            continue;
+        for (bit = 0; (clash & (1u << bit)) == 0; bit++)
+            ;
+        fprintf(stderr, "%s %s %s.\n", feature_names[used],
+            features & clash ? "cannot be combined with" : "needs",
+            feature_names[bit]);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Prints the command line options to stderr.
+ *
+ * @param[in] program The name the program was started with.
+ */
+void print_usage(const char * program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fputs(
+        "  --rows N, --cols N   plate size, edges included, at least 3\n"
+        "  --threads N          OpenMP threads (default OMP_NUM_THREADS)\n"
+        "  --kernel NAME        auto, avx512, avx2, sse2 or scalar\n"
+        "  --block-steps K      time steps per cache tile pass (default 1)\n"
+        "  --tile-rows N        interior rows per tile (default 32)\n"
+        "  --tile-cols N        interior columns per tile (default 512)\n"
+        "  --solver NAME        explicit (time steps), or sor, multigrid or\n"
+        "                       direct (steady state)\n"
+        "  --omega W            SOR relaxation factor in (0, 2), default auto\n"
+        "  --norm NAME          change norm: l1 (sum, default), l1-mean,\n"
+        "                       l2 (root mean square) or linf (largest)\n"
+        "  --tolerance T        converged when the norm is below T (default 1)\n"
+        "  --relative           compare with T times the first measured norm\n"
+        "  --check-interval N   measure the change every N steps (default 1)\n"
+        "  --history            print every measured norm at the end\n"
+        "  --active-tiles N     only recompute N x N tiles near a change\n"
+        "  --active-epsilon E   also skip tiles whose neighbourhood changed\n"
+        "                       by at most E (approximate; default 0, exact)\n"
+        "  --bins N             heat levels of the histogram (default 10)\n"
+        "  --snapshot FILE      write binary snapshots of the plate to FILE\n"
+        "  --snapshot-every N   time steps between snapshots (default 1)\n"
+        "  --snapshot-encoding NAME\n"
+        "                       raw (default), delta (lossless, changed cells\n"
+        "                       only) or lossy (16 bits per cell)\n"
+        "  --checkpoint FILE    save the run to FILE now and then\n"
+        "  --checkpoint-every N time steps between checkpoints (default 1000)\n"
+        "  --restart            continue the run saved in the checkpoint FILE\n"
+        "  --pipeline N         report and write snapshots on a second thread\n"
+        "                       through a ring of N plate buffers\n"
+        "  --pipeline-drop      skip snapshot frames when the ring is full\n"
+        "                       instead of waiting (never the printed step\n"
+        "                       or the final state)\n"
+        "  --precision NAME     double (default), float, or mixed (float cells,\n"
+        "                       change summed in double); the tolerance must\n"
+        "                       stay above what float can resolve\n"
+        "  --compare-double     rerun the steps in double at the end and print\n"
+        "                       how far the plate is from it\n"
+        "  --temps T,B,L,R,I[,F,K]\n"
+        "                       top, bottom, left and right edge and initial\n"
+        "                       inner temperature (default 2,3,4,-5,1), and\n"
+        "                       the front and back face of a volume (6,0)\n"
+        "  --ensemble FILE      run one plate per line of FILE, each line\n"
+        "                       T,B,L,R,I as for --temps, side by side in\n"
+        "                       the vector lanes; each stops on converging\n"
+        "  --deterministic      add up the change in a fixed order, so runs\n"
+        "                       give the same result on any number of threads\n"
+        "  --benchmark-reduction N\n"
+        "                       time N measured steps with and without\n"
+        "                       --deterministic and check it on 1 .. --threads\n"
+        "                       threads, then exit\n"
+        "  --out-of-core FILE   keep the plate in FILE, which is overwritten,\n"
+        "                       and stream the time steps over it in bands\n"
+        "  --band-rows N        rows of an --out-of-core band (default 256)\n"
+        "  --placement NAME     first-touch (default): each thread writes the\n"
+        "                       rows it steps first, so they are on its NUMA\n"
+        "                       node; serial: the main thread writes them all\n"
+        "  --huge-pages NAME    none (default), transparent, or explicit\n"
+        "                       (2 MB pages reserved in vm.nr_hugepages)\n"
+        "  --pin                pin OpenMP thread t to the t-th allowed CPU\n"
+        "  --benchmark-placement N\n"
+        "                       time N steps with every placement and page\n"
+        "                       size, then exit\n"
+        "  --layers N           simulate a N x rows x cols block, edges\n"
+        "                       included, N at least 3\n"
+        "  --ranks N            split the plate among N processes, each\n"
+        "                       stepping its block on one thread\n"
+        "  --scaling N          time 1 .. N ranks on this plate (strong) and\n"
+        "                       on one this size per rank (weak), then exit\n"
+        "  --bench FILE         time calc_temp and the analytics for every\n"
+        "                       size, thread count up to --threads and\n"
+        "                       kernel, write the results to FILE as JSON\n"
+        "                       and exit (see 'make bench')\n"
+        "  --bench-sizes LIST   square plate sizes (default 128,512,2048)\n"
+        "  --bench-baseline FILE\n"
+        "                       flag cases slower than in this --bench file\n"
+        "  --bench-tolerance F  slowdown that counts as a regression\n"
+        "                       (default 0.1, 10%)\n"
+        "  --autotune           time the kernels, thread counts and, with\n"
+        "                       --block-steps, cache tiles on this plate\n"
+        "                       size and run the fastest; the choice is kept\n"
+        "                       in ~/.plate_heat_tune per CPU model and size\n"
+        "                       and reused by later runs\n"
+        "  --tune-cache FILE    keep the --autotune choices in FILE instead\n"
+        "  --daemon SOCKET      serve plate jobs on a UNIX socket, one command\n"
+        "                       a line: 'job rows=R cols=C boundary=T,B,L,R,I\n"
+        "                       threshold=X times=S,... steps=N' (any field\n"
+        "                       may be left out), 'stats', 'quit' or\n"
+        "                       'shutdown'\n"
+        "  --workers N          worker threads of --daemon (default\n"
+        "                       --threads)\n"
+        "  --trace FILE         write the timed phases, one track per\n"
+        "                       calling thread, as a Chrome trace to FILE\n"
+        "                       (make TRACE=1 only)\n"
+        "  --counters           also count cycles and LLC misses of the\n"
+        "                       OpenMP threads (make TRACE=1 only)\n",
+        stderr
+    );
+
+    return;
+}
+
+/**
+ * @brief Converts a whole decimal string to a positive int.
+ *
+ * @param[in] text The string to convert.
+ * @param[out] value Where the number is stored on success.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the text is not a positive int.
+ */
+int parse_positive_int(const char * text, int * value) {
+    char * end;
+    long number;
+
+    number = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || number <= 0 || number > 1 << 30)
+        return EXIT_FAILURE;
+    *value = (int) number;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Converts a solver name to its Solver_t value.
+ *
+ * @param[in] text "explicit", "sor", "multigrid" or "direct".
+ * @param[out] solver Where the solver is stored on success.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE for an unknown name.
+ */
+int parse_solver(const char * text, Solver_t * solver) {
+    if (strcmp(text, "explicit") == 0)
+        *solver = SOLVER_EXPLICIT;
+    else if (strcmp(text, "sor") == 0)
+        *solver = SOLVER_SOR;
+    else if (strcmp(text, "multigrid") == 0)
+        *solver = SOLVER_MULTIGRID;
+    else if (strcmp(text, "direct") == 0)
+        *solver = SOLVER_DIRECT;
+    else
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Converts a norm name to its Norm_t value.
+ *
+ * @param[in] text "l1", "l1-mean", "l2" or "linf".
+ * @param[out] norm Where the norm is stored on success.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE for an unknown name.
+ */
+int parse_norm(const char * text, Norm_t * norm) {
+    if (strcmp(text, "l1") == 0)
+        *norm = NORM_L1;
+    else if (strcmp(text, "l1-mean") == 0)
+        *norm = NORM_L1_MEAN;
+    else if (strcmp(text, "l2") == 0)
+        *norm = NORM_L2;
+    else if (strcmp(text, "linf") == 0)
+        *norm = NORM_LINF;
+    else
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Converts a snapshot encoding name to its Snapshot_encoding_t value.
+ *
+ * @param[in] text "raw", "delta" or "lossy".
+ * @param[out] encoding Where the encoding is stored on success.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE for an unknown name.
+ */
+int parse_encoding(const char * text, Snapshot_encoding_t * encoding) {
+    if (strcmp(text, "raw") == 0)
+        *encoding = SNAPSHOT_RAW;
+    else if (strcmp(text, "delta") == 0)
+        *encoding = SNAPSHOT_DELTA;
+    else if (strcmp(text, "lossy") == 0)
+        *encoding = SNAPSHOT_LOSSY;
+    else
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Converts a precision name to its Precision_t value.
+ *
+ * @param[in] text "double", "float" or "mixed".
+ * @param[out] precision Where the precision is stored on success.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE for an unknown name.
+ */
+int parse_precision(const char * text, Precision_t * precision) {
+    if (strcmp(text, "double") == 0)
+        *precision = PRECISION_DOUBLE;
+    else if (strcmp(text, "float") == 0)
+        *precision = PRECISION_FLOAT;
+    else if (strcmp(text, "mixed") == 0)
+        *precision = PRECISION_MIXED;
+    else
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Converts a placement name to its Placement_t value.
+ *
+ * @param[in] text "first-touch" or "serial".
+ * @param[out] placement Where the placement is stored on success.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE for an unknown name.
+ */
+int parse_placement(const char * text, Placement_t * placement) {
+    if (strcmp(text, "first-touch") == 0)
+        *placement = PLACEMENT_FIRST_TOUCH;
+    else if (strcmp(text, "serial") == 0)
+        *placement = PLACEMENT_SERIAL;
+    else
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Converts a huge page name to its Huge_pages_t value.
+ *
+ * @param[in] text "none", "transparent" or "explicit".
+ * @param[out] huge_pages Where the choice is stored on success.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE for an unknown name.
+ */
+int parse_huge_pages(const char * text, Huge_pages_t * huge_pages) {
+    if (strcmp(text, "none") == 0)
+        *huge_pages = HUGE_PAGES_NONE;
+    else if (strcmp(text, "transparent") == 0)
+        *huge_pages = HUGE_PAGES_TRANSPARENT;
+    else if (strcmp(text, "explicit") == 0)
+        *huge_pages = HUGE_PAGES_EXPLICIT;
+    else
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Pins every OpenMP thread to one CPU.
+ * @details Thread t gets the t-th CPU the process may run on, wrapping
+ * around if there are more threads than CPUs. OpenMP keeps the same
+ * threads for later parallel regions of the same size, so their rows stay
+ * next to the memory they placed. Threads started later, like the
+ * pipeline's, inherit the main thread's CPU.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if a thread could not be pinned or
+ * the platform has no CPU affinity.
+ */
+int pin_threads(void) {
+#if defined(__linux__) && defined(_OPENMP)
+    cpu_set_t allowed;
+    int failed = 0, count;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return EXIT_FAILURE;
+    count = CPU_COUNT(&allowed);
+
+    #pragma omp parallel reduction(|:failed)
+    {
+        int skip = omp_get_thread_num() % count, cpu = 0;
+        cpu_set_t one;
+
+        while (!CPU_ISSET(cpu, &allowed) || skip-- > 0)
+            cpu++;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        failed = sched_setaffinity(0, sizeof(one), &one) != 0;
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+#else
+    return EXIT_FAILURE;
+#endif
+}
+
+/**
+ * @brief Reads five temperatures: top, bottom, left, right and inner, and
+ * optionally two more, front and back.
+ * @details They may be separated by commas, blanks or both. Without the
+ * last two, front and back get their defaults.
+ *
+ * @param[in] text The temperatures, e.g. "2,3,4,-5,1" or "2,3,4,-5,1,6,0".
+ * @param[out] boundary Where they are stored on success.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE unless the text holds exactly five
+ * or seven numbers.
+ */
+int parse_boundary(const char * text, Boundary_t * boundary) {
+    double value[7];
+    char * end;
+    int i;
+
+    value[5] = TEMP_FRONT;
+    value[6] = TEMP_BACK;
+    for (i = 0; i < 7; i++) {
+        while (*text == ',' || *text == ' ' || *text == '\t')
+            text++;
+        if (i == 5 && (*text == '\0' || *text == '\n' || *text == '\r'))
+            break;
+        value[i] = strtod(text, &end);
+        if (end == text)
+            return EXIT_FAILURE;
+        text = end;
+    }
+    while (*text == ',' || *text == ' ' || *text == '\t' || *text == '\n' ||
+        *text == '\r')
+        text++;
+    if (*text != '\0')
+        return EXIT_FAILURE;
+    boundary->top = value[0];
+    boundary->bottom = value[1];
+    boundary->left = value[2];
+    boundary->right = value[3];
+    boundary->inner = value[4];
+    boundary->front = value[5];
+    boundary->back = value[6];
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reads a clock for measuring how long something takes.
+ *
+ * @return Seconds since some fixed point in the past.
+ */
+double wall_seconds(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + 1e-9 * now.tv_nsec;
+}
+
+/**
+ * @brief Ends a run with the report of make TRACE=1.
+ * @details Other builds only return status.
+ *
+ * @param[in] config The settings, for --trace.
+ * @param[in] status How the run ended.
+ *
+ * @return status, or EXIT_FAILURE if the trace file was not written.
+ */
+int finish_trace(const Config_t * config, int status) {
+#ifdef PLATE_TRACE
+    if (trace_report(config->trace) != EXIT_SUCCESS) {
+        fprintf(stderr, "Could not write the trace file '%s'.\n",
+            config->trace);
+        status = EXIT_FAILURE;
+    }
+#else
+    (void) config;
+#endif
+
+    return status;
+}
+
+#ifdef PLATE_TRACE
+/**
+ * @brief Starts the tracer of make TRACE=1.
+ * @details Sets the time events are measured from. With counters, every
+ * OpenMP thread opens a perf_event counter of its own cycles and one of
+ * its LLC misses, in user space only, which trace_report reads back from
+ * the same thread. If any of them cannot be opened (no permission, see
+ * /proc/sys/kernel/perf_event_paranoid, or no PMU in a virtual machine)
+ * there are no counters at all.
+ *
+ * @param[in] counters Non-zero to count cycles and LLC misses.
+ */
+void trace_start(int counters) {
+    int failed = 0, t;
+
+    trace_epoch = 0;
+    trace_epoch = trace_now();
+    for (t = 0; t < TRACE_THREADS; t++) {
+        trace_counter[t][0] = trace_counter[t][1] = -1;
+    }
+    trace_counters = 0;
+    if (!counters)
+        return;
+
+    #pragma omp parallel reduction(|:failed)
+    {
+        int id = 0, c;
+
+#ifdef _OPENMP
+        id = omp_get_thread_num();
+#endif
+        if (id < TRACE_THREADS) {
+            trace_counter[id][0] = open_counter(PERF_COUNT_HW_CPU_CYCLES);
+            trace_counter[id][1] = open_counter(PERF_COUNT_HW_CACHE_MISSES);
+            for (c = 0; c < 2; c++) {
+                failed |= trace_counter[id][c] < 0;
+            }
+        }
+    }
+    trace_counters = !failed;
+    if (failed) {
+        close_counters();
+        fputs("Hardware counters are not available.\n", stderr);
+    }
+
+    return;
+}
+
+/**
+ * @brief Opens a hardware counter of the calling thread.
+ *
+ * @param[in] event The PERF_COUNT_HW_* event to count.
+ *
+ * @return The counter's file descriptor, or -1.
+ */
+int open_counter(int event) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = event;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void) event;
+
+    return -1;
+#endif
+}
+
+/**
+ * @brief Closes the counters trace_start opened.
+ * @details Every descriptor is set to -1, so it can run more than once.
+ */
+void close_counters(void) {
+    int t, c;
+
+    for (t = 0; t < TRACE_THREADS; t++) {
+        for (c = 0; c < 2; c++) {
+            if (trace_counter[t][c] >= 0)
+                close(trace_counter[t][c]);
+            trace_counter[t][c] = -1;
+        }
+    }
+
+    return;
+}
+
+/**
+ * @brief Nanoseconds since trace_start.
+ *
+ * @return The time on the monotonic clock, less trace_epoch.
+ */
+long long trace_now(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000000LL + now.tv_nsec - trace_epoch;
+}
+
+/**
+ * @brief Records one phase of the calling thread.
+ * @details The hooks wrap whole calls, parallel loops included, so an
+ * event is the time the calling thread (the main thread, a daemon worker
+ * or the analysis thread of the pipeline) spent in the phase, not the
+ * work of each OpenMP thread inside it. The first event of a thread
+ * takes the next ring, which is allocated then and kept until the process
+ * exits. A thread past the first TRACE_THREADS, or one whose ring could
+ * not be allocated, records nothing. The ring keeps the last
+ * TRACE_EVENTS events; the calls and totals of the phases count every
+ * one.
+ *
+ * @param[in] phase The phase that ran.
+ * @param[in] start When it started, from trace_now.
+ */
+void trace_record(Phase_t phase, long long start) {
+    const long long end = trace_now();
+    Trace_ring_t * ring = trace_mine;
+    Trace_event_t * event;
+    int slot;
+
+    if (ring == NULL) {
+        slot = __atomic_fetch_add(&trace_threads, 1, __ATOMIC_RELAXED);
+        if (slot >= TRACE_THREADS)
+            return;
+        ring = calloc(1, sizeof(Trace_ring_t));
+        if (ring == NULL)
+            return;
+        __atomic_store_n(&trace_ring[slot], ring, __ATOMIC_RELEASE);
+        trace_mine = ring;
+    }
+    event = ring->event + ring->count % TRACE_EVENTS;
+    event->phase = phase;
+    event->start = start;
+    event->end = end;
+    ring->count++;
+    ring->calls[phase]++;
+    ring->total[phase] += end - start;
+
+    return;
+}
+
+/**
+ * @brief Prints what the tracer recorded and writes the trace file.
+ * @details For every phase: its calls and total time over all calling
+ * threads, and the mean of a call. The phases can nest (the reduction of a
+ * deterministic step is part of its stencil, and a lossy snapshot finds
+ * the temperature range), so the totals may overlap. With counters, the
+ * cycles and LLC misses of the OpenMP threads since trace_start, and the
+ * memory bandwidth of the misses at 64 bytes a line; writebacks are not
+ * counted, so that is a lower bound. The counters are closed then.
+ *
+ * @param[in] path The Chrome trace file to write, or NULL for none.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the trace file was not written.
+ */
+int trace_report(const char * path) {
+    const int threads = trace_threads < TRACE_THREADS ?
+        trace_threads : TRACE_THREADS;
+    const double seconds = 1e-9 * trace_now();
+    double cycles = 0, misses = 0;
+    long calls, events = 0;
+    long long total;
+    int p, t;
+
+    printf("Trace: %-10s %10s %12s %12s\n", "phase", "calls", "total ms",
+        "mean us");
+    for (p = 0; p < PHASE_COUNT; p++) {
+        calls = 0;
+        total = 0;
+        for (t = 0; t < threads; t++) {
+            if (trace_ring[t] != NULL) {
+                calls += trace_ring[t]->calls[p];
+                total += trace_ring[t]->total[p];
+            }
+        }
+        if (calls > 0)
+            printf("Trace: %-10s %10ld %12.3f %12.3f\n", trace_phase[p],
+                calls, 1e-6 * total, 1e-3 * total / calls);
+    }
+    for (t = 0; t < threads; t++) {
+        if (trace_ring[t] != NULL)
+            events += trace_ring[t]->count;
+    }
+    printf("Trace: %ld events on %d threads\n", events, threads);
+
+    if (trace_counters) {
+        #pragma omp parallel reduction(+:cycles, misses)
+        {
+            uint64_t value;
+            int id = 0;
+
+#ifdef _OPENMP
+            id = omp_get_thread_num();
+#endif
+            if (id < TRACE_THREADS && trace_counter[id][0] >= 0 &&
+                read(trace_counter[id][0], &value, sizeof(value))
+                    == sizeof(value))
+                cycles += value;
+            if (id < TRACE_THREADS && trace_counter[id][1] >= 0 &&
+                read(trace_counter[id][1], &value, sizeof(value))
+                    == sizeof(value))
+                misses += value;
+        }
+        close_counters();
+        printf(
+            "Counters: %.3e cycles, %.3e LLC misses, at least %.1f MB/s "
+            "from memory over %.3f s\n", cycles, misses,
+            1e-6 * 64 * misses / seconds, seconds
+        );
+    }
+
+    return path == NULL ? EXIT_SUCCESS : write_trace(path);
+}
+
+/**
+ * @brief Writes the events of every ring as a Chrome trace.
+ * @details The JSON trace event format of chrome://tracing and Perfetto:
+ * one complete ("X") event per call, its times in microseconds, with the
+ * ring as the thread, one event per line.
+ *
+ * @param[in] path The file to write.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if it could not be written.
+ */
+int write_trace(const char * path) {
+    const int threads = trace_threads < TRACE_THREADS ?
+        trace_threads : TRACE_THREADS;
+    const long pid = (long) getpid();
+    FILE * file = fopen(path, "w");
+    const Trace_event_t * event;
+    long first, e;
+    int t, comma = 0;
+
+    if (file == NULL)
+        return EXIT_FAILURE;
+
+    fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n", file);
+    for (t = 0; t < threads; t++) {
+        if (trace_ring[t] == NULL)
+            continue;
+        first = trace_ring[t]->count > TRACE_EVENTS ?
+            trace_ring[t]->count - TRACE_EVENTS : 0;
+        for (e = first; e < trace_ring[t]->count; e++) {
+            event = trace_ring[t]->event + e % TRACE_EVENTS;
+            fprintf(file,
+                "%s{\"name\": \"%s\", \"cat\": \"plate\", \"ph\": \"X\", "
+                "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %ld, \"tid\": %d}",
+                comma ? ",\n" : "", trace_phase[event->phase],
+                1e-3 * event->start, 1e-3 * (event->end - event->start),
+                pid, t
+            );
+            comma = 1;
+        }
+    }
+    fputs("\n]}\n", file);
+
+    return fclose(file) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+/**
+ * @brief Sets up a plate whose grids live in a memory-mapped file.
+ * @details The layout is the one of create_plate, with both grids one
+ * after the other in the file, so every other function works on the
+ * plate unchanged. The file is created or truncated; it starts sparse and
+ * all zero, and after the run holds the last two time steps. The kernel
+ * pages the grids in and out, and stream_step keeps the part of them
+ * that is resident small.
+ *
+ * @param[out] plate The plate to set up.
+ * @param[in] rows Number of rows, edges included.
+ * @param[in] cols Number of columns, edges included.
+ * @param[in] path The file to keep the grids in.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be created or
+ * mapped.
+ */
+int create_plate_mapped(
+    Plate_t * plate, int rows, int cols, const char * path
+) {
+    const int line = PLATE_ALIGN / sizeof(double);
+    size_t cells;
+    void * map;
+    int fd;
+
+    plate->rows = rows;
+    plate->cols = cols;
+    plate->pitch = (PLATE_LEAD + cols + line - 1) / line * line;
+    plate->grids = 2;
+    plate->current = 0;
+    cells = (size_t) plate->pitch * rows;
+    plate->mapped = 2 * cells * sizeof(double);
+    plate->partial = malloc(sizeof(double) * 2 * rows);
+    if (plate->partial == NULL)
+        return EXIT_FAILURE;
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(plate->partial);
+        return EXIT_FAILURE;
+    }
+    map = MAP_FAILED;
+    if (ftruncate(fd, (off_t) plate->mapped) == 0)
+        map = mmap(
+            NULL, plate->mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+        );
+    close(fd);
+    if (map == MAP_FAILED) {
+        free(plate->partial);
+        return EXIT_FAILURE;
+    }
+    plate->grid[0] = (double *) map + PLATE_LEAD;
+    plate->grid[1] = (double *) map + cells + PLATE_LEAD;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Allocates a single-precision plate with two grids.
+ * @details The layout is the one create_plate uses, with PLATE_FLOAT_LEAD
+ * cells in front of each row so column 1 is aligned. As there, the
+ * interior rows are zeroed by the threads stencil_step_float gives them
+ * and the edge rows by the calling thread.
+ *
+ * @param[out] plate The plate to create.
+ * @param[in] rows The number of rows, edges included.
+ * @param[in] cols The number of columns, edges included.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the allocation failed.
+ */
+int create_plate_float(Plate_float_t * plate, int rows, int cols) {
+    const int line = PLATE_ALIGN / sizeof(float);
+    size_t bytes;
+    int i;
+
+    plate->rows = rows;
+    plate->cols = cols;
+    plate->pitch = (PLATE_FLOAT_LEAD + cols + line - 1) / line * line;
+    plate->current = 0;
+    plate->partial = malloc(sizeof(double) * 2 * rows);
+    if (plate->partial == NULL)
+        return EXIT_FAILURE;
+    bytes = sizeof(float) * plate->pitch * rows;
+
+    for (i = 0; i < 2; i++) {
+        void * memory;
+
+        if (posix_memalign(&memory, PLATE_ALIGN, bytes) != 0) {
+            if (i == 1)
+                free(plate->grid[0] - PLATE_FLOAT_LEAD);
+            plate->grid[0] = NULL;
+            free(plate->partial);
+            plate->partial = NULL;
+            return EXIT_FAILURE;
+        }
+        plate->grid[i] = (float *) memory + PLATE_FLOAT_LEAD;
+    }
+    #pragma omp parallel for schedule(static) \
+        if (placement == PLACEMENT_FIRST_TOUCH)
+    for (i = 1; i < rows - 1; i++) {
+        int g;
+
+        for (g = 0; g < 2; g++) {
+            memset(
+                plate->grid[g] + (size_t) i * plate->pitch -
+                    PLATE_FLOAT_LEAD, 0, sizeof(float) * plate->pitch
+            );
+        }
+    }
+    for (i = 0; i < 2; i++) {
+        memset(
+            plate->grid[i] - PLATE_FLOAT_LEAD, 0,
+            sizeof(float) * plate->pitch
+        );
+        memset(
+            plate->grid[i] + (size_t) (rows - 1) * plate->pitch -
+                PLATE_FLOAT_LEAD, 0, sizeof(float) * plate->pitch
+        );
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Releases a plate created with create_plate_float. A plate whose
+ * grids are NULL is left alone.
+ *
+ * @param[in,out] plate The plate to release.
+ */
+void destroy_plate_float(Plate_float_t * plate) {
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (plate->grid[i] != NULL)
+            free(plate->grid[i] - PLATE_FLOAT_LEAD);
+        plate->grid[i] = NULL;
+    }
+    free(plate->partial);
+    plate->partial = NULL;
+
+    return;
+}
+
+/**
+ * @brief Rounds a plate to single precision, into both grids.
+ *
+ * @param[out] single The single-precision plate of the same size.
+ * @param[in] plate The plate to copy.
+ */
+void narrow_plate(Plate_float_t * single, const Plate_t * plate) {
+    const double * data = plate_data(plate);
+    int g, i, j;
+    TRACE_START(start);
+
+    single->current = 0;
+    for (g = 0; g < 2; g++) {
+        #pragma omp parallel for schedule(static) private(j)
+        for (i = 0; i < plate->rows; i++) {
+            const double * row = data + (size_t) i * plate->pitch;
+            float * out = single->grid[g] + (size_t) i * single->pitch;
+
+            for (j = 0; j < plate->cols; j++) {
+                out[j] = (float) row[j];
+            }
+        }
+    }
+    TRACE_STOP(PHASE_COPY, start);
+
+    return;
+}
+
+/**
+ * @brief Copies the current grid of a single-precision plate into the
+ * current grid of a plate. Every float is exactly a double, so narrowing
+ * the copy again gives back the same plate.
+ *
+ * @param[out] plate The plate to overwrite.
+ * @param[in] single The single-precision plate of the same size.
+ */
+void widen_plate(Plate_t * plate, const Plate_float_t * single) {
+    const float * data = single->grid[single->current];
+    double * out = plate_data(plate);
+    int i, j;
+    TRACE_START(start);
+
+    #pragma omp parallel for schedule(static) private(j)
+    for (i = 0; i < plate->rows; i++) {
+        const float * row = data + (size_t) i * single->pitch;
+        double * cell = out + (size_t) i * plate->pitch;
+
+        for (j = 0; j < plate->cols; j++) {
+            cell[j] = row[j];
+        }
+    }
+    TRACE_STOP(PHASE_COPY, start);
+
+    return;
+}
+
+/**
+ * @brief Brings the double plate up to date before it is read.
+ * @details In single precision the solver only steps workspace->single;
+ * the double plate is refreshed here, when a report, snapshot,
+ * checkpoint or the final state needs it, and not after every step.
+ *
+ * @param[in,out] plate The plate to refresh.
+ * @param[in,out] workspace The solver's workspace.
+ */
+void sync_plate(Plate_t * plate, Workspace_t * workspace) {
+    if (workspace->single_ahead) {
+        widen_plate(plate, &workspace->single);
+        workspace->single_ahead = 0;
+    }
+
+    return;
+}
+
+/**
+ * @brief Prints how far a plate is from the double-precision run.
+ * @details The plate is stepped again from its initial state in double
+ * precision for the same number of time steps, and the two are compared
+ * cell by cell. The time of that run is printed next to the time of the
+ * run being checked.
+ *
+ * @param[in] plate The plate after the run being checked.
+ * @param[in] boundary The temperatures the run started from.
+ * @param[in] time The time steps of that run.
+ * @param[in] seconds How long that run took.
+ */
+void compare_precision(
+    const Plate_t * plate, const Boundary_t * boundary, int time,
+    double seconds
+) {
+    Plate_t reference;
+    const double * data, * check = plate_data(plate);
+    double start, max = 0, sum_sq = 0;
+    int i, j;
+
+    if (create_plate(&reference, plate->rows, plate->cols, 2)
+        != EXIT_SUCCESS) {
+        fputs("Could not allocate the double-precision plate.\n", stderr);
+        return;
+    }
+    init_plate(&reference, boundary);
+    start = wall_seconds();
+    for (i = 0; i < time; i++) {
+        stencil_step(&reference, 0);
+    }
+    start = wall_seconds() - start;
+
+    data = plate_data(&reference);
+    for (i = 1; i < plate->rows - 1; i++) {
+        for (j = 1; j < plate->cols - 1; j++) {
+            double d = fabs(
+                check[(size_t) i * plate->pitch + j] -
+                data[(size_t) i * reference.pitch + j]
+            );
+
+            sum_sq += d * d;
+            if (d > max)
+                max = d;
+        }
+    }
+    printf(
+        "Against double after %d steps: largest difference %.3e, "
+        "RMS %.3e; %.3f s here, %.3f s in double\n", time, max,
+        sqrt(sum_sq / ((double) (plate->rows - 2) * (plate->cols - 2))),
+        seconds, start
+    );
+    destroy_plate(&reference);
+
+    return;
+}
+
+/**
+ * @brief Allocates the memory the configured solver keeps between steps.
+ * @details The multigrid solver builds its hierarchy here. Coarse cell I
+ * lies on fine cell 2I, so n interior cells become (n - 1) / 2. With an odd
+ * n the coarse edge falls on the fine edge; with an even n it falls on the
+ * last fine interior cell, which is then left to the smoother. Plates of
+ * 2^k + 1 cells nest at every level and converge fastest. Coarsening stops
+ * when either side has fewer than four interior cells. The finest level
+ * works directly on the plate's grid.
+ * The direct solver keeps one sine transform plan per plate direction
+ * and a transform buffer per thread, or FFTW's buffer and plan, so its
+ * solve allocates nothing. The explicit solver keeps its active set if
+ * --active-tiles is given, or its single-precision plate for --precision
+ * float and mixed.
+ *
+ * @param[out] workspace The workspace to set up.
+ * @param[in] plate The plate the solver will work on.
+ * @param[in] config The solver settings.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if an allocation failed.
+ */
+int create_workspace(
+    Workspace_t * workspace, const Plate_t * plate, const Config_t * config
+) {
+    Mg_level_t * level;
+    size_t cells;
+    int rows = plate->rows, cols = plate->cols;
+
+    workspace->levels = 0;
+    workspace->residual = 0;
+    memset(&workspace->dst_row, 0, sizeof(Dst_plan_t));
+    memset(&workspace->dst_col, 0, sizeof(Dst_plan_t));
+    workspace->dst_threads = 0;
+    workspace->dst_work = NULL;
+#ifdef PLATE_USE_FFTW
+    workspace->fftw_buffer = NULL;
+    workspace->fftw = NULL;
+#endif
+    memset(&workspace->active, 0, sizeof(Active_set_t));
+    memset(&workspace->single, 0, sizeof(Plate_float_t));
+    workspace->single_ahead = 0;
+    if (config->precision != PRECISION_DOUBLE)
+        return create_plate_float(
+            &workspace->single, plate->rows, plate->cols
+        );
+    if (config->active_tile > 0)
+        return create_active_set(
+            &workspace->active, plate, config->active_tile,
+            config->active_epsilon
+        );
+    if (config->solver == SOLVER_DIRECT) {
+#ifdef PLATE_USE_FFTW
+        workspace->fftw_buffer = fftw_malloc(
+            sizeof(double) * (rows - 2) * (cols - 2)
+        );
+        if (workspace->fftw_buffer != NULL)
+            workspace->fftw = fftw_plan_r2r_2d(
+                rows - 2, cols - 2, workspace->fftw_buffer,
+                workspace->fftw_buffer, FFTW_RODFT00, FFTW_RODFT00,
+                FFTW_ESTIMATE
+            );
+        if (workspace->fftw == NULL) {
+            destroy_workspace(workspace);
+            return EXIT_FAILURE;
+        }
+#else
+        int work_size;
+
+        if (create_dst_plan(&workspace->dst_row, cols - 2) != EXIT_SUCCESS ||
+            create_dst_plan(&workspace->dst_col, rows - 2) != EXIT_SUCCESS) {
+            destroy_workspace(workspace);
+            return EXIT_FAILURE;
+        }
+        work_size = workspace->dst_row.fft_size > workspace->dst_col.fft_size ?
+            workspace->dst_row.fft_size : workspace->dst_col.fft_size;
+#ifdef _OPENMP
+        workspace->dst_threads = omp_get_max_threads();
+#else
+        workspace->dst_threads = 1;
+#endif
+        workspace->dst_work = malloc(
+            sizeof(double complex) * 2 * work_size * workspace->dst_threads
+        );
+        if (workspace->dst_work == NULL) {
+            destroy_workspace(workspace);
+            return EXIT_FAILURE;
+        }
+#endif
+        return EXIT_SUCCESS;
+    }
+    if (config->solver != SOLVER_MULTIGRID)
+        return EXIT_SUCCESS;
+
+    while (workspace->levels < MG_MAX_LEVELS) {
+        level = &workspace->level[workspace->levels];
+        level->rows = rows;
+        level->cols = cols;
+        if (workspace->levels == 0) {
+            level->pitch = plate->pitch;
+            level->u = plate_data(plate);
+            level->f = NULL;
+        } else {
+            level->pitch = cols;
+            level->u = level->f = NULL;
+        }
+        cells = level->pitch * rows;
+        level->r = calloc(cells, sizeof(double));
+        level->partial = malloc(sizeof(double) * 2 * rows);
+        if (workspace->levels > 0) {
+            level->u = calloc(cells, sizeof(double));
+            level->f = calloc(cells, sizeof(double));
+        }
+        workspace->levels++;
+        if (level->r == NULL || level->partial == NULL ||
+            (workspace->levels > 1 && (level->u == NULL || level->f == NULL))) {
+            destroy_workspace(workspace);
+            return EXIT_FAILURE;
+        }
+        if (rows - 2 < 4 || cols - 2 < 4)
+            break;
+        rows = (rows - 3) / 2 + 2;
+        cols = (cols - 3) / 2 + 2;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Releases what create_workspace allocated.
+ *
+ * @param[in,out] workspace The workspace to release.
+ */
+void destroy_workspace(Workspace_t * workspace) {
+    int i;
+
+    for (i = 0; i < workspace->levels; i++) {
+        free(workspace->level[i].r);
+        free(workspace->level[i].partial);
+        if (i > 0) {
+            free(workspace->level[i].u);
+            free(workspace->level[i].f);
+        }
+    }
+    workspace->levels = 0;
+    destroy_dst_plan(&workspace->dst_row);
+    destroy_dst_plan(&workspace->dst_col);
+    free(workspace->dst_work);
+    workspace->dst_work = NULL;
+#ifdef PLATE_USE_FFTW
+    if (workspace->fftw != NULL)
+        fftw_destroy_plan(workspace->fftw);
+    fftw_free(workspace->fftw_buffer);
+    workspace->fftw = NULL;
+    workspace->fftw_buffer = NULL;
+#endif
+    destroy_active_set(&workspace->active);
+    destroy_plate_float(&workspace->single);
+
+    return;
+}
+
+/**
+ * @brief Moves the plate forward with the configured solver.
+ * @details For the explicit solver a step is a time step, for SOR it is
+ * one sweep over the plate and for multigrid one V-cycle. The direct
+ * solver finishes in its first step, which ends with one calc_temp step as
+ * a check.
+ * Steps run without any reduction unless change is given. The explicit
+ * solver then gets the sum from its fused kernels when the norm only needs
+ * the sum, and otherwise compares its two grids after the last step.
+ * In single precision the steps advance workspace->single and leave the
+ * plate behind until sync_plate. An --out-of-core plate is streamed by
+ * stream_step.
+ *
+ * @param[in,out] plate The plate.
+ * @param[in] config The solver settings.
+ * @param[in,out] workspace The solver's memory from create_workspace.
+ * @param[in] steps Number of steps, sweeps or cycles to take.
+ * @param[out] change Receives the change statistics of the last step, or
+ * NULL if they are not needed.
+ */
+void advance_plate(
+    Plate_t * plate, const Config_t * config, Workspace_t * workspace,
+    int steps, Change_t * change
+) {
+    const int sum_only = config->norm == NORM_L1 ||
+        config->norm == NORM_L1_MEAN;
+    Change_t last = { 0, 0, 0 };
+    int i;
+
+    if (config->solver == SOLVER_SOR) {
+        for (i = 0; i < steps; i++)
+            last = sor_sweep(plate, config->omega);
+    } else if (config->solver == SOLVER_MULTIGRID) {
+        for (i = 0; i < steps; i++)
+            last = multigrid_cycle(workspace);
+    } else if (config->precision != PRECISION_DOUBLE) {
+        const int mode = change == NULL || !sum_only ? MEASURE_NONE :
+            config->precision == PRECISION_MIXED ?
+            MEASURE_DOUBLE : MEASURE_SINGLE;
+
+        for (i = 0; i < steps; i++)
+            last.sum = stencil_step_float(
+                &workspace->single, i == steps - 1 ? mode : MEASURE_NONE
+            );
+        last.sum_sq = last.max = -1;
+        if (change != NULL && !sum_only)
+            measure_change_float(&workspace->single, &last);
+        workspace->single_ahead = 1;
+    } else {
+        if (config->solver == SOLVER_DIRECT)
+            solve_direct(plate, workspace);
+        if (config->out_of_core != NULL) {
+            for (i = 0; i < steps; i++)
+                last.sum = stream_step(
+                    plate, change != NULL && sum_only && i == steps - 1,
+                    config->band_rows
+                );
+            last.sum_sq = last.max = -1;
+            if (change != NULL && !sum_only)
+                measure_change(plate, &last);
+        } else if (config->active_tile > 0) {
+            for (i = 0; i < steps; i++)
+                last.sum = active_step(plate, &workspace->active);
+            last.sum_sq = last.max = -1;
+            if (change != NULL && !sum_only)
+                measure_change(plate, &last);
+        } else if (change == NULL || sum_only) {
+            last.sum = calc_temp_blocked(
+                plate, steps, config->tile_rows, config->tile_cols,
+                change != NULL
+            );
+            last.sum_sq = last.max = -1;
+        } else {
+            /*  The back grid must hold the step before the last one. */
+            if (steps > 1)
+                calc_temp_blocked(
+                    plate, steps - 1, config->tile_rows, config->tile_cols, 0
+                );
+            stencil_step(plate, 0);
+            measure_change(plate, &last);
+        }
+    }
+    if (change != NULL)
+        *change = last;
+
+    return;
+}
+
+/**
+ * @brief One time step of a mapped plate, streamed in bands of rows.
+ * @details The bands are done one after the other and the rows of a band
+ * are split among the OpenMP threads. While a band is computed the kernel
+ * is asked to read the next one ahead; once it is done, its rows are
+ * released from the process, except for the last old row, which is the
+ * top halo of the next band. So only about two bands of each grid are
+ * resident at a time. Every row is computed by the same row kernel as in
+ * stencil_step and the row sums are added in row order (or by
+ * sum_partials for --deterministic), so the plate and the change are
+ * those of the in-memory path on one thread.
+ *
+ * @param[in,out] plate The plate, advanced to the next time step.
+ * @param[in] measure Non-zero to sum the absolute changes.
+ * @param[in] band_rows Interior rows per band.
+ *
+ * @return The total absolute change, or 0 if measure is zero.
+ */
+double stream_step(Plate_t * plate, int measure, int band_rows) {
+    const size_t pitch = plate->pitch;
+    const int rows = plate->rows, cols = plate->cols;
+    double * old = plate_data(plate);
+    double * new = plate_back(plate);
+    double delta_temp = 0;
+    int band, end, next, i;
+
+    for (band = 1; band < rows - 1; band = end) {
+        end = band + band_rows < rows - 1 ? band + band_rows : rows - 1;
+        next = end + band_rows < rows - 1 ? end + band_rows : rows - 1;
+        if (end < rows - 1) {
+            posix_madvise(
+                old + (end + 1) * pitch - PLATE_LEAD,
+                sizeof(double) * (next - end) * pitch, POSIX_MADV_WILLNEED
+            );
+            posix_madvise(
+                new + end * pitch - PLATE_LEAD,
+                sizeof(double) * (next - end) * pitch, POSIX_MADV_WILLNEED
+            );
+        }
+        #pragma omp parallel for schedule(static)
+        for (i = band; i < end; i++) {
+            plate->partial[i] = row_kernel(
+                old + (i - 1) * pitch, old + i * pitch, old + (i + 1) * pitch,
+                new + i * pitch, cols - 2, measure
+            );
+        }
+        release_rows(plate, old, band - 1, end - 1);
+        release_rows(plate, new, band, end);
+    }
+    if (measure && deterministic)
+        delta_temp = sum_partials(plate->partial + 1, rows - 2);
+    else if (measure)
+        for (i = 1; i < rows - 1; i++) {
+            delta_temp += plate->partial[i];
+        }
+    swap_plate(plate);
+
+    return delta_temp;
+}
+
+/**
+ * @brief Drops rows of a mapped grid from the process.
+ * @details Only whole pages inside the rows are released. The mapping is
+ * shared, so changed pages stay in the page cache and reach the file;
+ * the next access reads them back. posix_madvise cannot do this, its
+ * POSIX_MADV_DONTNEED is ignored by glibc.
+ *
+ * @param[in] plate The mapped plate.
+ * @param[in] grid One of its grids.
+ * @param[in] first The first row to release.
+ * @param[in] last One past the last row to release.
+ */
+void release_rows(const Plate_t * plate, double * grid, int first, int last) {
+#ifdef MADV_DONTNEED
+    const uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) (grid + (size_t) first * plate->pitch -
+        PLATE_LEAD);
+    uintptr_t stop = (uintptr_t) (grid + (size_t) last * plate->pitch -
+        PLATE_LEAD);
+
+    start = (start + page - 1) / page * page;
+    stop = stop / page * page;
+    if (stop > start)
+        madvise((void *) start, stop - start, MADV_DONTNEED);
+#else
+    (void) plate;
+    (void) grid;
+    (void) first;
+    (void) last;
+#endif
+
+    return;
+}
+
+/**
+ * @brief Measures how fast the file behind a mapped plate can be read.
+ * @details The plate is written back and dropped from memory first, so
+ * the file is read from storage and the run starts with a cold plate, as
+ * one too large for memory would.
+ *
+ * @param[in] plate The mapped plate.
+ * @param[in] path Its file.
+ *
+ * @return Bytes read per second, or 0 if the file could not be read.
+ */
+double read_storage(const Plate_t * plate, const char * path) {
+    const size_t chunk = 1 << 20;
+    double start, seconds;
+    size_t done = 0;
+    ssize_t got = 1;
+    char * buffer;
+    int fd;
+
+    if (msync(plate->grid[0] - PLATE_LEAD, plate->mapped, MS_SYNC) != 0)
+        return 0;
+    release_rows(plate, plate->grid[0], 0, 2 * plate->rows);
+    fd = open(path, O_RDONLY);
+    buffer = malloc(chunk);
+    if (fd < 0 || buffer == NULL) {
+        if (fd >= 0)
+            close(fd);
+        free(buffer);
+        return 0;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    start = wall_seconds();
+    while (done < plate->mapped && got > 0) {
+        got = pread(fd, buffer, chunk, (off_t) done);
+        if (got > 0)
+            done += got;
+    }
+    seconds = wall_seconds() - start;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    free(buffer);
+
+    return done == plate->mapped && seconds > 0 ? done / seconds : 0;
+}
+
+/**
+ * @brief One time step of a single-precision plate.
+ * @details Split between the threads like stencil_step. The rows' sums
+ * are added up in double; within a row the kernel sums as measure says.
+ *
+ * @param[in,out] plate The plate, advanced to the next time step.
+ * @param[in] measure MEASURE_NONE, MEASURE_SINGLE or MEASURE_DOUBLE.
+ *
+ * @return The total absolute change, or 0 for MEASURE_NONE.
+ */
+double stencil_step_float(Plate_float_t * plate, int measure) {
+    const size_t pitch = plate->pitch;
+    const int rows = plate->rows, cols = plate->cols;
+    const float * old = plate->grid[plate->current];
+    float * new = plate->grid[1 - plate->current];
+    double delta_temp = 0;
+    int i;
+    TRACE_START(start);
+
+    #pragma omp parallel for schedule(static) reduction(+:delta_temp)
+    for (i = 1; i < rows - 1; i++) {
+        const double row = row_kernel_float(
+            old + (i - 1) * pitch, old + i * pitch, old + (i + 1) * pitch,
+            new + i * pitch, cols - 2, measure
+        );
+
+        if (deterministic)
+            plate->partial[i] = row;
+        else
+            delta_temp += row;
+    }
+    if (deterministic && measure != MEASURE_NONE)
+        delta_temp = sum_partials(plate->partial + 1, rows - 2);
+    plate->current = 1 - plate->current;
+    TRACE_STOP(PHASE_STENCIL, start);
+
+    return delta_temp;
+}
+
+/**
+ * @brief Measures the last time step of a single-precision plate.
+ * @details Like measure_change; the statistics are kept in double.
+ *
+ * @param[in] plate The plate, right after a time step.
+ * @param[out] change The sum, sum of squares and largest absolute change.
+ */
+void measure_change_float(const Plate_float_t * plate, Change_t * change) {
+    const size_t pitch = plate->pitch;
+    const float * new = plate->grid[plate->current];
+    const float * old = plate->grid[1 - plate->current];
+    double sum = 0, sum_sq = 0, max = 0;
+    int i;
+    TRACE_START(start);
+
+    #pragma omp parallel for schedule(static) \
+        reduction(+:sum, sum_sq) reduction(max:max)
+    for (i = 1; i < plate->rows - 1; i++) {
+        const float * a = new + i * pitch, * b = old + i * pitch;
+        double d;
+        int j;
+
+        /*  Each row apart for --deterministic, see measure_change. */
+        if (deterministic)
+            sum = sum_sq = 0;
+        for (j = 1; j < plate->cols - 1; j++) {
+            d = fabsf(a[j] - b[j]);
+            sum += d;
+            sum_sq += d * d;
+            if (d > max)
+                max = d;
+        }
+        if (deterministic) {
+            plate->partial[i] = sum;
+            plate->partial[plate->rows + i] = sum_sq;
+        }
+    }
+    if (deterministic) {
+        sum = sum_partials(plate->partial + 1, plate->rows - 2);
+        sum_sq = sum_partials(
+            plate->partial + plate->rows + 1, plate->rows - 2
+        );
+    }
+    change->sum = sum;
+    change->sum_sq = sum_sq;
+    change->max = max;
+    TRACE_STOP(PHASE_REDUCTION, start);
+
+    return;
+}
+
+/**
+ * @brief Runs every plate of --ensemble to convergence and reports them.
+ * @details Each member has its own convergence monitor. Once its test
+ * passes the member is frozen: its lanes are still computed but keep
+ * their value and no longer count, and the batch ends when the last
+ * member has converged. Every member ends with the cells, and after the
+ * step, a separate run with the scalar kernel on one thread would.
+ *
+ * @param[in] config The settings; config->ensemble names the file.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or the
+ * ensemble does not fit in memory.
+ */
+int run_ensemble(const Config_t * config) {
+    Ensemble_t ensemble;
+    Boundary_t * boundary;
+    Plate_t plate;
+    Change_t change = { 0, -1, -1 };
+    double started, seconds, updates = 0;
+    int members, remaining, time = 0, check, i, m;
+
+    if (read_ensemble(config->ensemble, &boundary, &members)
+        != EXIT_SUCCESS) {
+        fprintf(stderr, "Could not read the ensemble file '%s'.\n",
+            config->ensemble);
+        return EXIT_FAILURE;
+    }
+    if (create_ensemble(&ensemble, config, boundary, members)
+        != EXIT_SUCCESS) {
+        fputs("Could not allocate the ensemble.\n", stderr);
+        free(boundary);
+        return EXIT_FAILURE;
+    }
+    free(boundary);
+
+    started = wall_seconds();
+    remaining = members;
+    while (remaining > 0) {
+        time++;
+        check = time % config->check_interval == 0;
+        ensemble_step(&ensemble, check);
+        if (!check)
+            continue;
+        for (m = 0; m < members; m++) {
+            if (ensemble.converged[m])
+                continue;
+            /*  Rows in order, like the reduction of a one-thread run. */
+            change.sum = 0;
+            for (i = 1; i < ensemble.rows - 1; i++) {
+                change.sum += ensemble.change[
+                    (size_t) i * ensemble.width + m
+                ];
+            }
+            if (monitor_converged(&ensemble.monitor[m], time, &change)) {
+                ensemble.converged[m] = time;
+                ensemble.mask[m] = 0;
+                remaining--;
+            }
+        }
+    }
+    seconds = wall_seconds() - started;
+
+    if (create_plate(&plate, ensemble.rows, ensemble.cols, 1)
+        != EXIT_SUCCESS) {
+        fputs("Could not allocate the plate.\n", stderr);
+        destroy_ensemble(&ensemble);
+        return EXIT_FAILURE;
+    }
+    for (m = 0; m < members; m++) {
+        const Boundary_t * b = &ensemble.boundary[m];
+
+        printf(
+            "Member %d: top %g, bottom %g, left %g, right %g, inner %g; "
+            "converged after %d steps\n", m, b->top, b->bottom, b->left,
+            b->right, b->inner, ensemble.converged[m]
+        );
+        member_plate(&ensemble, m, &plate);
+        print_plate(&plate, ensemble.converged[m]);
+        updates += (double) ensemble.converged[m] *
+            (ensemble.rows - 2) * (ensemble.cols - 2);
+    }
+    printf(
+        "Ensemble: %d plates in %d steps, %.3f s, %.3e cell updates/s\n",
+        members, time, seconds, seconds > 0 ? updates / seconds : 0.0
+    );
+
+    destroy_plate(&plate);
+    destroy_ensemble(&ensemble);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reads the members of an ensemble, one per line.
+ * @details Every line holds five temperatures as parse_boundary reads
+ * them. Blank lines and lines starting with '#' are skipped.
+ *
+ * @param[in] path The file to read.
+ * @param[out] boundary A new array of the members' temperatures; free it
+ * with free.
+ * @param[out] members The number of members.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read, has a
+ * malformed line or holds no member.
+ */
+int read_ensemble(const char * path, Boundary_t ** boundary, int * members) {
+    Boundary_t * list = NULL, * grown;
+    char line[256], * text;
+    int count = 0, capacity = 0;
+    FILE * file;
+
+    file = fopen(path, "r");
+    if (file == NULL)
+        return EXIT_FAILURE;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        for (text = line; *text == ' ' || *text == '\t'; text++)
+            ;
+        if (*text == '#' || *text == '\n' || *text == '\r' ||
+            *text == '\0')
+            continue;
+        if (count == capacity) {
+            capacity = capacity > 0 ? 2 * capacity : ENSEMBLE_LANES;
+            grown = realloc(list, sizeof(Boundary_t) * capacity);
+            if (grown == NULL)
+                break;
+            list = grown;
+        }
+        if (parse_boundary(text, &list[count]) != EXIT_SUCCESS)
+            break;
+        count++;
+    }
+    if (!feof(file) || count == 0) {
+        fclose(file);
+        free(list);
+        return EXIT_FAILURE;
+    }
+    fclose(file);
+    *boundary = list;
+    *members = count;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Allocates an ensemble and starts every member like init_plate.
+ *
+ * @param[out] ensemble The ensemble to create.
+ * @param[in] config The plate size and the convergence settings.
+ * @param[in] boundary The temperatures of every member.
+ * @param[in] members The number of members.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if an allocation failed. Nothing
+ * needs to be destroyed after a failure.
+ */
+int create_ensemble(
+    Ensemble_t * ensemble, const Config_t * config,
+    const Boundary_t * boundary, int members
+) {
+    Plate_t plate;
+    size_t bytes;
+    int i, m, ok;
+
+    memset(ensemble, 0, sizeof(*ensemble));
+    ensemble->rows = config->rows;
+    ensemble->cols = config->cols;
+    ensemble->members = members;
+    ensemble->width =
+        (members + ENSEMBLE_LANES - 1) / ENSEMBLE_LANES * ENSEMBLE_LANES;
+    bytes = sizeof(double) * ensemble->width *
+        (size_t) config->rows * config->cols;
+    ok = posix_memalign(
+            (void **) &ensemble->grid[0], PLATE_ALIGN, bytes
+        ) == 0;
+    if (!ok)
+        ensemble->grid[0] = NULL;
+    ok = ok && posix_memalign(
+            (void **) &ensemble->grid[1], PLATE_ALIGN, bytes
+        ) == 0;
+    if (!ok)
+        ensemble->grid[1] = NULL;
+    ensemble->mask = malloc(sizeof(double) * ensemble->width);
+    ensemble->change =
+        calloc((size_t) config->rows * ensemble->width, sizeof(double));
+    ensemble->boundary = malloc(sizeof(Boundary_t) * members);
+    ensemble->monitor = calloc(members, sizeof(Monitor_t));
+    ensemble->converged = calloc(members, sizeof(int));
+    ok = ok && ensemble->mask != NULL && ensemble->change != NULL &&
+        ensemble->boundary != NULL && ensemble->monitor != NULL &&
+        ensemble->converged != NULL;
+    for (m = 0; ok && m < members; m++) {
+        ok = create_monitor(&ensemble->monitor[m], config) == EXIT_SUCCESS;
+    }
+    ok = ok && create_plate(&plate, config->rows, config->cols, 1)
+        == EXIT_SUCCESS;
+    if (!ok) {
+        destroy_ensemble(ensemble);
+        return EXIT_FAILURE;
+    }
+
+    memcpy(ensemble->boundary, boundary, sizeof(Boundary_t) * members);
+    /*  Spare lanes copy the first member and stay frozen. */
+    for (m = 0; m < ensemble->width; m++) {
+        const int member = m < members ? m : 0;
+        const double * data = plate_data(&plate);
+        int g, j;
+
+        init_plate(&plate, &boundary[member]);
+        memset(&ensemble->mask[m], m < members ? 0xff : 0, sizeof(double));
+        for (g = 0; g < 2; g++) {
+            for (i = 0; i < config->rows; i++) {
+                for (j = 0; j < config->cols; j++) {
+                    ensemble->grid[g][
+                        ((size_t) i * config->cols + j) * ensemble->width + m
+                    ] = data[(size_t) i * plate.pitch + j];
+                }
+            }
+        }
+    }
+    destroy_plate(&plate);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Releases what create_ensemble allocated.
+ *
+ * @param[in,out] ensemble The ensemble to release.
+ */
+void destroy_ensemble(Ensemble_t * ensemble) {
+    int m;
+
+    for (m = 0; ensemble->monitor != NULL && m < ensemble->members; m++) {
+        destroy_monitor(&ensemble->monitor[m]);
+    }
+    free(ensemble->grid[0]);
+    free(ensemble->grid[1]);
+    free(ensemble->mask);
+    free(ensemble->change);
+    free(ensemble->boundary);
+    free(ensemble->monitor);
+    free(ensemble->converged);
+    memset(ensemble, 0, sizeof(*ensemble));
+
+    return;
+}
+
+/**
+ * @brief Copies the latest state of one member into a plate.
+ *
+ * @param[in] ensemble The ensemble.
+ * @param[in] member The member to copy.
+ * @param[out] plate A plate of the ensemble's size; its current grid is
+ * written.
+ */
+void member_plate(const Ensemble_t * ensemble, int member, Plate_t * plate) {
+    const double * data = ensemble->grid[ensemble->current];
+    double * out = plate_data(plate);
+    int i, j;
+
+    for (i = 0; i < ensemble->rows; i++) {
+        for (j = 0; j < ensemble->cols; j++) {
+            out[(size_t) i * plate->pitch + j] = data[
+                ((size_t) i * ensemble->cols + j) * ensemble->width + member
+            ];
+        }
+    }
+
+    return;
+}
+
+/**
+ * @brief One time step of every member of an ensemble.
+ * @details Split between the threads by rows like stencil_step. Each row
+ * leaves its per-lane change in its own slice of ensemble->change, so no
+ * reduction is needed and the sums do not depend on the thread count.
+ *
+ * @param[in,out] ensemble The ensemble, advanced to the next time step.
+ * @param[in] measure Non-zero to measure the change of every lane.
+ */
+void ensemble_step(Ensemble_t * ensemble, int measure) {
+    const size_t pitch = (size_t) ensemble->cols * ensemble->width;
+    const double * old = ensemble->grid[ensemble->current];
+    double * new = ensemble->grid[1 - ensemble->current];
+    int i;
+    TRACE_START(start);
+
+    #pragma omp parallel for schedule(static)
+    for (i = 1; i < ensemble->rows - 1; i++) {
+        ensemble_kernel(
+            old + (i - 1) * pitch, old + i * pitch, old + (i + 1) * pitch,
+            new + i * pitch, ensemble->cols - 2, ensemble->width,
+            ensemble->mask,
+            measure ? ensemble->change + (size_t) i * ensemble->width : NULL
+        );
+    }
+    ensemble->current = 1 - ensemble->current;
+    TRACE_STOP(PHASE_STENCIL, start);
+
+    return;
+}
+
+/**
+ * @brief Runs a --layers volume to convergence.
+ * @details The volume is reported like a plate at the user's time step:
+ * every layer with its heat levels, and one histogram of the whole
+ * volume, computed by the plate analytics on the stacked layers.
+ *
+ * @param[in] config The settings; config->layers is the depth.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the volume does not fit in
+ * memory.
+ */
+int run_volume(const Config_t * config) {
+    const int sum_only = config->norm == NORM_L1 ||
+        config->norm == NORM_L1_MEAN;
+    Volume_t volume;
+    Monitor_t monitor;
+    Change_t change;
+    int * norm;
+    long * histogram;
+    int time = 0, time_print, check, converged = 0;
+    double started, seconds;
+
+    if (create_volume(&volume, config->layers, config->rows, config->cols)
+        != EXIT_SUCCESS) {
+        fputs("Could not allocate the volume.\n", stderr);
+        return EXIT_FAILURE;
+    }
+    norm = malloc(sizeof(int) * volume.plate.rows * volume.plate.cols);
+    histogram = malloc(sizeof(long) * config->bins);
+    if (norm == NULL || histogram == NULL ||
+        create_monitor(&monitor, config) != EXIT_SUCCESS) {
+        fputs("Could not allocate the normalized volume.\n", stderr);
+        free(norm);
+        free(histogram);
+        destroy_volume(&volume);
+        return EXIT_FAILURE;
+    }
+    monitor.cells *= config->layers - 2;
+    init_volume(&volume, &config->boundary);
+
+    time_print = get_user_timestep();
+    started = wall_seconds();
+    do {
+        time++;
+        check = time % monitor.interval == 0;
+        change.sum = volume_step(
+            &volume, check && sum_only, config->tile_rows, config->tile_cols
+        );
+        change.sum_sq = change.max = -1;
+        /*  The layer edges never change, so the stacked plate's change
+            is the volume's. */
+        if (check && !sum_only)
+            measure_change(&volume.plate, &change);
+        if (check)
+            converged = monitor_converged(&monitor, time, &change);
+        if (time == time_print) {
+            analyze_plate(&volume.plate, config->bins, histogram, norm);
+            print_volume(&volume, time, norm);
+            print_histogram(histogram, config->bins);
+        }
+    } while (!converged);
+    seconds = wall_seconds() - started;
+
+    puts("Final State.");
+    print_volume(&volume, time, NULL);
+    if (config->history)
+        print_history(&monitor);
+    printf(
+        "Volume: %d x %d x %d, %d steps in %.3f s, %.3e cell updates/s\n",
+        volume.layers, volume.rows, volume.plate.cols, time, seconds,
+        (double) time * (volume.layers - 2) * (volume.rows - 2) *
+            (volume.plate.cols - 2) / seconds
+    );
+
+    destroy_monitor(&monitor);
+    free(histogram);
+    free(norm);
+    destroy_volume(&volume);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Allocates a layers x rows x cols volume.
+ *
+ * @param[out] volume The volume to set up.
+ * @param[in] layers Number of layers, faces included.
+ * @param[in] rows Number of rows, edges included.
+ * @param[in] cols Number of columns, edges included.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the allocation failed.
+ */
+int create_volume(Volume_t * volume, int layers, int rows, int cols) {
+    volume->layers = layers;
+    volume->rows = rows;
+    if (create_plate(&volume->plate, layers * rows, cols, 2)
+        != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    volume->plane = (size_t) volume->plate.pitch * rows;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Releases a volume created with create_volume.
+ *
+ * @param[in,out] volume The volume to release.
+ */
+void destroy_volume(Volume_t * volume) {
+    destroy_plate(&volume->plate);
+
+    return;
+}
+
+/**
+ * @brief Initializes the faces and the interior of a volume.
+ * @details A cell on one face gets that face's temperature, a cell on an
+ * edge or corner of the block the average of the two or three faces it
+ * lies on, as the corners of a plate do. The rows are written by the
+ * threads that step them, see create_plate.
+ *
+ * @param[out] volume The volume, both grids.
+ * @param[in] boundary The face and inner temperatures.
+ */
+void init_volume(Volume_t * volume, const Boundary_t * boundary) {
+    Plate_t * plate = &volume->plate;
+    int r;
+
+    #pragma omp parallel for schedule(static) \
+        if (placement == PLACEMENT_FIRST_TOUCH)
+    for (r = 0; r < plate->rows; r++) {
+        const int k = r / volume->rows, i = r % volume->rows;
+        double faces = 0, sum = 0, temp;
+        int g, j;
+
+        if (k == 0) {
+            sum += boundary->front;
+            faces++;
+        }
+        if (k == volume->layers - 1) {
+            sum += boundary->back;
+            faces++;
+        }
+        if (i == 0) {
+            sum += boundary->top;
+            faces++;
+        }
+        if (i == volume->rows - 1) {
+            sum += boundary->bottom;
+            faces++;
+        }
+        for (g = 0; g < 2; g++) {
+            double * row = plate->grid[g] + (size_t) r * plate->pitch;
+
+            for (j = 0; j < plate->cols; j++) {
+                if (j == 0)
+                    temp = (sum + boundary->left) / (faces + 1);
+                else if (j == plate->cols - 1)
+                    temp = (sum + boundary->right) / (faces + 1);
+                else
+                    temp = faces > 0 ? sum / faces : boundary->inner;
+                row[j] = temp;
+            }
+        }
+    }
+
+    return;
+}
+
+/**
+ * @brief One time step of a volume.
+ * @details The interior layers are split into one slab per thread, about
+ * the rows create_plate had each thread place. Each thread walks the
+ * rows x cols tiles of the layers and, within a tile, sweeps through its
+ * slab, so the three layers of the tile the 27-point stencil reads stay
+ * in cache while the tile moves along. The change is summed per layer,
+ * tile by tile, so the total does not depend on the number of threads.
+ *
+ * @param[in,out] volume The volume, advanced to the next time step.
+ * @param[in] measure Non-zero to sum the absolute changes.
+ * @param[in] tile_rows Rows of a tile.
+ * @param[in] tile_cols Columns of a tile.
+ *
+ * @return The total absolute change, or 0 if measure is zero.
+ */
+double volume_step(
+    Volume_t * volume, int measure, int tile_rows, int tile_cols
+) {
+    Plate_t * plate = &volume->plate;
+    const size_t pitch = plate->pitch, plane = volume->plane;
+    const int layers = volume->layers, rows = volume->rows;
+    const int cols = plate->cols;
+    const int tiles_down = (rows - 2 + tile_rows - 1) / tile_rows;
+    const int tiles_across = (cols - 2 + tile_cols - 1) / tile_cols;
+    const double * old = plate_data(plate);
+    double * new = plate_back(plate);
+    double * layer_sum = plate->partial;
+    double delta_temp = 0;
+    TRACE_START(start);
+
+    #pragma omp parallel
+    {
+        int threads = 1, id = 0, first, last, t, k, i;
+
+#ifdef _OPENMP
+        threads = omp_get_num_threads();
+        id = omp_get_thread_num();
+#endif
+        first = 1 + (int) ((long) (layers - 2) * id / threads);
+        last = 1 + (int) ((long) (layers - 2) * (id + 1) / threads);
+        for (k = first; k < last; k++) {
+            layer_sum[k] = 0;
+        }
+        for (t = 0; t < tiles_down * tiles_across; t++) {
+            const int top = 1 + t / tiles_across * tile_rows;
+            const int left = 1 + t % tiles_across * tile_cols;
+            const int bottom = top + tile_rows < rows - 1 ?
+                top + tile_rows : rows - 1;
+            const int n = left + tile_cols < cols - 1 ?
+                tile_cols : cols - 1 - left;
+
+            for (k = first; k < last; k++) {
+                for (i = top; i < bottom; i++) {
+                    const size_t at = k * plane + i * pitch;
+
+                    layer_sum[k] += volume_row(
+                        old + at, plane, pitch, new + at, left, n, measure
+                    );
+                }
+            }
+        }
+    }
+    if (measure)
+        delta_temp = sum_partials(layer_sum + 1, layers - 2);
+    swap_plate(plate);
+    TRACE_STOP(PHASE_STENCIL, start);
+
+    return delta_temp;
+}
+
+/**
+ * @brief Row kernel of the 27-point stencil.
+ * @details The 3D form of the 9-point stencil of calc_temp: every cell of
+ * the 3 x 3 x 3 block around a cell counts once and the cell itself
+ * twice, divided by the total weight, 28 (the plate's is 10). The terms
+ * are added in a fixed order, plane by plane and row by row.
+ *
+ * @param[in] mid The row being updated at the previous time step, at its
+ * column 0.
+ * @param[in] plane Cells from one layer to the next.
+ * @param[in] pitch Cells from one row to the next.
+ * @param[out] out The same row in the grid being written, at column 0.
+ * @param[in] first The first column to update.
+ * @param[in] n The number of columns to update.
+ * @param[in] measure Non-zero to sum the absolute changes.
+ *
+ * @return The sum of the absolute changes, or 0 if measure is zero.
+ */
+double volume_row(
+    const double * mid, size_t plane, size_t pitch, double * out,
+    int first, int n, int measure
+) {
+    const double * row[9];
+    double delta_temp = 0, sum;
+    int p, j;
+
+    for (p = 0; p < 9; p++) {
+        row[p] = mid + (p / 3 - 1) * (long) plane + (p % 3 - 1) * (long) pitch;
+    }
+    for (j = first; j < first + n; j++) {
+        sum = mid[j];
+        for (p = 0; p < 9; p++) {
+            sum += row[p][j-1] + row[p][j] + row[p][j+1];
+        }
+        out[j] = sum / 28;
+
+        if (measure)
+            delta_temp += fabs(out[j] - mid[j]);
+    }
+
+    return delta_temp;
+}
+
+/**
+ * @brief Prints the temperatures of a volume layer by layer, each
+ * followed by its heat levels if they are given.
+ *
+ * @param[in] volume The volume.
+ * @param[in] time The simulation time of the volume.
+ * @param[in] norm The heat levels of the stacked layers from
+ * analyze_plate, or NULL.
+ */
+void print_volume(const Volume_t * volume, int time, const int * norm) {
+    const Plate_t * plate = &volume->plate;
+    const double * data = plate_data(plate);
+    const size_t cells = (size_t) volume->rows * plate->cols;
+    int k, i, j;
+
+    printf("\n || Time in seconds: %d ||\n", time);
+    for (k = 0; k < volume->layers; k++) {
+        printf("\n Layer %d\n\n", k);
+        for (i = 0; i < volume->rows; i++) {
+            const double * row = data + k * volume->plane +
+                (size_t) i * plate->pitch;
+
+            for (j = 0; j < plate->cols; j++) {
+                printf("%6.2f ", row[j]);
+            }
+            putchar('\n');
+        }
+        putchar('\n');
+        if (norm != NULL)
+            print_norm_plate(norm + k * cells, volume->rows, plate->cols);
+    }
+
+    return;
+}
+
+/**
+ * @brief Runs the plate to convergence on --ranks processes.
+ *
+ * @param[in] config The settings; config->ranks is the process count.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if a rank failed.
+ */
+int run_decomposed(const Config_t * config) {
+    double seconds;
+    int time_print, down, across;
+
+    if (split_ranks(config->ranks, config->rows, config->cols, &down, &across)
+        != EXIT_SUCCESS) {
+        fprintf(stderr, "Could not split the plate among %d ranks.\n",
+            config->ranks);
+        return EXIT_FAILURE;
+    }
+    time_print = get_user_timestep();
+
+    return run_domain(
+        config, config->ranks, config->rows, config->cols, 0, time_print,
+        &seconds
+    );
+}
+
+/**
+ * @brief Prints strong and weak scaling of the decomposed solver.
+ * @details Every run takes SCALING_STEPS unmeasured steps on 1, 2, 4, ...
+ * and finally config->scaling ranks. Strong scaling keeps the plate of
+ * --rows and --cols; weak scaling gives every rank a block of that size,
+ * so the plate grows with the rank grid. Efficiency is the one-rank time
+ * over the time on N ranks, divided by N for strong scaling.
+ *
+ * @param[in] config The plate size and the largest rank count.
+ */
+void report_scaling(const Config_t * config) {
+    double seconds, first[2] = { 0, 0 };
+    int weak, ranks, down, across, rows, cols;
+
+    for (weak = 0; weak < 2; weak++) {
+        printf(
+            "%s scaling, %d x %d plate%s, %d steps:\n",
+            weak ? "Weak" : "Strong", config->rows, config->cols,
+            weak ? " per rank" : "", SCALING_STEPS
+        );
+        for (ranks = 1; ranks <= config->scaling;
+            ranks = ranks < config->scaling && 2 * ranks > config->scaling ?
+                config->scaling : 2 * ranks) {
+            rows = config->rows;
+            cols = config->cols;
+            if (split_ranks(ranks, rows, cols, &down, &across)
+                != EXIT_SUCCESS) {
+                printf("  %3d ranks: the plate is too small\n", ranks);
+                break;
+            }
+            if (weak) {
+                rows = (rows - 2) * down + 2;
+                cols = (cols - 2) * across + 2;
+            }
+            if (run_domain(
+                    config, ranks, rows, cols, SCALING_STEPS, 0, &seconds
+                ) != EXIT_SUCCESS) {
+                printf("  %3d ranks: failed\n", ranks);
+                break;
+            }
+            if (ranks == 1)
+                first[weak] = seconds;
+            printf(
+                "  %3d ranks (%d x %d), %d x %d plate: %.3f s, "
+                "%.3e cells/s, efficiency %.0f%%\n", ranks, down, across,
+                rows, cols, seconds,
+                (double) SCALING_STEPS * (rows - 2) * (cols - 2) / seconds,
+                100 * first[weak] / seconds / (weak ? 1 : ranks)
+            );
+        }
+    }
+
+    return;
+}
+
+/**
+ * @brief Runs the plate on ranks processes.
+ * @details Every rank is a child process, and the caller waits for them.
+ * When one fails or dies, the others are told through the domain and
+ * killed, since they would wait for its halos forever. stdout is flushed
+ * first so no buffered output is written twice.
+ *
+ * @param[in] config The settings.
+ * @param[in] ranks Number of processes.
+ * @param[in] rows Number of rows of the plate, edges included.
+ * @param[in] cols Number of columns, edges included.
+ * @param[in] steps Number of unmeasured steps to take, or 0 to run to
+ * convergence with the usual reports.
+ * @param[in] time_print The step to report if steps is 0.
+ * @param[out] seconds The time rank 0 took to step.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the plate cannot be split or a
+ * rank failed.
+ */
+int run_domain(
+    const Config_t * config, int ranks, int rows, int cols, int steps,
+    int time_print, double * seconds
+) {
+    Domain_t domain;
+    pid_t * child, done;
+    int status = EXIT_SUCCESS, running, result, r;
+
+    child = malloc(sizeof(pid_t) * ranks);
+    if (child == NULL || create_domain(
+            &domain, ranks, rows, cols, &config->boundary
+        ) != EXIT_SUCCESS) {
+        fprintf(stderr, "Could not split the plate among %d ranks.\n",
+            ranks);
+        free(child);
+        return EXIT_FAILURE;
+    }
+    fflush(stdout);
+    for (r = 0; r < ranks; r++) {
+        child[r] = fork();
+        if (child[r] == 0) {
+            result = run_rank(
+                &domain, config, r, steps, time_print, domain.seconds
+            );
+            /*  The phases are timed in the ranks' own processes; rank 0,
+                which reports the plate, reports its own. */
+            if (r == 0 && steps == 0)
+                result = finish_trace(config, result);
+            fflush(stdout);
+            _exit(result);
+        }
+        if (child[r] < 0)
+            break;
+    }
+    running = r;
+    if (r < ranks) {
+        fputs("Could not start the ranks.\n", stderr);
+        status = EXIT_FAILURE;
+    }
+    while (running > 0) {
+        if (status != EXIT_SUCCESS) {
+            fail_domain(&domain);
+            for (r = 0; r < ranks; r++) {
+                if (child[r] > 0)
+                    kill(child[r], SIGKILL);
+            }
+        }
+        done = waitpid(-1, &result, 0);
+        if (done < 0)
+            break;
+        for (r = 0; r < ranks && child[r] != done; r++)
+            ;
+        if (r == ranks)
+            continue;
+        child[r] = 0;
+        running--;
+        if (!WIFEXITED(result) || WEXITSTATUS(result) != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
+    }
+    if (status == EXIT_SUCCESS && seconds != NULL)
+        *seconds = *domain.seconds;
+    destroy_domain(&domain);
+    free(child);
+
+    return status;
+}
+
+/**
+ * @brief Chooses the rank grid with the least halo per rank.
+ *
+ * @param[in] ranks Number of ranks.
+ * @param[in] rows Number of rows of the plate, edges included.
+ * @param[in] cols Number of columns, edges included.
+ * @param[out] down Ranks along the rows.
+ * @param[out] across Ranks along the columns.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if every grid would leave a rank
+ * without cells.
+ */
+int split_ranks(int ranks, int rows, int cols, int * down, int * across) {
+    double best = -1, halo;
+    int p;
+
+    for (p = 1; p <= ranks; p++) {
+        if (ranks % p != 0 || p > rows - 2 || ranks / p > cols - 2)
+            continue;
+        halo = (double) (rows - 2) / p + (double) (cols - 2) / (ranks / p);
+        if (best < 0 || halo < best) {
+            best = halo;
+            *down = p;
+            *across = ranks / p;
+        }
+    }
+
+    return best < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Sets up the shared memory of a decomposed run.
+ * @details The whole plate is initialized here, and every rank copies its
+ * block and halo from it, so the edge cells are those of init_plate. It is
+ * initialized by this thread alone: the ranks are forked next, and the
+ * threads of an OpenMP team would not survive the fork.
+ *
+ * @param[out] domain The domain.
+ * @param[in] ranks Number of ranks.
+ * @param[in] rows Number of rows of the plate, edges included.
+ * @param[in] cols Number of columns, edges included.
+ * @param[in] boundary The edge and inner temperatures.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the plate cannot be split or
+ * the memory cannot be mapped.
+ */
+int create_domain(
+    Domain_t * domain, int ranks, int rows, int cols,
+    const Boundary_t * boundary
+) {
+    const int line = PLATE_ALIGN / sizeof(double);
+    const Placement_t saved = placement;
+    Plate_t * plate = &domain->plate;
+    size_t doubles, bytes;
+    void * map;
+    int r;
+
+    if (split_ranks(ranks, rows, cols, &domain->down, &domain->across)
+        != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    domain->ranks = ranks;
+    domain->rows = rows;
+    domain->cols = cols;
+    domain->stride = 2 * ((cols - 2 + domain->across - 1) / domain->across +
+        (rows - 2 + domain->down - 1) / domain->down);
+    doubles = 3 * ranks + 1 + 2 * ranks * domain->stride;
+    domain->shared_bytes = sizeof(double) * doubles +
+        sizeof(int) * (2 * ranks + 1);
+    domain->shared = mmap(
+        NULL, domain->shared_bytes, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0
+    );
+    if (domain->shared == MAP_FAILED)
+        return EXIT_FAILURE;
+    domain->sums = domain->shared;
+    domain->waited = domain->sums + 2 * ranks;
+    domain->seconds = domain->waited + ranks;
+    domain->edges = domain->seconds + 1;
+    domain->published = (int *) (domain->sums + doubles);
+    domain->gathered = domain->published + ranks;
+    domain->failed = domain->gathered + ranks;
+    *domain->failed = 0;
+    *domain->seconds = 0;
+    /*  Nothing is published before the ranks start. */
+    for (r = 0; r < ranks; r++) {
+        domain->published[r] = domain->gathered[r] = -1;
+    }
+
+    plate->rows = rows;
+    plate->cols = cols;
+    plate->pitch = (PLATE_LEAD + cols + line - 1) / line * line;
+    plate->grids = 1;
+    plate->grid[1] = NULL;
+    plate->current = 0;
+    plate->partial = malloc(sizeof(double) * 2 * rows);
+    bytes = sizeof(double) * plate->pitch * rows;
+    map = mmap(
+        NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0
+    );
+    if (plate->partial == NULL || map == MAP_FAILED) {
+        free(plate->partial);
+        munmap(domain->shared, domain->shared_bytes);
+        return EXIT_FAILURE;
+    }
+    plate->grid[0] = (double *) map + PLATE_LEAD;
+    plate->mapped = bytes;
+    placement = PLACEMENT_SERIAL;
+    init_plate(plate, boundary);
+    placement = saved;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Releases the shared memory of a domain.
+ *
+ * @param[in,out] domain The domain.
+ */
+void destroy_domain(Domain_t * domain) {
+    destroy_plate(&domain->plate);
+    munmap(domain->shared, domain->shared_bytes);
+
+    return;
+}
+
+/**
+ * @brief Finds the interior cells a rank owns.
+ *
+ * @param[in] domain The domain.
+ * @param[in] rank The rank.
+ * @param[out] top The first row of its block.
+ * @param[out] left The first column.
+ * @param[out] height The number of rows.
+ * @param[out] width The number of columns.
+ */
+void block_of(
+    const Domain_t * domain, int rank, int * top, int * left, int * height,
+    int * width
+) {
+    const int p = rank / domain->across, q = rank % domain->across;
+    const long inner_rows = domain->rows - 2, inner_cols = domain->cols - 2;
+
+    *top = 1 + (int) (inner_rows * p / domain->down);
+    *height = 1 + (int) (inner_rows * (p + 1) / domain->down) - *top;
+    *left = 1 + (int) (inner_cols * q / domain->across);
+    *width = 1 + (int) (inner_cols * (q + 1) / domain->across) - *left;
+
+    return;
+}
+
+/**
+ * @brief The work of one rank: steps its block until the plate converged
+ * or for a fixed number of steps.
+ * @details The block is a plate of its own with a one-cell halo, copied
+ * from the domain's plate. The rank is single-threaded, so it places its
+ * block itself. On a measured step every rank adds the published sums of
+ * all ranks in rank order, so all of them see the same global change and
+ * stop at the same step. Rank 0 prints the reports from the blocks the
+ * ranks gather into the domain's plate. A rank that fails tells the
+ * others through the domain, and they stop with it.
+ *
+ * @param[in,out] domain The domain.
+ * @param[in] config The settings.
+ * @param[in] rank This rank.
+ * @param[in] steps Number of unmeasured steps, or 0 to run to convergence.
+ * @param[in] time_print The step to report if steps is 0.
+ * @param[out] seconds The time taken to step, or NULL.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the block cannot be allocated
+ * or another rank failed.
+ */
+int run_rank(
+    Domain_t * domain, const Config_t * config, int rank, int steps,
+    int time_print, double * seconds
+) {
+    const Placement_t saved = placement;
+    Plate_t block;
+    Monitor_t monitor;
+    Change_t change = { 0, -1, -1 };
+    long * histogram = NULL;
+    int * norm_plate = NULL;
+    int top, left, height, width, time = 0, checks = 0, converged = 0;
+    int check, g, i, r, status = EXIT_SUCCESS;
+    double started, sum;
+
+    block_of(domain, rank, &top, &left, &height, &width);
+    placement = PLACEMENT_SERIAL;
+    r = create_plate(&block, height + 2, width + 2, 2);
+    placement = saved;
+    if (r != EXIT_SUCCESS) {
+        fail_domain(domain);
+        return EXIT_FAILURE;
+    }
+    if (steps == 0 && create_monitor(&monitor, config) != EXIT_SUCCESS) {
+        destroy_plate(&block);
+        fail_domain(domain);
+        return EXIT_FAILURE;
+    }
+    if (steps == 0 && rank == 0) {
+        histogram = malloc(sizeof(long) * config->bins);
+        norm_plate = malloc(sizeof(int) * domain->rows * domain->cols);
+        if (histogram == NULL || norm_plate == NULL) {
+            free(histogram);
+            free(norm_plate);
+            destroy_monitor(&monitor);
+            destroy_plate(&block);
+            fail_domain(domain);
+            return EXIT_FAILURE;
+        }
+    }
+    for (g = 0; g < 2; g++) {
+        for (i = 0; i < height + 2; i++) {
+            memcpy(
+                block.grid[g] + (size_t) i * block.pitch,
+                plate_data(&domain->plate) +
+                    (size_t) (top - 1 + i) * domain->plate.pitch + left - 1,
+                sizeof(double) * (width + 2)
+            );
+        }
+    }
+    publish_edges(domain, rank, &block, 0);
+    __atomic_store_n(&domain->published[rank], 0, __ATOMIC_RELEASE);
+
+    started = wall_seconds();
+    while (steps == 0 ? !converged : time < steps) {
+        check = steps == 0 && (time + 1) % monitor.interval == 0;
+        sum = step_block(domain, rank, &block, time, check);
+        if (__atomic_load_n(domain->failed, __ATOMIC_ACQUIRE)) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        time++;
+        publish_edges(domain, rank, &block, time);
+        if (check)
+            domain->sums[checks % 2 * domain->ranks + rank] = sum;
+        __atomic_store_n(&domain->published[rank], time, __ATOMIC_RELEASE);
+        if (check) {
+            change.sum = 0;
+            for (r = 0; r < domain->ranks && status == EXIT_SUCCESS; r++) {
+                status = wait_for(domain, &domain->published[r], time);
+                change.sum += domain->sums[checks % 2 * domain->ranks + r];
+            }
+            if (status != EXIT_SUCCESS)
+                break;
+            checks++;
+            converged = monitor_converged(&monitor, time, &change);
+        }
+        if (steps > 0 || (time != time_print && !converged))
+            continue;
+        gather_block(domain, rank, &block, time);
+        if (rank != 0)
+            continue;
+        for (r = 0; r < domain->ranks && status == EXIT_SUCCESS; r++) {
+            status = wait_for(domain, &domain->gathered[r], time);
+        }
+        if (status != EXIT_SUCCESS)
+            break;
+        if (time == time_print)
+            process_frame(
+                &domain->plate, time, FRAME_REPORT, NULL, config->bins,
+                histogram, norm_plate
+            );
+    }
+    if (steps > 0 && rank == 0)
+        for (r = 0; r < domain->ranks && status == EXIT_SUCCESS; r++) {
+            status = wait_for(domain, &domain->published[r], steps);
+        }
+    if (seconds != NULL && rank == 0)
+        *seconds = wall_seconds() - started;
+
+    if (steps == 0 && rank == 0 && status == EXIT_SUCCESS) {
+        double waited = 0;
+
+        for (r = 0; r < domain->ranks; r++) {
+            waited += domain->waited[r];
+        }
+        puts("Final State.");
+        print_plate(&domain->plate, time);
+        if (config->history)
+            print_history(&monitor);
+        printf(
+            "Ranks: %d as %d x %d, %d steps in %.3f s, %.1f%% of it "
+            "waiting for halos\n", domain->ranks, domain->down,
+            domain->across, time, wall_seconds() - started,
+            100 * waited / domain->ranks / (wall_seconds() - started)
+        );
+    }
+    free(histogram);
+    free(norm_plate);
+    if (steps == 0)
+        destroy_monitor(&monitor);
+    destroy_plate(&block);
+
+    return status;
+}
+
+/**
+ * @brief One time step of a rank's block, overlapping the halo exchange.
+ * @details The cells that do not touch the halo are computed first, while
+ * the neighbours may still be finishing the previous step. Then the
+ * halo of this step is received and the outer ring of the block is
+ * computed. Every cell is computed by the same row kernel as in
+ * stencil_step, so the plate is the one of a single process.
+ *
+ * @param[in,out] domain The domain; the time spent waiting is added to
+ * domain->waited.
+ * @param[in] rank This rank.
+ * @param[in,out] block The rank's block with its halo, advanced one step.
+ * @param[in] time The step the block is at.
+ * @param[in] measure Non-zero to sum the absolute changes.
+ *
+ * @return The total absolute change of the block, or 0 if measure is zero.
+ */
+double step_block(
+    Domain_t * domain, int rank, Plate_t * block, int time, int measure
+) {
+    const size_t pitch = block->pitch;
+    const int height = block->rows - 2, width = block->cols - 2;
+    const double * old = plate_data(block);
+    double * new = plate_back(block);
+    double delta_temp = 0, start;
+    int i;
+    TRACE_START(inner);
+
+    for (i = 2; i < height && width > 2; i++) {
+        delta_temp += row_kernel(
+            old + (i - 1) * pitch + 1, old + i * pitch + 1,
+            old + (i + 1) * pitch + 1, new + i * pitch + 1, width - 2,
+            measure
+        );
+    }
+    TRACE_STOP(PHASE_STENCIL, inner);
+    start = wall_seconds();
+    receive_halos(domain, rank, block, time);
+    domain->waited[rank] += wall_seconds() - start;
+
+    TRACE_START(outer);
+    for (i = 1; i <= height; i++) {
+        const double * up = old + (i - 1) * pitch;
+        const double * mid = old + i * pitch;
+        const double * down = old + (i + 1) * pitch;
+
+        if (i == 1 || i == height) {
+            delta_temp += row_kernel(
+                up, mid, down, new + i * pitch, width, measure
+            );
+            continue;
+        }
+        delta_temp += row_kernel(up, mid, down, new + i * pitch, 1, measure);
+        if (width > 1)
+            delta_temp += row_kernel(
+                up + width - 1, mid + width - 1, down + width - 1,
+                new + i * pitch + width - 1, 1, measure
+            );
+    }
+    swap_plate(block);
+    TRACE_STOP(PHASE_STENCIL, outer);
+
+    return delta_temp;
+}
+
+/**
+ * @brief Writes the outer cells of a rank's block to its edge slot.
+ *
+ * @param[in,out] domain The domain.
+ * @param[in] rank This rank.
+ * @param[in] block The rank's block.
+ * @param[in] time The step the block is at; selects the slot.
+ */
+void publish_edges(Domain_t * domain, int rank, const Plate_t * block,
+    int time) {
+    const int height = block->rows - 2, width = block->cols - 2;
+    const double * data = plate_data(block);
+    double * edge = domain->edges + (2 * (size_t) rank + time % 2) *
+        domain->stride;
+    int i;
+
+    memcpy(edge, data + block->pitch + 1, sizeof(double) * width);
+    memcpy(
+        edge + width, data + height * block->pitch + 1,
+        sizeof(double) * width
+    );
+    for (i = 0; i < height; i++) {
+        edge[2 * width + i] = data[(i + 1) * block->pitch + 1];
+        edge[2 * width + height + i] = data[(i + 1) * block->pitch + width];
+    }
+
+    return;
+}
+
+/**
+ * @brief Fills the halo of a rank's block from its neighbours' edges.
+ * @details Waits until each of the up to eight neighbours has published
+ * the step. Halo cells without a neighbour are plate edges and keep
+ * their temperature.
+ *
+ * @param[in] domain The domain.
+ * @param[in] rank This rank.
+ * @param[in,out] block The rank's block; the halo of its current grid is
+ * written.
+ * @param[in] time The step the block is at.
+ */
+void receive_halos(Domain_t * domain, int rank, Plate_t * block, int time) {
+    const int p = rank / domain->across, q = rank % domain->across;
+    const int height = block->rows - 2, width = block->cols - 2;
+    double * data = plate_data(block);
+    int dp, dq, i;
+
+    for (dp = -1; dp <= 1; dp++) {
+        for (dq = -1; dq <= 1; dq++) {
+            const int other = (p + dp) * domain->across + q + dq;
+            /*  The halo row or column this neighbour fills. */
+            const size_t row = dp < 0 ? 0 : (size_t) (height + 1);
+            const int col = dq < 0 ? 0 : width + 1;
+            const double * edge;
+            int top, left, h, w;
+
+            if ((dp == 0 && dq == 0) || p + dp < 0 || p + dp >= domain->down ||
+                q + dq < 0 || q + dq >= domain->across)
+                continue;
+            edge = domain->edges +
+                (2 * (size_t) other + time % 2) * domain->stride;
+            block_of(domain, other, &top, &left, &h, &w);
+            if (wait_for(domain, &domain->published[other], time)
+                != EXIT_SUCCESS)
+                return;
+            if (dq == 0) {
+                /*  Its bottom row above us, or its top row below. */
+                memcpy(
+                    data + row * block->pitch + 1, edge + (dp < 0 ? w : 0),
+                    sizeof(double) * width
+                );
+            } else if (dp == 0) {
+                /*  Its right column on our left, or its left column on
+                    our right. */
+                for (i = 0; i < height; i++) {
+                    data[(i + 1) * block->pitch + col] =
+                        edge[2 * w + (dq < 0 ? h : 0) + i];
+                }
+            } else {
+                /*  A corner of its bottom or top row. */
+                data[row * block->pitch + col] =
+                    edge[(dp < 0 ? w : 0) + (dq < 0 ? w - 1 : 0)];
+            }
+        }
+    }
+
+    return;
+}
+
+/**
+ * @brief Copies a rank's block into the domain's plate.
+ *
+ * @param[in,out] domain The domain.
+ * @param[in] rank This rank.
+ * @param[in] block The rank's block.
+ * @param[in] time The step the block is at.
+ */
+void gather_block(Domain_t * domain, int rank, const Plate_t * block,
+    int time) {
+    int top, left, height, width, i;
+
+    block_of(domain, rank, &top, &left, &height, &width);
+    for (i = 1; i <= height; i++) {
+        memcpy(
+            plate_data(&domain->plate) +
+                (size_t) (top - 1 + i) * domain->plate.pitch + left,
+            plate_data(block) + (size_t) i * block->pitch + 1,
+            sizeof(double) * width
+        );
+    }
+    __atomic_store_n(&domain->gathered[rank], time, __ATOMIC_RELEASE);
+
+    return;
+}
+
+/**
+ * @brief Waits until another rank's counter reaches a step.
+ * @details Ranks may share cores, so the wait yields instead of spinning.
+ *
+ * @param[in] domain The domain.
+ * @param[in] counter The counter, in shared memory.
+ * @param[in] time The step to wait for.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if a rank failed meanwhile.
+ */
+int wait_for(const Domain_t * domain, const int * counter, int time) {
+    while (__atomic_load_n(counter, __ATOMIC_ACQUIRE) < time) {
+        if (__atomic_load_n(domain->failed, __ATOMIC_ACQUIRE))
+            return EXIT_FAILURE;
+        sched_yield();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Tells the ranks of a domain that one of them failed.
+ *
+ * @param[in,out] domain The domain.
+ */
+void fail_domain(Domain_t * domain) {
+    __atomic_store_n(domain->failed, 1, __ATOMIC_RELEASE);
+
+    return;
+}
+
+/**
+ * @brief Runs the benchmark matrix of --bench.
+ * @details Every plate size is timed on 1, 2, 4, ... and --threads
+ * threads (default all), with calc_temp on every kernel the CPU supports
+ * and once with the analytics of a report. Each case reports the median
+ * and 95th percentile time, and its cells, bytes and floating point
+ * operations per second. The bandwidth is compared with a STREAM triad
+ * measured first (%BW), and the GFLOP/s with the roofline bound that
+ * bandwidth puts on the case's arithmetic intensity (roof GF). Plates
+ * that fit in the caches can beat both.
+ *
+ * @param[in] config The settings.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if a case could not run, the
+ * results could not be written or a case regressed.
+ */
+int run_bench(const Config_t * config) {
+    Bench_result_t * results = NULL, * grown, * result;
+    const char * text = config->bench_sizes;
+    double stream;
+    char * end;
+    int count = 0, capacity = 0, max_threads = 1, threads, size, k;
+    int status = EXIT_SUCCESS;
+
+#ifdef _OPENMP
+    max_threads = config->threads > 0 ? config->threads :
+        omp_get_max_threads();
+#endif
+    stream = measure_stream();
+    printf("STREAM triad: %.2f GB/s\n", 1e-9 * stream);
+    printf(
+        "%-10s %-7s %5s %5s %3s %10s %10s %10s %7s %7s %6s %7s\n", "case",
+        "kernel", "rows", "cols", "thr", "median ms", "p95 ms", "cells/s",
+        "GB/s", "GFLOP/s", "%BW", "roof GF"
+    );
+    while (*text != '\0' && status == EXIT_SUCCESS) {
+        size = (int) strtol(text, &end, 10);
+        if (end == text || size < 3) {
+            fprintf(stderr, "Bad --bench-sizes '%s'.\n", config->bench_sizes);
+            status = EXIT_FAILURE;
+            break;
+        }
+        text = *end == ',' ? end + 1 : end;
+        for (threads = 1; threads <= max_threads && status == EXIT_SUCCESS;
+            threads = threads < max_threads && 2 * threads > max_threads ?
+                max_threads : 2 * threads) {
+            Plate_t plate;
+            long * histogram = malloc(sizeof(long) * config->bins);
+            int * norm_plate = malloc(sizeof(int) * size * size);
+
+#ifdef _OPENMP
+            omp_set_num_threads(threads);
+#endif
+            if (histogram == NULL || norm_plate == NULL ||
+                create_plate(&plate, size, size, 2) != EXIT_SUCCESS) {
+                fputs("Could not allocate the plate.\n", stderr);
+                free(histogram);
+                free(norm_plate);
+                status = EXIT_FAILURE;
+                break;
+            }
+            init_plate(&plate, &config->boundary);
+            /*  One case per kernel, then the analytics. */
+            for (k = 0; k <= kernel_count; k++) {
+                if (k < kernel_count &&
+                    select_kernel(kernels[k].name) != EXIT_SUCCESS)
+                    continue;
+                if (count == capacity) {
+                    capacity = capacity == 0 ? 16 : 2 * capacity;
+                    grown = realloc(
+                        results, sizeof(Bench_result_t) * capacity
+                    );
+                    if (grown == NULL) {
+                        status = EXIT_FAILURE;
+                        break;
+                    }
+                    results = grown;
+                }
+                result = &results[count++];
+                result->name = k < kernel_count ? "calc_temp" : "analytics";
+                result->kernel = k < kernel_count ? kernels[k].name : "-";
+                result->rows = result->cols = size;
+                result->threads = threads;
+                time_case(
+                    result, &plate, config->bins, histogram,
+                    k < kernel_count ? NULL : norm_plate
+                );
+                printf(
+                    "%-10s %-7s %5d %5d %3d %10.4f %10.4f %10.3e %7.2f "
+                    "%7.2f %6.1f %7.2f\n", result->name, result->kernel,
+                    size, size, threads, 1e3 * result->median,
+                    1e3 * result->p95,
+                    (double) (size - 2) * (size - 2) / result->median,
+                    1e-9 * result->bytes / result->median,
+                    1e-9 * result->flops / result->median,
+                    stream > 0 ? 100 * result->bytes / result->median / stream
+                        : 0,
+                    stream > 0 ? 1e-9 * result->flops / result->bytes * stream
+                        : 0
+                );
+            }
+            destroy_plate(&plate);
+            free(histogram);
+            free(norm_plate);
+        }
+    }
+    select_kernel(config->kernel);
+#ifdef _OPENMP
+    omp_set_num_threads(max_threads);
+#endif
+
+    if (status == EXIT_SUCCESS &&
+        write_bench(config->bench, results, count, stream) != EXIT_SUCCESS) {
+        fprintf(stderr, "Could not write '%s'.\n", config->bench);
+        status = EXIT_FAILURE;
+    }
+    if (status == EXIT_SUCCESS && config->bench_baseline != NULL) {
+        k = compare_bench(
+            config->bench_baseline, results, count, config->bench_tolerance
+        );
+        if (k != 0)
+            status = EXIT_FAILURE;
+        if (k < 0)
+            fprintf(stderr, "Could not read the baseline '%s'.\n",
+                config->bench_baseline);
+    }
+    free(results);
+
+    return status;
+}
+
+/**
+ * @brief Measures the memory bandwidth with the STREAM triad.
+ * @details a = b + s * c on three arrays of STREAM_CELLS doubles, far
+ * larger than the caches, on all threads; the best of BENCH_REPEATS runs
+ * counts, as in STREAM. A cell moves 24 bytes.
+ *
+ * @return Bytes per second, or 0 if the arrays could not be allocated.
+ */
+double measure_stream(void) {
+    const double scalar = 3.0;
+    double * a = malloc(sizeof(double) * STREAM_CELLS);
+    double * b = malloc(sizeof(double) * STREAM_CELLS);
+    double * c = malloc(sizeof(double) * STREAM_CELLS);
+    double best = 0, start, seconds;
+    long i;
+    int run;
+
+    if (a == NULL || b == NULL || c == NULL) {
+        free(a);
+        free(b);
+        free(c);
+        return 0;
+    }
+    #pragma omp parallel for schedule(static)
+    for (i = 0; i < STREAM_CELLS; i++) {
+        a[i] = 0;
+        b[i] = 1;
+        c[i] = 2;
+    }
+    for (run = 0; run < BENCH_REPEATS; run++) {
+        start = wall_seconds();
+        #pragma omp parallel for schedule(static)
+        for (i = 0; i < STREAM_CELLS; i++) {
+            a[i] = b[i] + scalar * c[i];
+        }
+        seconds = wall_seconds() - start;
+        if (best == 0 || seconds < best)
+            best = seconds;
+    }
+    free(a);
+    free(b);
+    free(c);
+
+    return 3.0 * sizeof(double) * STREAM_CELLS / best;
+}
+
+/**
+ * @brief Times one benchmark case.
+ * @details Every run is a batch of calls and the time per call is kept.
+ * The batch starts at about a million cells and doubles until a run takes
+ * BENCH_MIN_SECONDS, so small plates are not timed at the clock's
+ * resolution; those calibration runs and BENCH_WARMUP more are not
+ * timed. A calc_temp call reads one grid and writes the other, 16 bytes
+ * and 12 operations per cell (the 9-point sum, two multiplies and the
+ * measured change). The analytics read the plate twice and write the
+ * heat levels, 20 bytes and about 4 operations per cell.
+ *
+ * @param[in,out] result The case; its timing and counts are filled in.
+ * @param[in,out] plate The plate to work on.
+ * @param[in] bins The number of heat levels.
+ * @param[out] histogram Room for bins counters.
+ * @param[out] norm_plate Room for the heat levels to time the analytics,
+ * or NULL to time calc_temp.
+ */
+void time_case(
+    Bench_result_t * result, Plate_t * plate, int bins, long * histogram,
+    int * norm_plate
+) {
+    const double cells = (double) (plate->rows - 2) * (plate->cols - 2);
+    int batch = cells < (1 << 20) ? (int) ((1 << 20) / cells) : 1;
+    double sample[BENCH_REPEATS], start, seconds;
+    int run, i;
+
+    do {
+        start = wall_seconds();
+        for (i = 0; i < batch; i++) {
+            if (norm_plate != NULL)
+                analyze_plate(plate, bins, histogram, norm_plate);
+            else
+                calc_temp(plate);
+        }
+        seconds = wall_seconds() - start;
+        if (seconds < BENCH_MIN_SECONDS)
+            batch *= 2;
+    } while (seconds < BENCH_MIN_SECONDS && batch < (1 << 24));
+    for (run = -BENCH_WARMUP; run < BENCH_REPEATS; run++) {
+        start = wall_seconds();
+        for (i = 0; i < batch; i++) {
+            if (norm_plate != NULL)
+                analyze_plate(plate, bins, histogram, norm_plate);
+            else
+                calc_temp(plate);
+        }
+        if (run >= 0)
+            sample[run] = (wall_seconds() - start) / batch;
+    }
+    qsort(sample, BENCH_REPEATS, sizeof(double), compare_doubles);
+    result->median = sample[BENCH_REPEATS / 2];
+    result->p95 = sample[(95 * BENCH_REPEATS + 99) / 100 - 1];
+    result->bytes = (norm_plate != NULL ? 20 : 16) * cells;
+    result->flops = (norm_plate != NULL ? 4 : 12) * cells;
+
+    return;
+}
+
+/**
+ * @brief qsort order of doubles, smallest first.
+ *
+ * @param[in] a The first double.
+ * @param[in] b The second double.
+ *
+ * @return Negative, zero or positive as a is below, equal to or above b.
+ */
+int compare_doubles(const void * a, const void * b) {
+    const double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Reads the CPU model name from /proc/cpuinfo.
+ *
+ * @param[out] model Receives the name, or "unknown".
+ * @param[in] size The room in model.
+ */
+void cpu_model(char * model, size_t size) {
+    FILE * file = fopen("/proc/cpuinfo", "r");
+    char line[256], * value;
+
+    snprintf(model, size, "unknown");
+    if (file == NULL)
+        return;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, "model name", 10) != 0 ||
+            (value = strchr(line, ':')) == NULL)
+            continue;
+        value += strspn(value + 1, " \t") + 1;
+        value[strcspn(value, "\n")] = '\0';
+        snprintf(model, size, "%s", value);
+        break;
+    }
+    fclose(file);
+
+    return;
+}
+
+/**
+ * @brief Writes the benchmark results as JSON.
+ * @details Every case is one object on a line of its own, which is what
+ * compare_bench reads back.
+ *
+ * @param[in] path The file to write.
+ * @param[in] results The cases.
+ * @param[in] count The number of cases.
+ * @param[in] stream The STREAM triad bandwidth, in bytes per second.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the file could not be written.
+ */
+int write_bench(
+    const char * path, const Bench_result_t * results, int count,
+    double stream
+) {
+    FILE * file = fopen(path, "w");
+    char model[128];
+    int i;
+
+    if (file == NULL)
+        return EXIT_FAILURE;
+    cpu_model(model, sizeof(model));
+    fprintf(
+        file, "{\n  \"cpu\": \"%s\",\n  \"stream_gb_per_s\": %.3f,\n"
+        "  \"warmup\": %d,\n  \"repeats\": %d,\n  \"results\": [\n",
+        model, 1e-9 * stream, BENCH_WARMUP, BENCH_REPEATS
+    );
+    for (i = 0; i < count; i++) {
+        const Bench_result_t * r = &results[i];
+
+        fprintf(
+            file, "    {\"name\": \"%s\", \"kernel\": \"%s\", "
+            "\"rows\": %d, \"cols\": %d, \"threads\": %d, "
+            "\"median_s\": %.6e, \"p95_s\": %.6e, "
+            "\"cells_per_s\": %.6e, \"gb_per_s\": %.4f, "
+            "\"gflop_per_s\": %.4f, \"roof_gflop_per_s\": %.4f, "
+            "\"stream_fraction\": %.4f}%s\n",
+            r->name, r->kernel, r->rows, r->cols, r->threads, r->median,
+            r->p95, (double) (r->rows - 2) * (r->cols - 2) / r->median,
+            1e-9 * r->bytes / r->median, 1e-9 * r->flops / r->median,
+            stream > 0 ? 1e-9 * r->flops / r->bytes * stream : 0,
+            stream > 0 ? r->bytes / r->median / stream : 0,
+            i + 1 < count ? "," : ""
+        );
+    }
+    fputs("  ]\n}\n", file);
+
+    return fclose(file) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Compares the results with an earlier --bench file.
+ * @details Cases are matched by name, kernel, size and threads; cases
+ * only in one of the two are skipped. A case whose median time grew by
+ * more than tolerance is printed as a regression.
+ *
+ * @param[in] path The baseline written by write_bench.
+ * @param[in] results The cases just measured.
+ * @param[in] count The number of cases.
+ * @param[in] tolerance The relative slowdown allowed.
+ *
+ * @return The number of regressions, or -1 if the file cannot be read.
+ */
+int compare_bench(
+    const char * path, const Bench_result_t * results, int count,
+    double tolerance
+) {
+    FILE * file = fopen(path, "r");
+    char line[1024], name[32], kernel[32];
+    double median, change;
+    int regressions = 0, matched = 0, i;
+
+    if (file == NULL)
+        return -1;
+    printf("Against %s:\n", path);
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (json_string(line, "name", name, sizeof(name)) != EXIT_SUCCESS ||
+            json_string(line, "kernel", kernel, sizeof(kernel))
+                != EXIT_SUCCESS)
+            continue;
+        median = json_number(line, "median_s");
+        for (i = 0; i < count; i++) {
+            const Bench_result_t * r = &results[i];
+
+            if (strcmp(r->name, name) != 0 || strcmp(r->kernel, kernel) != 0 ||
+                r->rows != (int) json_number(line, "rows") ||
+                r->cols != (int) json_number(line, "cols") ||
+                r->threads != (int) json_number(line, "threads") ||
+                median <= 0)
+                continue;
+            change = r->median / median - 1;
+            matched++;
+            if (change > tolerance)
+                regressions++;
+            printf(
+                "  %-10s %-7s %5d %5d %3d %10.4f -> %10.4f ms %+7.1f%%%s\n",
+                r->name, r->kernel, r->rows, r->cols, r->threads,
+                1e3 * median, 1e3 * r->median, 100 * change,
+                change > tolerance ? "  REGRESSION" : ""
+            );
+        }
+    }
+    fclose(file);
+    printf(
+        "%d of %d cases compared, %d regressions beyond %.0f%%\n", matched,
+        count, regressions, 100 * tolerance
+    );
+
+    return regressions;
+}
+
+/**
+ * @brief Reads a number field from one line of a --bench file.
+ *
+ * @param[in] line The line.
+ * @param[in] key The field name, without quotes.
+ *
+ * @return The value, or 0 if the field is missing.
+ */
+double json_number(const char * line, const char * key) {
+    char quoted[64];
+    const char * at;
+
+    snprintf(quoted, sizeof(quoted), "\"%s\":", key);
+    at = strstr(line, quoted);
+
+    return at == NULL ? 0 : strtod(at + strlen(quoted), NULL);
+}
+
+/**
+ * @brief Reads a string field from one line of a --bench file.
+ *
+ * @param[in] line The line.
+ * @param[in] key The field name, without quotes.
+ * @param[out] out Receives the value.
+ * @param[in] size The room in out.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the field is missing or too
+ * long.
+ */
+int json_string(const char * line, const char * key, char * out, size_t size) {
+    char quoted[64];
+    const char * at, * stop;
+
+    snprintf(quoted, sizeof(quoted), "\"%s\": \"", key);
+    at = strstr(line, quoted);
+    if (at == NULL)
+        return EXIT_FAILURE;
+    at += strlen(quoted);
+    stop = strchr(at, '"');
+    if (stop == NULL || (size_t) (stop - at) >= size)
+        return EXIT_FAILURE;
+    memcpy(out, at, stop - at);
+    out[stop - at] = '\0';
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Chooses the calc_temp variant of --autotune.
+ * @details The choice for this CPU model, plate size and thread count is
+ * looked up in the cache file first (--tune-cache, default ~/TUNE_CACHE).
+ * If it is not there, short trials on a plate of the run's size pick it
+ * and it is added to the file, so only the first run of a size pays for
+ * them. The kernel, threads and tile of config are then set to it. Only
+ * choices that leave the cells of every step as they are are tuned: the
+ * tile only with the --block-steps the user gave, which stays as it is.
+ * Another kernel or thread count does sum the change of a step in
+ * another order, so without --deterministic that sum, and a convergence
+ * test right at the tolerance, may differ in the last bits.
+ *
+ * @param[in,out] config The settings to tune.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the trial plate could not be
+ * allocated.
+ */
+int autotune(Config_t * config) {
+    const char * home = getenv("HOME");
+    char model[128], path[4096];
+    int max_threads = 1, cached;
+    Tune_t tune;
+
+#ifdef _OPENMP
+    max_threads = config->threads > 0 ? config->threads :
+        omp_get_max_threads();
+#endif
+    cpu_model(model, sizeof(model));
+    if (config->tune_cache != NULL)
+        snprintf(path, sizeof(path), "%s", config->tune_cache);
+    else
+        snprintf(path, sizeof(path), "%s/%s", home != NULL ? home : ".",
+            TUNE_CACHE);
+
+    cached = load_tuning(
+        path, model, config->rows, config->cols, max_threads,
+        config->block_steps, &tune
+    ) == EXIT_SUCCESS;
+    if (!cached) {
+        if (tune_trials(config, max_threads, &tune) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        if (save_tuning(
+                path, model, config->rows, config->cols, max_threads, &tune
+            ) != EXIT_SUCCESS)
+            fprintf(stderr, "Could not write the tuning cache '%s'.\n", path);
+    }
+
+    config->kernel = tune.kernel;
+    config->threads = tune.threads;
+    config->tile_rows = tune.tile_rows;
+    config->tile_cols = tune.tile_cols;
+    select_kernel(tune.kernel);
+#ifdef _OPENMP
+    omp_set_num_threads(tune.threads);
+#endif
+    printf(
+        "Autotune: kernel %s, %d threads, %d steps per block of %d x %d, "
+        "%.3f ms a step (%s)\n", tune.kernel, tune.threads,
+        tune.block_steps, tune.tile_rows, tune.tile_cols,
+        1e3 * tune.seconds, cached ? "cached" : "measured"
+    );
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Times the calc_temp variants on a plate of the run's size.
+ * @details One setting at a time, each keeping the best of the one
+ * before: every kernel the CPU supports on max_threads threads, then 1,
+ * 2, 4, ... and max_threads threads, then, if the run is blocked, every
+ * tile in tune_tiles. A full search would take the product of those
+ * trials for little more.
+ *
+ * @param[in] config The settings; the plate size, boundary and block
+ * steps are used.
+ * @param[in] max_threads The most threads to try.
+ * @param[out] best The fastest variant and its time per step.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the plate could not be
+ * allocated.
+ */
+int tune_trials(const Config_t * config, int max_threads, Tune_t * best) {
+    static const int tune_tiles[][2] = {
+        { TILE_ROWS, TILE_COLS }, { 16, 1024 }, { 64, 256 }, { 128, 128 }
+    };
+    const int tile_count = sizeof(tune_tiles) / sizeof(tune_tiles[0]);
+    Plate_t plate;
+    Tune_t trial;
+    int k, t;
+
+    if (create_plate(&plate, config->rows, config->cols, 2) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    init_plate(&plate, &config->boundary);
+
+    best->kernel = NULL;
+    best->threads = max_threads;
+    best->block_steps = config->block_steps;
+    best->tile_rows = TILE_ROWS;
+    best->tile_cols = TILE_COLS;
+    best->seconds = 0;
+    for (k = 0; k < kernel_count; k++) {
+        if (select_kernel(kernels[k].name) != EXIT_SUCCESS)
+            continue;
+        trial = *best;
+        trial.kernel = kernels[k].name;
+        time_variant(&plate, &trial);
+        if (best->kernel == NULL || trial.seconds < best->seconds)
+            *best = trial;
+    }
+    select_kernel(best->kernel);
+
+    for (t = 1; t < max_threads;
+        t = 2 * t > max_threads && t < max_threads ? max_threads : 2 * t) {
+        trial = *best;
+        trial.threads = t;
+        time_variant(&plate, &trial);
+        if (trial.seconds < best->seconds)
+            *best = trial;
+    }
+
+    trial = *best;
+    for (t = 0; t < tile_count && best->block_steps > 1; t++) {
+        trial.tile_rows = tune_tiles[t][0];
+        trial.tile_cols = tune_tiles[t][1];
+        time_variant(&plate, &trial);
+        if (trial.seconds < best->seconds)
+            *best = trial;
+    }
+    destroy_plate(&plate);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Times one calc_temp variant.
+ * @details As time_case, but with TUNE_REPEATS runs after one untimed
+ * one, each of whole blocks and about a million cells. The steps are not
+ * measured, as most steps of a run are not.
+ *
+ * @param[in,out] plate The plate to step.
+ * @param[in,out] tune The variant; its time per step (the median) is
+ * filled in. Its kernel must be the one selected.
+ */
+void time_variant(Plate_t * plate, Tune_t * tune) {
+    const double cells = (double) (plate->rows - 2) * (plate->cols - 2);
+    const int blocks = cells * tune->block_steps < (1 << 20) ?
+        (int) ((1 << 20) / (cells * tune->block_steps)) : 1;
+    double sample[TUNE_REPEATS], start;
+    int run, i;
+
+#ifdef _OPENMP
+    omp_set_num_threads(tune->threads);
+#endif
+    for (run = -1; run < TUNE_REPEATS; run++) {
+        start = wall_seconds();
+        for (i = 0; i < blocks; i++) {
+            calc_temp_blocked(
+                plate, tune->block_steps, tune->tile_rows, tune->tile_cols, 0
+            );
+        }
+        if (run >= 0)
+            sample[run] = (wall_seconds() - start) /
+                ((double) blocks * tune->block_steps);
+    }
+    qsort(sample, TUNE_REPEATS, sizeof(double), compare_doubles);
+    tune->seconds = sample[TUNE_REPEATS / 2];
+
+    return;
+}
+
+/**
+ * @brief Looks up a tuned variant in the cache file.
+ * @details The file has one line per variant: the CPU model, rows, cols,
+ * the most threads and the block steps it was tuned for, then the kernel,
+ * threads, tile rows and columns and the time per step, separated by
+ * tabs.
+ * The last line that matches counts, and only if this build still has
+ * its kernel and the CPU supports it.
+ *
+ * @param[in] path The cache file.
+ * @param[in] model The CPU model, see cpu_model.
+ * @param[in] rows Rows of the plate.
+ * @param[in] cols Columns of the plate.
+ * @param[in] max_threads The most threads the run may use.
+ * @param[in] block_steps The steps per block of the run.
+ * @param[out] tune The variant found.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if there is none.
+ */
+int load_tuning(
+    const char * path, const char * model, int rows, int cols,
+    int max_threads, int block_steps, Tune_t * tune
+) {
+    FILE * file = fopen(path, "r");
+    char line[512], kernel[32], * tab;
+    int found = 0, r, c, m, k;
+    Tune_t entry;
+
+    if (file == NULL)
+        return EXIT_FAILURE;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        tab = strchr(line, '\t');
+        if (tab == NULL || (size_t) (tab - line) != strlen(model) ||
+            strncmp(line, model, tab - line) != 0)
+            continue;
+        if (sscanf(tab + 1, "%d %d %d %d %31s %d %d %d %lf", &r, &c, &m,
+                &entry.block_steps, kernel, &entry.threads,
+                &entry.tile_rows, &entry.tile_cols, &entry.seconds) != 9 ||
+            r != rows || c != cols || m != max_threads ||
+            entry.block_steps != block_steps ||
+            entry.threads < 1 || entry.threads > max_threads ||
+            entry.tile_rows < 1 || entry.tile_cols < 1)
+            continue;
+        for (k = 0; k < kernel_count; k++) {
+            if (strcmp(kernel, kernels[k].name) == 0 &&
+                select_kernel(kernels[k].name) == EXIT_SUCCESS) {
+                entry.kernel = kernels[k].name;
+                *tune = entry;
+                found = 1;
+            }
+        }
+    }
+    fclose(file);
+
+    return found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Adds a tuned variant to the cache file, see load_tuning.
+ *
+ * @param[in] path The cache file, created if it does not exist.
+ * @param[in] model The CPU model.
+ * @param[in] rows Rows of the plate.
+ * @param[in] cols Columns of the plate.
+ * @param[in] max_threads The most threads it was tuned for.
+ * @param[in] tune The variant.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if it could not be written.
+ */
+int save_tuning(
+    const char * path, const char * model, int rows, int cols,
+    int max_threads, const Tune_t * tune
+) {
+    FILE * file = fopen(path, "a");
+    int ok;
+
+    if (file == NULL)
+        return EXIT_FAILURE;
+    ok = fprintf(file, "%s\t%d\t%d\t%d\t%d\t%s\t%d\t%d\t%d\t%.9g\n", model,
+        rows, cols, max_threads, tune->block_steps, tune->kernel,
+        tune->threads, tune->tile_rows, tune->tile_cols,
+        tune->seconds) > 0;
+
+    return fclose(file) == 0 && ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Runs the job daemon of --daemon.
+ * @details Listens on a UNIX socket at path, replacing a stale one, and
+ * starts --workers worker threads, each with one plate of the default
+ * size in the pool, before it takes connections. Every connection gets a
+ * reader thread that queues its jobs (see serve_client); the workers take
+ * them in order and send each job's frames and result back on it. A
+ * "shutdown" line from any client stops taking connections; the queued
+ * jobs are still run, and the totals are printed before it returns. No
+ * thread outlives the daemon: the readers are stopped and joined before
+ * the workers.
+ *
+ * @param[in] config The settings; the plate size, boundary and tolerance
+ * are the defaults of a job.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the socket or the workers could
+ * not be set up.
+ */
+int run_daemon(const Config_t * config) {
+    Daemon_t daemon;
+    Daemon_client_t * client;
+    struct sockaddr_un address;
+    char stats[512];
+    int fd, i, status = EXIT_SUCCESS;
+
+    memset(&daemon, 0, sizeof(daemon));
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(config->daemon) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "The socket path '%s' is too long.\n",
+            config->daemon);
+        return EXIT_FAILURE;
+    }
+    strcpy(address.sun_path, config->daemon);
+    daemon.config = config;
+    daemon.workers = config->workers;
+#ifdef _OPENMP
+    if (daemon.workers == 0)
+        daemon.workers = config->threads > 0 ? config->threads :
+            omp_get_max_threads();
+#endif
+    if (daemon.workers == 0)
+        daemon.workers = 1;
+    for (i = 0; i < daemon.workers && i < DAEMON_POOL; i++) {
+        if (create_plate(
+                &daemon.pool[i], config->rows, config->cols, 2
+            ) != EXIT_SUCCESS)
+            break;
+        daemon.pooled++;
+    }
+
+    daemon.listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(config->daemon);
+    if (daemon.listener < 0 || bind(
+            daemon.listener, (struct sockaddr *) &address, sizeof(address)
+        ) != 0 || listen(daemon.listener, SOMAXCONN) != 0) {
+        fprintf(stderr, "Could not listen on '%s'.\n", config->daemon);
+        if (daemon.listener >= 0)
+            close(daemon.listener);
+        for (i = 0; i < daemon.pooled; i++) {
+            destroy_plate(&daemon.pool[i]);
+        }
+        return EXIT_FAILURE;
+    }
+    pthread_mutex_init(&daemon.lock, NULL);
+    pthread_cond_init(&daemon.changed, NULL);
+    daemon.worker = malloc(sizeof(pthread_t) * daemon.workers);
+    for (i = 0; daemon.worker != NULL && i < daemon.workers; i++) {
+        if (pthread_create(
+                &daemon.worker[i], NULL, run_worker, &daemon
+            ) != 0)
+            break;
+    }
+    daemon.workers = daemon.worker == NULL ? 0 : i;
+    daemon.started = wall_seconds();
+
+    if (daemon.workers == 0) {
+        fputs("Could not start the workers.\n", stderr);
+        status = EXIT_FAILURE;
+    } else {
+        printf("Daemon: listening on %s with %d workers\n", config->daemon,
+            daemon.workers);
+        fflush(stdout);
+    }
+    /*  stop_daemon shuts the listener down, which ends the accept. */
+    while (status == EXIT_SUCCESS) {
+        fd = accept(daemon.listener, NULL, NULL);
+        if (fd < 0 && errno == EINTR)
+            continue;
+        if (fd < 0)
+            break;
+        join_readers(&daemon, 0);
+        client = calloc(1, sizeof(Daemon_client_t));
+        if (client == NULL) {
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->daemon = &daemon;
+        client->reading = 1;
+        pthread_mutex_init(&client->lock, NULL);
+        pthread_mutex_lock(&daemon.lock);
+        if (pthread_create(
+                &client->reader, NULL, serve_client, client
+            ) != 0) {
+            pthread_mutex_unlock(&daemon.lock);
+            pthread_mutex_destroy(&client->lock);
+            close(fd);
+            free(client);
+            continue;
+        }
+        client->next = daemon.clients;
+        daemon.clients = client;
+        pthread_mutex_unlock(&daemon.lock);
+    }
+
+    stop_daemon(&daemon);
+    join_readers(&daemon, 1);
+    for (i = 0; i < daemon.workers; i++) {
+        pthread_join(daemon.worker[i], NULL);
+    }
+    format_stats(&daemon, stats, sizeof(stats));
+    printf("Daemon: %s", stats);
+    close(daemon.listener);
+    unlink(config->daemon);
+    for (i = 0; i < daemon.pooled; i++) {
+        destroy_plate(&daemon.pool[i]);
+    }
+    free(daemon.worker);
+    pthread_cond_destroy(&daemon.changed);
+    pthread_mutex_destroy(&daemon.lock);
+
+    return status;
+}
+
+/**
+ * @brief Stops the daemon from taking connections and new jobs.
+ * @details Wakes the workers, which leave once the queue is empty.
+ *
+ * @param[in,out] daemon The daemon.
+ */
+void stop_daemon(Daemon_t * daemon) {
+    pthread_mutex_lock(&daemon->lock);
+    if (!daemon->stop)
+        shutdown(daemon->listener, SHUT_RDWR);
+    daemon->stop = 1;
+    pthread_cond_broadcast(&daemon->changed);
+    pthread_mutex_unlock(&daemon->lock);
+
+    return;
+}
+
+/**
+ * @brief Reads the lines of one client of the daemon.
+ * @details Each line is a command:
+ *   job [rows=R] [cols=C] [boundary=T,B,L,R,I] [threshold=X]
+ *       [times=S1,S2,...] [steps=N]
+ *     queues a job and answers "queued ID". Omitted fields are those of
+ *     the daemon's command line.
+ *   stats
+ *     answers with the daemon's totals, see format_stats.
+ *   shutdown
+ *     stops the daemon once the queued jobs are done.
+ *   quit
+ *     ends the connection once its jobs are done, as closing it does.
+ * Anything else is answered by "error" and a reason. A line longer than
+ * DAEMON_LINE is answered by "error line too long" and skipped.
+ *
+ * @param[in] argument The Daemon_client_t.
+ *
+ * @return NULL.
+ */
+void * serve_client(void * argument) {
+    Daemon_client_t * client = argument;
+    Daemon_t * daemon = client->daemon;
+    FILE * in = fdopen(dup(client->fd), "r");
+    char line[DAEMON_LINE], reply[512];
+    int skip = 0, c;
+
+    while (in != NULL && fgets(line, sizeof(line), in) != NULL) {
+        if (strchr(line, '\n') == NULL && !feof(in)) {
+            /*  Drop the rest of the line; the part read is not a command. */
+            while ((c = getc(in)) != EOF && c != '\n')
+                ;
+            skip = 1;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        reply[0] = '\0';
+        if (skip) {
+            snprintf(reply, sizeof(reply), "error line too long\n");
+            skip = 0;
+        } else if (strncmp(line, "job", 3) == 0 &&
+            (line[3] == '\0' || line[3] == ' ')) {
+            queue_job(client, line + 3);
+        } else if (strcmp(line, "stats") == 0) {
+            memcpy(reply, "stats ", 6);
+            format_stats(daemon, reply + 6, sizeof(reply) - 6);
+        } else if (strcmp(line, "shutdown") == 0) {
+            stop_daemon(daemon);
+            snprintf(reply, sizeof(reply), "bye\n");
+        } else if (strcmp(line, "quit") == 0) {
+            break;
+        } else if (line[0] != '\0') {
+            snprintf(reply, sizeof(reply), "error unknown command\n");
+        }
+        if (reply[0] != '\0') {
+            pthread_mutex_lock(&client->lock);
+            send_text(client, reply);
+            pthread_mutex_unlock(&client->lock);
+        }
+    }
+    if (in != NULL)
+        fclose(in);
+    pthread_mutex_lock(&daemon->lock);
+    client->done = 1;
+    pthread_mutex_unlock(&daemon->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Queues a job of a client of the daemon.
+ * @details Answers "queued ID", or "error" and the reason the job was not
+ * queued: "error busy" once the queue holds DAEMON_JOBS jobs or the
+ * client has DAEMON_CLIENT_JOBS queued or running. The client's lock is
+ * taken before the daemon's, so the answer goes out before any result of
+ * the job.
+ *
+ * @param[in,out] client The client.
+ * @param[in] text The fields of the job line, see parse_job.
+ */
+void queue_job(Daemon_client_t * client, char * text) {
+    Daemon_t * daemon = client->daemon;
+    Daemon_job_t * job = calloc(1, sizeof(Daemon_job_t));
+    const char * error = job == NULL ? "out of memory" :
+        parse_job(daemon, text, job);
+    char reply[128];
+
+    pthread_mutex_lock(&client->lock);
+    pthread_mutex_lock(&daemon->lock);
+    if (error == NULL && daemon->stop)
+        error = "shutting down";
+    if (error == NULL && (daemon->queued >= DAEMON_JOBS ||
+        client->pending >= DAEMON_CLIENT_JOBS))
+        error = "busy";
+    if (error == NULL) {
+        job->id = ++daemon->next_id;
+        job->client = client;
+        job->queued = wall_seconds();
+        if (daemon->tail != NULL)
+            daemon->tail->next = job;
+        else
+            daemon->head = job;
+        daemon->tail = job;
+        daemon->queued++;
+        daemon->received++;
+        client->pending++;
+        pthread_cond_signal(&daemon->changed);
+        snprintf(reply, sizeof(reply), "queued %ld\n", job->id);
+    } else {
+        snprintf(reply, sizeof(reply), "error %s\n", error);
+    }
+    pthread_mutex_unlock(&daemon->lock);
+    send_text(client, reply);
+    pthread_mutex_unlock(&client->lock);
+    if (error != NULL && job != NULL) {
+        free(job->times);
+        free(job);
+    }
+
+    return;
+}
+
+/**
+ * @brief Reads the fields of a job line.
+ *
+ * @param[in] daemon The daemon, whose settings are the defaults.
+ * @param[in] text The fields, key=value separated by blanks.
+ * @param[out] job The job; times is allocated when there are any.
+ *
+ * @return NULL, or the reason the line is not a valid job.
+ */
+const char * parse_job(
+    const Daemon_t * daemon, char * text, Daemon_job_t * job
+) {
+    const Config_t * config = daemon->config;
+    char * field, * value, * end, * save = NULL;
+    int * grown;
+    long number;
+
+    job->rows = config->rows;
+    job->cols = config->cols;
+    job->boundary = config->boundary;
+    job->threshold = config->tolerance;
+    job->max_steps = DAEMON_STEPS;
+    for (field = strtok_r(text, " \t", &save); field != NULL;
+        field = strtok_r(NULL, " \t", &save)) {
+        value = strchr(field, '=');
+        if (value == NULL)
+            return "expected key=value";
+        *value++ = '\0';
+        if (strcmp(field, "rows") == 0) {
+            if (parse_positive_int(value, &job->rows) != EXIT_SUCCESS)
+                return "bad rows";
+        } else if (strcmp(field, "cols") == 0) {
+            if (parse_positive_int(value, &job->cols) != EXIT_SUCCESS)
+                return "bad cols";
+        } else if (strcmp(field, "boundary") == 0) {
+            if (parse_boundary(value, &job->boundary) != EXIT_SUCCESS)
+                return "bad boundary";
+        } else if (strcmp(field, "threshold") == 0) {
+            job->threshold = strtod(value, &end);
+            if (end == value || *end != '\0' || job->threshold <= 0)
+                return "bad threshold";
+        } else if (strcmp(field, "steps") == 0) {
+            if (parse_positive_int(value, &job->max_steps) != EXIT_SUCCESS)
+                return "bad steps";
+        } else if (strcmp(field, "times") == 0) {
+            while (*value != '\0') {
+                number = strtol(value, &end, 10);
+                if (end == value || number < 0 || number > INT32_MAX ||
+                    (*end != ',' && *end != '\0'))
+                    return "bad times";
+                grown = realloc(job->times, sizeof(int) * (job->count + 1));
+                if (grown == NULL)
+                    return "out of memory";
+                job->times = grown;
+                job->times[job->count++] = (int) number;
+                value = *end == ',' ? end + 1 : end;
+            }
+        } else {
+            return "unknown field";
+        }
+    }
+    if (job->rows < 3 || job->cols < 3 ||
+        (double) job->rows * job->cols > DAEMON_CELLS)
+        return "rows and cols must be 3 or more and the plate not too big";
+    if (job->count > 1)
+        qsort(job->times, job->count, sizeof(int), compare_ints);
+
+    return NULL;
+}
+
+/**
+ * @brief qsort order of ints, smallest first.
+ *
+ * @param[in] a The first int.
+ * @param[in] b The second int.
+ *
+ * @return Negative, zero or positive as a is below, equal to or above b.
+ */
+int compare_ints(const void * a, const void * b) {
+    const int x = *(const int *) a, y = *(const int *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief A worker thread of the daemon.
+ * @details Runs the queued jobs in order until the daemon stops and the
+ * queue is empty. A job runs on this thread alone: OpenMP gets one
+ * thread here, since the workers already keep the cores busy.
+ *
+ * @param[in] argument The Daemon_t.
+ *
+ * @return NULL.
+ */
+void * run_worker(void * argument) {
+    Daemon_t * daemon = argument;
+    Daemon_job_t * job;
+    double waited, started;
+
+#ifdef _OPENMP
+    omp_set_num_threads(1);
+#endif
+    while (1) {
+        pthread_mutex_lock(&daemon->lock);
+        while (daemon->head == NULL && !daemon->stop)
+            pthread_cond_wait(&daemon->changed, &daemon->lock);
+        job = daemon->head;
+        if (job == NULL) {
+            pthread_mutex_unlock(&daemon->lock);
+            break;
+        }
+        daemon->head = job->next;
+        if (daemon->head == NULL)
+            daemon->tail = NULL;
+        daemon->queued--;
+        daemon->running++;
+        started = wall_seconds();
+        waited = started - job->queued;
+        daemon->queue_seconds += waited;
+        if (waited > daemon->queue_max)
+            daemon->queue_max = waited;
+        pthread_mutex_unlock(&daemon->lock);
+
+        run_job(daemon, job, waited);
+
+        pthread_mutex_lock(&daemon->lock);
+        daemon->running--;
+        daemon->run_seconds += wall_seconds() - started;
+        pthread_mutex_unlock(&daemon->lock);
+        release_client(job->client, 1);
+        free(job->times);
+        free(job);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Runs one job of the daemon and sends its results.
+ * @details The plate is stepped with calc_temp until the change of a
+ * step is below the job's threshold or it has taken its steps. The plate
+ * is sent as a frame (see send_plate) at each of the job's times it
+ * reaches, and once more at the end unless that was just sent. Then one
+ * line: "done ID converged|stopped STEPS CHANGE QUEUE_MS RUN_MS". If the
+ * plate cannot be had, the job is answered by "error ID out of memory".
+ *
+ * @param[in,out] daemon The daemon, for its plates and totals.
+ * @param[in] job The job.
+ * @param[in] waited Seconds the job was queued.
+ */
+void run_job(Daemon_t * daemon, const Daemon_job_t * job, double waited) {
+    Daemon_client_t * client = job->client;
+    const double started = wall_seconds();
+    double change = 0;
+    char line[256];
+    int time = 0, next = 0, sent = -1, done = 0;
+    Plate_t plate;
+
+    if (take_plate(daemon, &plate, job->rows, job->cols) != EXIT_SUCCESS) {
+        snprintf(line, sizeof(line), "error %ld out of memory\n", job->id);
+        pthread_mutex_lock(&client->lock);
+        send_text(client, line);
+        pthread_mutex_unlock(&client->lock);
+        pthread_mutex_lock(&daemon->lock);
+        daemon->failed++;
+        pthread_mutex_unlock(&daemon->lock);
+        return;
+    }
+    init_plate(&plate, &job->boundary);
+    while (!__atomic_load_n(&client->failed, __ATOMIC_RELAXED)) {
+        while (next < job->count && job->times[next] <= time) {
+            if (job->times[next] == time && sent != time) {
+                send_plate(client, &plate, job->id, time);
+                sent = time;
+            }
+            next++;
+        }
+        if (done)
+            break;
+        change = calc_temp(&plate);
+        time++;
+        done = change < job->threshold || time >= job->max_steps;
+    }
+    if (sent != time)
+        send_plate(client, &plate, job->id, time);
+    snprintf(line, sizeof(line), "done %ld %s %d %.6e %.3f %.3f\n",
+        job->id, change < job->threshold ? "converged" : "stopped", time,
+        change, 1e3 * waited, 1e3 * (wall_seconds() - started));
+    pthread_mutex_lock(&client->lock);
+    send_text(client, line);
+    pthread_mutex_unlock(&client->lock);
+
+    pthread_mutex_lock(&daemon->lock);
+    if (__atomic_load_n(&client->failed, __ATOMIC_RELAXED))
+        daemon->failed++;
+    else
+        daemon->completed++;
+    daemon->cells += (double) (job->rows - 2) * (job->cols - 2) * time;
+    pthread_mutex_unlock(&daemon->lock);
+    give_plate(daemon, &plate);
+
+    return;
+}
+
+/**
+ * @brief Sends a plate to a client of the daemon.
+ * @details A line "frame ID TIME ROWS COLS", then every row on a line of
+ * its own, the cells as %.9g separated by blanks. The client's lock is
+ * held for the whole frame, so frames of different jobs do not mix.
+ *
+ * @param[in,out] client The client.
+ * @param[in] plate The plate to send.
+ * @param[in] id The job.
+ * @param[in] time The step the plate is at.
+ */
+void send_plate(
+    Daemon_client_t * client, const Plate_t * plate, long id, int time
+) {
+    const double * data = plate_data(plate);
+    char * text = malloc((size_t) plate->cols * 24 + 64);
+    size_t length;
+    int i, j;
+
+    pthread_mutex_lock(&client->lock);
+    if (text == NULL) {
+        __atomic_store_n(&client->failed, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&client->lock);
+        return;
+    }
+    sprintf(text, "frame %ld %d %d %d\n", id, time, plate->rows, plate->cols);
+    send_text(client, text);
+    for (i = 0; i < plate->rows && !client->failed; i++) {
+        const double * row = data + (size_t) i * plate->pitch;
+
+        length = 0;
+        for (j = 0; j < plate->cols; j++) {
+            length += sprintf(text + length, j == 0 ? "%.9g" : " %.9g",
+                row[j]);
+        }
+        text[length++] = '\n';
+        text[length] = '\0';
+        send_text(client, text);
+    }
+    pthread_mutex_unlock(&client->lock);
+    free(text);
+
+    return;
+}
+
+/**
+ * @brief Sends text to a client of the daemon; its lock must be held.
+ * @details Once a send fails (the client went away) the client is marked
+ * failed and nothing more is sent to it. The daemon is not killed by
+ * SIGPIPE.
+ *
+ * @param[in,out] client The client.
+ * @param[in] text The text.
+ */
+void send_text(Daemon_client_t * client, const char * text) {
+    size_t length = strlen(text);
+    ssize_t sent;
+
+    while (length > 0 && !client->failed) {
+        sent = send(client->fd, text, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0) {
+            __atomic_store_n(&client->failed, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        text += sent;
+        length -= sent;
+    }
+
+    return;
+}
+
+/**
+ * @brief Drops a reference to a client of the daemon.
+ * @details The reader holds one until its connection ends and every job
+ * one until it is done. The last one closes the connection.
+ *
+ * @param[in,out] client The client, freed if this was the last use.
+ * @param[in] job Non-zero if a job is done, zero if the reader has been
+ * joined.
+ */
+void release_client(Daemon_client_t * client, int job) {
+    int last;
+
+    pthread_mutex_lock(&client->lock);
+    if (job)
+        client->pending--;
+    else
+        client->reading = 0;
+    last = !client->reading && client->pending == 0;
+    pthread_mutex_unlock(&client->lock);
+    if (!last)
+        return;
+    close(client->fd);
+    pthread_mutex_destroy(&client->lock);
+    free(client);
+
+    return;
+}
+
+/**
+ * @brief Joins the reader threads of the daemon's clients.
+ * @details With all zero only the readers that are done are joined, so
+ * the list stays as short as the open connections. With all non-zero the
+ * connections still open are shut down for reading first, which ends
+ * their readers as if the client had closed them; the jobs they queued
+ * still send their results.
+ *
+ * @param[in,out] daemon The daemon.
+ * @param[in] all Non-zero to join every reader.
+ */
+void join_readers(Daemon_t * daemon, int all) {
+    Daemon_client_t * joined = NULL, ** link, * client;
+
+    pthread_mutex_lock(&daemon->lock);
+    link = &daemon->clients;
+    while (*link != NULL) {
+        client = *link;
+        if (!all && !client->done) {
+            link = &client->next;
+            continue;
+        }
+        if (!client->done)
+            shutdown(client->fd, SHUT_RD);
+        *link = client->next;
+        client->next = joined;
+        joined = client;
+    }
+    pthread_mutex_unlock(&daemon->lock);
+
+    while (joined != NULL) {
+        client = joined;
+        joined = client->next;
+        pthread_join(client->reader, NULL);
+        release_client(client, 0);
+    }
+
+    return;
+}
+
+/**
+ * @brief Takes a plate of a size from the daemon's pool.
+ * @details A pooled plate of the same size is reused; otherwise a new
+ * one is created.
+ *
+ * @param[in,out] daemon The daemon.
+ * @param[out] plate The plate.
+ * @param[in] rows Rows of the plate.
+ * @param[in] cols Columns of the plate.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if a new plate could not be
+ * allocated.
+ */
+int take_plate(Daemon_t * daemon, Plate_t * plate, int rows, int cols) {
+    int i;
+
+    pthread_mutex_lock(&daemon->lock);
+    for (i = daemon->pooled - 1; i >= 0; i--) {
+        if (daemon->pool[i].rows == rows && daemon->pool[i].cols == cols)
+            break;
+    }
+    if (i >= 0) {
+        *plate = daemon->pool[i];
+        daemon->pool[i] = daemon->pool[--daemon->pooled];
+    }
+    pthread_mutex_unlock(&daemon->lock);
+    if (i >= 0)
+        return EXIT_SUCCESS;
+
+    return create_plate(plate, rows, cols, 2);
+}
+
+/**
+ * @brief Puts a plate back in the daemon's pool.
+ * @details When the pool is full, the plate that has been there longest
+ * is freed to make room.
+ *
+ * @param[in,out] daemon The daemon.
+ * @param[in] plate The plate, no longer used by the caller.
+ */
+void give_plate(Daemon_t * daemon, const Plate_t * plate) {
+    Plate_t oldest;
+    int full;
+
+    pthread_mutex_lock(&daemon->lock);
+    full = daemon->pooled == DAEMON_POOL;
+    if (full) {
+        oldest = daemon->pool[0];
+        memmove(daemon->pool, daemon->pool + 1,
+            sizeof(Plate_t) * (DAEMON_POOL - 1));
+        daemon->pooled--;
+    }
+    daemon->pool[daemon->pooled++] = *plate;
+    pthread_mutex_unlock(&daemon->lock);
+    if (full)
+        destroy_plate(&oldest);
+
+    return;
+}
+
+/**
+ * @brief Formats the totals of the daemon as one line.
+ * @details The jobs received, queued, running, done and failed, the
+ * workers and pooled plates, the mean and longest time a job waited in
+ * the queue, and the jobs and cell updates per second since the start.
+ *
+ * @param[in,out] daemon The daemon.
+ * @param[out] text Receives the line, ending in a newline.
+ * @param[in] size The room in text.
+ */
+void format_stats(Daemon_t * daemon, char * text, size_t size) {
+    double uptime;
+    long started;
+
+    pthread_mutex_lock(&daemon->lock);
+    uptime = wall_seconds() - daemon->started;
+    started = daemon->completed + daemon->failed + daemon->running;
+    snprintf(text, size,
+        "received=%ld queued=%d running=%d done=%ld failed=%ld "
+        "workers=%d pooled=%d queue_ms_mean=%.3f queue_ms_max=%.3f "
+        "busy=%.1f%% jobs_per_s=%.2f cells_per_s=%.3e uptime_s=%.1f\n",
+        daemon->received, daemon->queued, daemon->running,
+        daemon->completed, daemon->failed, daemon->workers, daemon->pooled,
+        started > 0 ? 1e3 * daemon->queue_seconds / started : 0.0,
+        1e3 * daemon->queue_max,
+        uptime > 0 && daemon->workers > 0 ?
+            100 * daemon->run_seconds / uptime / daemon->workers : 0.0,
+        uptime > 0 ? daemon->completed / uptime : 0.0,
+        uptime > 0 ? daemon->cells / uptime : 0.0, uptime
+    );
+    pthread_mutex_unlock(&daemon->lock);
+
+    return;
+}
+
+/**
+ * @brief Advances the plate several time steps one cache tile at a time.
+ * @details The interior is cut into tiles. Each tile is copied together
+ * with a halo as wide as the number of steps into a private scratch area
+ * and advanced there; the halo absorbs the cells that go stale from the
+ * tile's outside, so after the last step the tile itself is exact. Tiles
+ * overlap only in what they read, so every grid cell crosses the memory
+ * bus once per block instead of once per step. The new values go to the
+ * back grid and the grids are swapped at the end.
+ * The cell values are bit-identical to running calc_temp steps times, and
+ * with steps == 1 this is calc_temp.
+ *
+ * @param[in,out] plate The plate, advanced by steps time steps.
+ * @param[in] steps Number of time steps to take.
+ * @param[in] tile_rows Interior rows per tile.
+ * @param[in] tile_cols Interior columns per tile.
+ * @param[in] measure Non-zero to measure the change of the last step.
+ *
+ * @return The total absolute change of the last of the steps, which is
+ * what the convergence test looks at, or 0 if measure is zero.
+ */
+double calc_temp_blocked(
+    Plate_t * plate, int steps, int tile_rows, int tile_cols, int measure
+) {
+    const int tiles_down = (plate->rows - 2 + tile_rows - 1) / tile_rows;
+    const int tiles_across = (plate->cols - 2 + tile_cols - 1) / tile_cols;
+    const size_t scratch_size =
+        sizeof(double) * 2 * (tile_rows + 2 * steps) * (tile_cols + 2 * steps);
+    double delta_temp = 0, * partial = NULL;
+    int failed = 0, t;
+
+    if (steps == 1)
+        return stencil_step(plate, measure);
+    if (measure && deterministic) {
+        partial = malloc(sizeof(double) * tiles_down * tiles_across);
+        failed = partial == NULL;
+    }
+
+    #pragma omp parallel reduction(+:delta_temp) reduction(|:failed)
+    {
+        double * scratch = failed ? NULL : malloc(scratch_size);
+        double tile;
+
+        failed = scratch == NULL;
+        #pragma omp for schedule(static)
+        for (t = 0; t < tiles_down * tiles_across; t++) {
+            if (scratch == NULL)
+                continue;
+            tile = advance_tile(
+                plate, scratch,
+                1 + t / tiles_across * tile_rows,
+                1 + t % tiles_across * tile_cols,
+                tile_rows, tile_cols, steps, measure
+            );
+            if (partial != NULL)
+                partial[t] = tile;
+            else
+                delta_temp += tile;
+        }
+        free(scratch);
+    }
+    if (partial != NULL && !failed)
+        delta_temp = sum_partials(partial, tiles_down * tiles_across);
+    free(partial);
+
+    /*  The current grid is untouched until the swap, so a failed scratch
+        allocation can still fall back to plain steps. */
+    if (failed) {
+        for (t = 0; t < steps; t++)
+            delta_temp = stencil_step(plate, measure && t == steps - 1);
+        return delta_temp;
+    }
+    swap_plate(plate);
+
+    return delta_temp;
+}
+
+/**
+ * @brief Advances one tile of the plate steps time steps in scratch memory.
+ * @details The tile and its halo, clipped to the plate, are loaded into
+ * both halves of the scratch area. Step s recomputes the tile grown by
+ * steps - s cells on each side, so the region shrinks to the tile itself
+ * on the last step. The plate's edge cells are never recomputed. The tile
+ * is then stored in the plate's back grid.
+ *
+ * @param[in] plate The plate; its current grid is read, its back grid
+ * receives the tile.
+ * @param[out] scratch Room for two (tile_rows + 2 * steps) by
+ * (tile_cols + 2 * steps) grids.
+ * @param[in] first_row First interior row of the tile.
+ * @param[in] first_col First interior column of the tile.
+ * @param[in] tile_rows Rows in a full tile.
+ * @param[in] tile_cols Columns in a full tile.
+ * @param[in] steps Number of time steps.
+ * @param[in] measure Non-zero to measure the change of the last step.
+ *
+ * @return The total absolute change of the tile during the last step, or
+ * 0 if measure is zero.
+ */
+double advance_tile(
+    const Plate_t * plate, double * scratch, int first_row, int first_col,
+    int tile_rows, int tile_cols, int steps, int measure
+) {
+    const size_t pitch = plate->pitch;
+    const int end_row = first_row + tile_rows < plate->rows - 1 ?
+        first_row + tile_rows : plate->rows - 1;
+    const int end_col = first_col + tile_cols < plate->cols - 1 ?
+        first_col + tile_cols : plate->cols - 1;
+    /*  Loaded region: the tile plus its halo, clipped to the plate. */
+    const int top = first_row - steps > 0 ? first_row - steps : 0;
+    const int left = first_col - steps > 0 ? first_col - steps : 0;
+    const int bottom = end_row + steps < plate->rows ?
+        end_row + steps : plate->rows;
+    const int right = end_col + steps < plate->cols ?
+        end_col + steps : plate->cols;
+    const size_t width = right - left;
+    const size_t area = width * (bottom - top);
+    double * from = scratch, * to = scratch + area, * swap;
+    double delta_temp = 0;
+    int i, s;
+
+    for (i = top; i < bottom; i++) {
+        memcpy(
+            from + (i - top) * width, plate_data(plate) + i * pitch + left,
+            sizeof(double) * width
+        );
+    }
+    memcpy(to, from, sizeof(double) * area);
+
+    for (s = 1; s <= steps; s++) {
+        const int margin = steps - s;
+        const int row_lo = first_row - margin > 1 ? first_row - margin : 1;
+        const int row_hi = end_row + margin < plate->rows - 1 ?
+            end_row + margin : plate->rows - 1;
+        const int col_lo = first_col - margin > 1 ? first_col - margin : 1;
+        const int col_hi = end_col + margin < plate->cols - 1 ?
+            end_col + margin : plate->cols - 1;
+        /*  The row kernel writes cells 1 .. n of a row, so every row
+            pointer is moved to one cell left of col_lo. */
+        const int offset = col_lo - 1 - left;
+
+        for (i = row_lo; i < row_hi; i++) {
+            delta_temp += row_kernel(
+                from + (i - 1 - top) * width + offset,
+                from + (i - top) * width + offset,
+                from + (i + 1 - top) * width + offset,
+                to + (i - top) * width + offset,
+                col_hi - col_lo, measure && s == steps
+            );
+        }
+        swap = from;
+        from = to;
+        to = swap;
+    }
+
+    for (i = first_row; i < end_row; i++) {
+        memcpy(
+            plate_back(plate) + i * pitch + first_col,
+            from + (i - top) * width + (first_col - left),
+            sizeof(double) * (end_col - first_col)
+        );
+    }
+
+    return delta_temp;
+}
+
+/**
+ * @brief Sets up the active set of a plate, with every tile active.
+ *
+ * @param[out] set The active set.
+ * @param[in] plate The plate it will track.
+ * @param[in] tile Side of a tile in cells.
+ * @param[in] epsilon Largest change still counted as no change; 0 for the
+ * exact mode.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if an allocation failed.
+ */
+int create_active_set(
+    Active_set_t * set, const Plate_t * plate, int tile, double epsilon
+) {
+    int count, t;
+
+    set->tile = tile;
+    set->tiles_down = (plate->rows - 2 + tile - 1) / tile;
+    set->tiles_across = (plate->cols - 2 + tile - 1) / tile;
+    set->epsilon = epsilon;
+    set->computed = set->visited = 0;
+    count = set->tiles_down * set->tiles_across;
+    set->change = malloc(sizeof(double) * count);
+    set->next_change = malloc(sizeof(double) * count);
+    set->sum = calloc(count, sizeof(double));
+    set->synced = malloc(count);
+    if (set->change == NULL || set->next_change == NULL ||
+        set->sum == NULL || set->synced == NULL) {
+        destroy_active_set(set);
+        return EXIT_FAILURE;
+    }
+    for (t = 0; t < count; t++) {
+        set->change[t] = HUGE_VAL;
+        set->synced[t] = 0;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Releases what create_active_set allocated.
+ *
+ * @param[in,out] set The active set.
+ */
+void destroy_active_set(Active_set_t * set) {
+    free(set->change);
+    free(set->next_change);
+    free(set->sum);
+    free(set->synced);
+    set->change = set->next_change = set->sum = NULL;
+    set->synced = NULL;
+
+    return;
+}
+
+/**
+ * @brief One time step that skips the tiles whose neighbourhood is quiet.
+ * @details A tile is recomputed when it or one of its eight neighbour
+ * tiles changed by more than epsilon in the previous step; its inputs are
+ * all in that neighbourhood. After computing, a second pass over the tile,
+ * still in cache, records its largest change.
+ * With epsilon 0 a skipped tile's inputs did not change at all, so its new
+ * values equal its current ones, and the back grid already holds them too
+ * (the tile did not change in the previous step). The result is then
+ * bit-identical to calc_temp. With epsilon above 0 a skipped tile is
+ * frozen: its current values are copied to the back grid once and it
+ * counts as unchanged until a neighbour changes by more than epsilon.
+ *
+ * @param[in,out] plate The plate, advanced to the next time step.
+ * @param[in,out] set The active set of the plate.
+ *
+ * @return The total absolute change of the step.
+ */
+double active_step(Plate_t * plate, Active_set_t * set) {
+    const size_t pitch = plate->pitch;
+    const int count = set->tiles_down * set->tiles_across;
+    const double * old = plate_data(plate);
+    double * new = plate_back(plate);
+    double delta_temp = 0, * swap;
+    long computed = 0;
+    int t;
+
+    #pragma omp parallel for schedule(dynamic) \
+        reduction(+:delta_temp, computed)
+    for (t = 0; t < count; t++) {
+        const int down = t / set->tiles_across, across = t % set->tiles_across;
+        const int first_row = 1 + down * set->tile;
+        const int first_col = 1 + across * set->tile;
+        const int end_row = first_row + set->tile < plate->rows - 1 ?
+            first_row + set->tile : plate->rows - 1;
+        const int end_col = first_col + set->tile < plate->cols - 1 ?
+            first_col + set->tile : plate->cols - 1;
+        double max = 0, sum = 0, d;
+        int active = 0, a, b, i, j;
+
+        for (a = down - 1; a <= down + 1; a++) {
+            for (b = across - 1; b <= across + 1; b++) {
+                if (a >= 0 && a < set->tiles_down &&
+                    b >= 0 && b < set->tiles_across &&
+                    set->change[a * set->tiles_across + b] > set->epsilon)
+                    active = 1;
+            }
+        }
+
+        if (!active) {
+            if (!set->synced[t]) {
+                for (i = first_row; i < end_row; i++)
+                    memcpy(
+                        new + i * pitch + first_col, old + i * pitch + first_col,
+                        sizeof(double) * (end_col - first_col)
+                    );
+                set->synced[t] = 1;
+            }
+            set->next_change[t] = 0;
+            set->sum[t] = 0;
+            continue;
+        }
+
+        for (i = first_row; i < end_row; i++) {
+            row_kernel(
+                old + (i - 1) * pitch + first_col - 1,
+                old + i * pitch + first_col - 1,
+                old + (i + 1) * pitch + first_col - 1,
+                new + i * pitch + first_col - 1,
+                end_col - first_col, 0
+            );
+            for (j = first_col; j < end_col; j++) {
+                d = fabs(new[i * pitch + j] - old[i * pitch + j]);
+                sum += d;
+                if (d > max)
+                    max = d;
+            }
+        }
+        if (deterministic)
+            set->sum[t] = sum;
+        else
+            delta_temp += sum;
+        set->next_change[t] = max;
+        set->synced[t] = max == 0;
+        computed++;
+    }
+
+    if (deterministic)
+        delta_temp = sum_partials(set->sum, count);
+    swap = set->change;
+    set->change = set->next_change;
+    set->next_change = swap;
+    set->computed += computed;
+    set->visited += count;
+    swap_plate(plate);
+
+    return delta_temp;
+}
+
+/**
+ * @brief Measures the last time step by comparing the two grids.
+ * @details After an unmeasured step the back grid still holds the plate
+ * one step earlier, so one pass over both gives every statistic at once.
+ *
+ * @param[in] plate The plate, right after a time step.
+ * @param[out] change The sum, sum of squares and largest absolute change.
+ */
+void measure_change(const Plate_t * plate, Change_t * change) {
+    const size_t pitch = plate->pitch;
+    const double * new = plate_data(plate);
+    const double * old = plate_back(plate);
+    double sum = 0, sum_sq = 0, max = 0;
+    int i;
+    TRACE_START(start);
+
+    #pragma omp parallel for schedule(static) \
+        reduction(+:sum, sum_sq) reduction(max:max)
+    for (i = 1; i < plate->rows - 1; i++) {
+        const double * a = new + i * pitch, * b = old + i * pitch;
+        double d;
+        int j;
+
+        /*  The cells go straight into the reduction, unless
+            --deterministic keeps each row's sums for sum_partials. */
+        if (deterministic)
+            sum = sum_sq = 0;
+        for (j = 1; j < plate->cols - 1; j++) {
+            d = fabs(a[j] - b[j]);
+            sum += d;
+            sum_sq += d * d;
+            if (d > max)
+                max = d;
+        }
+        if (deterministic) {
+            plate->partial[i] = sum;
+            plate->partial[plate->rows + i] = sum_sq;
+        }
+    }
+    if (deterministic) {
+        sum = sum_partials(plate->partial + 1, plate->rows - 2);
+        sum_sq = sum_partials(
+            plate->partial + plate->rows + 1, plate->rows - 2
+        );
+    }
+    change->sum = sum;
+    change->sum_sq = sum_sq;
+    change->max = max;
+    TRACE_STOP(PHASE_REDUCTION, start);
+
+    return;
+}
+
+/**
+ * @brief Times measured time steps with and without --deterministic.
+ * @details Both modes run the same number of steps of calc_temp from the
+ * initial plate with the configured kernel and threads, after one untimed
+ * run that faults the plate in and starts the threads. The
+ * deterministic mode is then repeated on 1 .. threads threads, and its
+ * changes must agree bit for bit.
+ *
+ * @param[in] config The plate size, threads and number of steps.
+ */
+void benchmark_reduction(const Config_t * config) {
+    const int steps = config->benchmark_reduction;
+    double seconds[2], sum[2], start, first = 0;
+    int threads = 1, mode, i, t, same = 1;
+    Plate_t plate;
+
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    if (create_plate(&plate, config->rows, config->cols, 2)
+        != EXIT_SUCCESS) {
+        fputs("Could not allocate the plate.\n", stderr);
+        return;
+    }
+    deterministic = 0;
+    init_plate(&plate, &config->boundary);
+    for (i = 0; i < steps; i++) {
+        stencil_step(&plate, 1);
+    }
+    for (mode = 0; mode < 2; mode++) {
+        deterministic = mode;
+        init_plate(&plate, &config->boundary);
+        start = wall_seconds();
+        for (i = 0; i < steps; i++) {
+            sum[mode] = stencil_step(&plate, 1);
+        }
+        seconds[mode] = wall_seconds() - start;
+    }
+    printf(
+        "Reduction on a %d x %d plate, %d threads, %d steps:\n"
+        "  fast:          %.3f ms per step, last change %.17g\n"
+        "  deterministic: %.3f ms per step, last change %.17g "
+        "(%+.1f%%)\n", plate.rows, plate.cols, threads, steps,
+        1e3 * seconds[0] / steps, sum[0], 1e3 * seconds[1] / steps, sum[1],
+        100 * (seconds[1] / seconds[0] - 1)
+    );
+
+#ifdef _OPENMP
+    for (t = 1; t <= threads; t++) {
+        omp_set_num_threads(t);
+        init_plate(&plate, &config->boundary);
+        for (i = 0; i < steps; i++) {
+            sum[1] = stencil_step(&plate, 1);
+        }
+        if (t == 1)
+            first = sum[1];
+        same = same && memcmp(&first, &sum[1], sizeof(double)) == 0;
+    }
+    omp_set_num_threads(threads);
+#else
+    (void) t;
+    (void) first;
+#endif
+    printf(
+        "  deterministic on 1 .. %d threads: %s\n", threads,
+        same ? "identical" : "DIFFERENT"
+    );
+    deterministic = config->deterministic;
+    destroy_plate(&plate);
+
+    return;
+}
+
+/**
+ * @brief Times the explicit time step with every placement and page size.
+ * @details For each combination a fresh two-grid plate is created and
+ * initialized, stepped once to fault everything in, and then timed over
+ * the given number of unmeasured steps. The bandwidth counts one read and
+ * one write of every interior cell per step. Explicit huge pages are
+ * skipped if none are reserved.
+ *
+ * @param[in] config The plate size, threads and number of steps.
+ */
+void benchmark_placement(const Config_t * config) {
+    static const char * placements[] = { "first-touch", "serial" };
+    static const char * pages[] = { "none", "transparent", "explicit" };
+    const int steps = config->benchmark_placement;
+    const double bytes = 2.0 * sizeof(double) *
+        (config->rows - 2) * (config->cols - 2);
+    double start, seconds;
+    int threads = 1, p, h, i;
+    Plate_t plate;
+
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    printf(
+        "Placement on a %d x %d plate, %d threads%s, %d steps:\n",
+        config->rows, config->cols, threads, config->pin ? ", pinned" : "",
+        steps
+    );
+    for (p = 0; p < 2; p++) {
+        for (h = 0; h < 3; h++) {
+            placement = (Placement_t) p;
+            huge_pages = (Huge_pages_t) h;
+            printf("  %-12s %-12s ", placements[p], pages[h]);
+            if (create_plate(&plate, config->rows, config->cols, 2)
+                != EXIT_SUCCESS) {
+                puts("not available");
+                continue;
+            }
+            init_plate(&plate, &config->boundary);
+            stencil_step(&plate, 0);
+            start = wall_seconds();
+            for (i = 0; i < steps; i++) {
+                stencil_step(&plate, 0);
+            }
+            seconds = wall_seconds() - start;
+            printf(
+                "%8.3f ms per step, %7.2f GB/s\n", 1e3 * seconds / steps,
+                1e-9 * bytes * steps / seconds
+            );
+            destroy_plate(&plate);
+        }
+    }
+    placement = config->placement;
+    huge_pages = config->huge_pages;
+
+    return;
+}
+
+/**
+ * @brief Adds the statistics of one part of a step to a running total.
+ *
+ * @param[in,out] total The running total.
+ * @param[in] part The statistics to add.
+ */
+void add_change(Change_t * total, const Change_t * part) {
+    total->sum += part->sum;
+    total->sum_sq += part->sum_sq;
+    if (part->max > total->max)
+        total->max = part->max;
+
+    return;
+}
+
+/**
+ * @brief Sets up the convergence monitor from the configuration.
+ *
+ * @param[out] monitor The monitor.
+ * @param[in] config The norm, tolerance and check interval to use.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the history could not be
+ * allocated.
+ */
+int create_monitor(Monitor_t * monitor, const Config_t * config) {
+    monitor->norm = config->norm;
+    monitor->tolerance = config->tolerance;
+    monitor->relative = config->relative;
+    monitor->interval = config->check_interval;
+    monitor->cells = (long) (config->rows - 2) * (config->cols - 2);
+    monitor->reference = 0;
+    monitor->checks = 0;
+    monitor->capacity = HISTORY_SIZE;
+    monitor->steps = malloc(sizeof(int) * HISTORY_SIZE);
+    monitor->values = malloc(sizeof(double) * HISTORY_SIZE);
+    if (monitor->steps == NULL || monitor->values == NULL) {
+        destroy_monitor(monitor);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Releases the monitor's history.
+ *
+ * @param[in,out] monitor The monitor.
+ */
+void destroy_monitor(Monitor_t * monitor) {
+    free(monitor->steps);
+    free(monitor->values);
+    monitor->steps = NULL;
+    monitor->values = NULL;
+
+    return;
+}
+
+/**
+ * @brief Reduces the change statistics of a step to the monitored norm.
+ * @details l1 is the plain sum, as the original THRESHOLD test used, and
+ * grows with the plate. l1-mean and l2 (root mean square) are divided by
+ * the number of interior cells and linf is the largest change, so those
+ * three mean the same accuracy on any plate size.
+ *
+ * @param[in] monitor The monitor, for the norm and the cell count.
+ * @param[in] change The statistics of one step.
+ *
+ * @return The norm of the change.
+ */
+double change_norm(const Monitor_t * monitor, const Change_t * change) {
+    switch (monitor->norm) {
+    case NORM_L1_MEAN:
+        return change->sum / monitor->cells;
+    case NORM_L2:
+        return sqrt(change->sum_sq / monitor->cells);
+    case NORM_LINF:
+        return change->max;
+    default:
+        return change->sum;
+    }
+}
+
+/**
+ * @brief Records a measured step and tells whether the plate converged.
+ * @details With --relative the first measured norm becomes the reference
+ * and the plate has converged once the norm is below tolerance times it.
+ *
+ * @param[in,out] monitor The monitor.
+ * @param[in] step The step that was measured.
+ * @param[in] change The statistics of that step.
+ *
+ * @return Non-zero once the norm is below the tolerance.
+ */
+int monitor_converged(Monitor_t * monitor, int step, const Change_t * change) {
+    const double value = change_norm(monitor, change);
+    double limit = monitor->tolerance;
+
+    if (monitor->checks == monitor->capacity) {
+        int * steps = realloc(
+            monitor->steps, sizeof(int) * 2 * monitor->capacity
+        );
+        double * values = realloc(
+            monitor->values, sizeof(double) * 2 * monitor->capacity
+        );
+
+        if (steps != NULL)
+            monitor->steps = steps;
+        if (values != NULL)
+            monitor->values = values;
+        if (steps != NULL && values != NULL)
+            monitor->capacity *= 2;
+    }
+    /*  Out of memory only costs the rest of the history. */
+    if (monitor->checks < monitor->capacity) {
+        monitor->steps[monitor->checks] = step;
+        monitor->values[monitor->checks] = value;
+    }
+    if (monitor->checks == 0)
+        monitor->reference = value;
+    monitor->checks++;
+
+    if (monitor->relative)
+        limit *= monitor->reference;
+
+    return value < limit;
+}
+
+/**
+ * @brief Prints the measured norm of every checked step.
+ *
+ * @param[in] monitor The monitor.
+ */
+void print_history(const Monitor_t * monitor) {
+    const char * names[] = { "l1", "l1-mean", "l2", "linf" };
+    int i;
+
+    printf("Convergence history (%s norm):\n", names[monitor->norm]);
+    for (i = 0; i < monitor->checks && i < monitor->capacity; i++) {
+        printf("%8d %.6e\n", monitor->steps[i], monitor->values[i]);
+    }
+
+    return;
+}
+
+/**
+ * @brief Saves the state of a run so it can be continued later.
+ * @details The checkpoint is written to path.tmp, flushed to the disk and
+ * then renamed to path, so a crash at any moment leaves either the old or
+ * the new checkpoint, never a partial one. The plate's current grid, the
+ * time and the convergence monitor are saved; everything else a solver
+ * keeps is rebuilt by the next step, so the continued run is bit for bit
+ * the run that was never stopped. An approximate active set (a non-zero
+ * --active-epsilon) is the exception: it restarts with every tile active.
+ *
+ * @param[in] path The checkpoint file.
+ * @param[in] plate The plate.
+ * @param[in] config The run's settings, checked again on restart.
+ * @param[in] monitor The convergence monitor.
+ * @param[in] time The time steps done so far.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the checkpoint could not be
+ * written. The previous checkpoint is then still in place.
+ */
+int save_checkpoint(
+    const char * path, const Plate_t * plate, const Config_t * config,
+    const Monitor_t * monitor, int time
+) {
+    const double * data = plate_data(plate);
+    Checkpoint_header_t header;
+    char * temp;
+    FILE * file;
+    int i, checks, ok;
+
+    temp = malloc(strlen(path) + sizeof(".tmp"));
+    if (temp == NULL)
+        return EXIT_FAILURE;
+    strcpy(temp, path);
+    strcat(temp, ".tmp");
+    file = fopen(temp, "wb");
+    if (file == NULL) {
+        free(temp);
+        return EXIT_FAILURE;
+    }
+
+    /*  Steps the history had no room for are not saved either. */
+    checks = monitor->checks < monitor->capacity ?
+        monitor->checks : monitor->capacity;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.rows = plate->rows;
+    header.cols = plate->cols;
+    header.solver = config->solver;
+    header.norm = config->norm;
+    header.precision = config->precision;
+    header.time = time;
+    header.checks = checks;
+    header.reference = monitor->reference;
+    header.boundary = config->boundary;
+    ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(monitor->steps, sizeof(int), checks, file)
+            == (size_t) checks &&
+        fwrite(monitor->values, sizeof(double), checks, file)
+            == (size_t) checks;
+    for (i = 0; ok && i < plate->rows; i++) {
+        ok = fwrite(
+            data + (size_t) i * plate->pitch, sizeof(double), plate->cols,
+            file
+        ) == (size_t) plate->cols;
+    }
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && rename(temp, path) == 0;
+    if (!ok)
+        remove(temp);
+    free(temp);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Restores a run saved by save_checkpoint.
+ * @details The plate and the monitor must already be set up for the same
+ * plate size, solver, norm, precision and temperatures (--temps) as the
+ * saved run. Every grid of the plate
+ * gets the saved cells.
+ *
+ * @param[in] path The checkpoint file.
+ * @param[in,out] plate The plate to fill.
+ * @param[in] config The settings of the continued run.
+ * @param[in,out] monitor The convergence monitor to restore.
+ * @param[out] time The time steps the saved run had done.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or was
+ * saved by a different run.
+ */
+int load_checkpoint(
+    const char * path, Plate_t * plate, const Config_t * config,
+    Monitor_t * monitor, int * time
+) {
+    Checkpoint_header_t header;
+    FILE * file;
+    int i, g, ok;
+
+    file = fopen(path, "rb");
+    if (file == NULL)
+        return EXIT_FAILURE;
+    ok = fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == CHECKPOINT_VERSION &&
+        header.rows == plate->rows && header.cols == plate->cols &&
+        header.solver == (int) config->solver &&
+        header.norm == (int) config->norm &&
+        header.precision == (int) config->precision &&
+        same_boundary(&header.boundary, &config->boundary) &&
+        header.time >= 0 && header.checks >= 0;
+    if (ok && header.checks > monitor->capacity) {
+        int * steps = realloc(monitor->steps, sizeof(int) * header.checks);
+        double * values = NULL;
+
+        if (steps != NULL) {
+            monitor->steps = steps;
+            values = realloc(monitor->values, sizeof(double) * header.checks);
+        }
+        if (values != NULL) {
+            monitor->values = values;
+            monitor->capacity = header.checks;
+        }
+        ok = values != NULL;
+    }
+    ok = ok &&
+        fread(monitor->steps, sizeof(int), header.checks, file)
+            == (size_t) header.checks &&
+        fread(monitor->values, sizeof(double), header.checks, file)
+            == (size_t) header.checks;
+    for (i = 0; ok && i < plate->rows; i++) {
+        ok = fread(
+            plate->grid[0] + (size_t) i * plate->pitch,
+            sizeof(double), plate->cols, file
+        ) == (size_t) plate->cols;
+    }
+    fclose(file);
+    if (!ok)
+        return EXIT_FAILURE;
+
+    plate->current = 0;
+    for (g = 1; g < plate->grids; g++) {
+        memcpy(
+            plate->grid[g] - PLATE_LEAD, plate->grid[0] - PLATE_LEAD,
+            sizeof(double) * plate->pitch * plate->rows
+        );
+    }
+    monitor->checks = header.checks;
+    monitor->reference = header.reference;
+    *time = header.time;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Tells whether two sets of temperatures are the same.
+ *
+ * @param[in] a The first set.
+ * @param[in] b The second set.
+ *
+ * @return Non-zero if every temperature is equal.
+ */
+int same_boundary(const Boundary_t * a, const Boundary_t * b) {
+    return a->top == b->top && a->bottom == b->bottom &&
+        a->left == b->left && a->right == b->right &&
+        a->inner == b->inner && a->front == b->front && a->back == b->back;
+}
+
+/**
+ * @brief One in-place successive over-relaxation sweep towards the steady
+ * state.
+ * @details At the steady state of calc_temp a cell equals the mean of its
+ * eight neighbours. SOR moves each cell omega times the way to that mean,
+ * using neighbours already updated in the same sweep. The 9-point stencil
+ * couples diagonal cells, so a red-black split would put neighbours in
+ * the same colour; instead the cells are split by row and column parity
+ * into four colours. No cell has a neighbour of its own colour, so the
+ * rows of one colour are updated in parallel and only one grid is needed.
+ *
+ * @param[in,out] plate The plate, updated in place.
+ * @param[in] omega The relaxation factor, 0 < omega < 2.
+ *
+ * @return The change statistics of the sweep.
+ */
+Change_t sor_sweep(Plate_t * plate, double omega) {
+    return relax_grid(
+        plate_data(plate), NULL, plate->pitch, plate->rows, plate->cols,
+        omega, plate->partial
+    );
+}
+
+/**
+ * @brief Four-colour relaxation of 8 u - (sum of the 8 neighbours) = f.
+ * @details Each interior cell moves omega of the way to (f + neighbour
+ * sum) / 8, one colour after the other as in sor_sweep. The edge cells are
+ * never changed.
+ *
+ * @param[in,out] u The grid, updated in place.
+ * @param[in] f The right hand side, or NULL for zero.
+ * @param[in] pitch Distance between rows of u and f.
+ * @param[in] rows Number of rows, edges included.
+ * @param[in] cols Number of columns, edges included.
+ * @param[in] omega The relaxation factor, 0 < omega < 2.
+ * @param[out] partial Room for 2 * rows per-row sums for --deterministic.
+ *
+ * @return The change statistics of the sweep. Every cell is changed once
+ * per sweep, so they describe the net change.
+ */
+Change_t relax_grid(
+    double * u, const double * f, size_t pitch, int rows, int cols,
+    double omega, double * partial
+) {
+    Change_t result;
+    double delta_temp = 0, sum_sq = 0, max = 0;
+    int colour, i;
+
+    if (deterministic)
+        memset(partial, 0, sizeof(double) * 2 * rows);
+    for (colour = 0; colour < 4; colour++) {
+        #pragma omp parallel for schedule(static) \
+            reduction(+:delta_temp, sum_sq) reduction(max:max)
+        for (i = 1 + colour / 2; i < rows - 1; i += 2) {
+            const double * up = u + (i - 1) * pitch;
+            double * mid = u + i * pitch;
+            const double * down = u + (i + 1) * pitch;
+            const double * rhs = f == NULL ? NULL : f + i * pitch;
+            double change;
+            int j;
+
+            /*  Each row apart for --deterministic, see measure_change. */
+            if (deterministic)
+                delta_temp = sum_sq = 0;
+            for (j = 1 + colour % 2; j < cols - 1; j += 2) {
+                change = omega * ((
+                    (rhs == NULL ? 0 : rhs[j]) +
+                    up[j-1] + up[j] + up[j+1] +
+                    mid[j-1] + mid[j+1] +
+                    down[j-1] + down[j] + down[j+1]
+                ) / 8 - mid[j]);
+                mid[j] += change;
+                change = fabs(change);
+                delta_temp += change;
+                sum_sq += change * change;
+                if (change > max)
+                    max = change;
+            }
+            if (deterministic) {
+                partial[i] += delta_temp;
+                partial[rows + i] += sum_sq;
+            }
+        }
+    }
+    if (deterministic) {
+        delta_temp = sum_partials(partial + 1, rows - 2);
+        sum_sq = sum_partials(partial + rows + 1, rows - 2);
+    }
+    result.sum = delta_temp;
+    result.sum_sq = sum_sq;
+    result.max = max;
+
+    return result;
+}
+
+/**
+ * @brief Runs one multigrid V-cycle on the plate and measures the result.
+ * @details The steady state of calc_temp solves A u = 0 with
+ * (A u)(i, j) = 8 u(i, j) - (sum of the 8 neighbours) and the plate's edges,
+ * averaged corners included, as Dirichlet values. Those edge values stay
+ * fixed in the finest grid, so the coarse grids only ever see the error,
+ * whose edges are zero.
+ *
+ * @param[in,out] workspace The hierarchy from create_workspace; the
+ * residual 2-norm of the plate after the cycle is left in
+ * workspace->residual.
+ *
+ * @return The change statistics of the cycle, added up over its sweeps
+ * and its correction. That bounds the net change of the cycle from above.
+ */
+Change_t multigrid_cycle(Workspace_t * workspace) {
+    Change_t change;
+
+    change = v_cycle(workspace, 0);
+    compute_residual(&workspace->level[0]);
+    workspace->residual = residual_norm(&workspace->level[0]);
+
+    return change;
+}
+
+/**
+ * @brief Recursive V-cycle from one level of the hierarchy down.
+ * @details Pre-smooths with four-colour Gauss-Seidel on the 9-point
+ * weights, moves the residual to the next coarser level, solves there
+ * for the error, adds the interpolated error back and post-smooths. The
+ * coarsest level is relaxed with SOR until it stops changing.
+ *
+ * @param[in,out] workspace The multigrid hierarchy.
+ * @param[in] index The level to work on, 0 being the plate.
+ *
+ * @return The change statistics of this level's u, added up.
+ */
+Change_t v_cycle(Workspace_t * workspace, int index) {
+    Mg_level_t * level = &workspace->level[index];
+    Mg_level_t * coarse;
+    Change_t total = { 0, 0, 0 }, change;
+    double first_change = 0;
+    int i;
+
+    if (index == workspace->levels - 1) {
+        const double omega = estimate_omega(level->rows, level->cols);
+
+        for (i = 0; i < 10000; i++) {
+            change = relax_grid(
+                level->u, level->f, level->pitch, level->rows, level->cols,
+                omega, level->partial
+            );
+            add_change(&total, &change);
+            if (i == 0)
+                first_change = change.sum;
+            if (change.sum <= 1e-12 * first_change)
+                break;
+        }
+        return total;
+    }
+
+    for (i = 0; i < MG_PRE_SWEEPS; i++) {
+        change = relax_grid(
+            level->u, level->f, level->pitch, level->rows, level->cols, 1.0,
+            level->partial
+        );
+        add_change(&total, &change);
+    }
+    compute_residual(level);
+    coarse = &workspace->level[index + 1];
+    restrict_residual(level, coarse);
+    memset(coarse->u, 0, sizeof(double) * coarse->pitch * coarse->rows);
+    v_cycle(workspace, index + 1);
+    change = prolong_correction(coarse, level);
+    add_change(&total, &change);
+    for (i = 0; i < MG_POST_SWEEPS; i++) {
+        change = relax_grid(
+            level->u, level->f, level->pitch, level->rows, level->cols, 1.0,
+            level->partial
+        );
+        add_change(&total, &change);
+    }
+
+    return total;
+}
+
+/**
+ * @brief Computes r = f - A u on the interior of a level.
+ *
+ * @param[in,out] level The level; its r is written.
+ */
+void compute_residual(Mg_level_t * level) {
+    const size_t pitch = level->pitch;
+    int i;
+
+    #pragma omp parallel for schedule(static)
+    for (i = 1; i < level->rows - 1; i++) {
+        const double * up = level->u + (i - 1) * pitch;
+        const double * mid = level->u + i * pitch;
+        const double * down = level->u + (i + 1) * pitch;
+        double * r = level->r + i * pitch;
+        int j;
+
+        for (j = 1; j < level->cols - 1; j++) {
+            r[j] = (level->f == NULL ? 0 : level->f[i * pitch + j]) - (
+                8 * mid[j] - (
+                    up[j-1] + up[j] + up[j+1] +
+                    mid[j-1] + mid[j+1] +
+                    down[j-1] + down[j] + down[j+1]
+                )
+            );
+        }
+    }
+
+    return;
+}
+
+/**
+ * @brief Full-weighting restriction of a residual to the coarser level.
+ * @details Coarse cell (I, J) lies on fine cell (2I, 2J) and takes the
+ * 1/4, 1/2, 1/4 weighted average in each direction. The stencil has no
+ * mesh-size factor, and A on a grid twice as coarse is about four times
+ * weaker for the same error, so the average is multiplied by 4.
+ *
+ * @param[in] fine The level whose residual is restricted.
+ * @param[out] coarse The level whose f receives it.
+ */
+void restrict_residual(const Mg_level_t * fine, Mg_level_t * coarse) {
+    const double weight[3] = { 0.25, 0.5, 0.25 };
+    const size_t pitch = fine->pitch;
+    int i;
+
+    #pragma omp parallel for schedule(static)
+    for (i = 1; i < coarse->rows - 1; i++) {
+        int j, a, b;
+
+        for (j = 1; j < coarse->cols - 1; j++) {
+            double sum = 0;
+
+            for (a = -1; a <= 1; a++) {
+                const double * r = fine->r + (2 * i + a) * pitch + 2 * j;
+
+                for (b = -1; b <= 1; b++) {
+                    sum += weight[a+1] * weight[b+1] * r[b];
+                }
+            }
+            coarse->f[i * coarse->pitch + j] = 4 * sum;
+        }
+    }
 
-#define ROWS 10
-#define COLS 20
+    return;
+}
 
-#define TEMP_TOP 2.0
-#define TEMP_BOTTOM 3.0
-#define TEMP_LEFT 4.0
-#define TEMP_RIGHT -5.0
-#define TEMP_INNER 1.0
+/**
+ * @brief Adds the bilinear interpolation of the coarse error to a level.
+ * @details A fine cell on an even row and column takes its coarse cell;
+ * the others average the two or four coarse cells around them. Coarse
+ * edge cells hold zero error.
+ *
+ * @param[in] coarse The level holding the error in u.
+ * @param[in,out] fine The level whose u is corrected.
+ *
+ * @return The change statistics of the correction.
+ */
+Change_t prolong_correction(const Mg_level_t * coarse, Mg_level_t * fine) {
+    const size_t pitch = coarse->pitch;
+    Change_t result;
+    double delta_temp = 0, sum_sq = 0, max = 0;
+    int i;
 
-#define HEAT_LEVELS 10
-#define THRESHOLD 1.0
+    #pragma omp parallel for schedule(static) \
+        reduction(+:delta_temp, sum_sq) reduction(max:max)
+    for (i = 1; i < fine->rows - 1; i++) {
+        const double * top = coarse->u + (i / 2) * pitch;
+        const double * bottom = coarse->u + ((i + 1) / 2) * pitch;
+        double * u = fine->u + i * fine->pitch;
+        double correction;
+        int j;
 
-void init_plate(double plate[ROWS][COLS]);
-void init_row_plate(
-    double plate[ROWS][COLS], int row_index, 
-    double left_edge_temp, double inner_temp, double right_edge_temp
-);
-double calc_temp(double plate[ROWS][COLS]);
-void copy_plate(
-    const double plate[ROWS][COLS], double copied_plate[ROWS][COLS]
-);
-void normalize_plate(
-    const double plate[ROWS][COLS], int norm_plate[ROWS][COLS]
-);
-void find_min_and_max(
-    const double plate[ROWS][COLS], double * max, double * min
-);
-void create_histogram(
-    const int norm_plate[ROWS][COLS], int histogram[HEAT_LEVELS]
-);
-void print_plate(const double plate[ROWS][COLS], int time);
-void print_norm_plate(const int norm_plate[ROWS][COLS]);
-void print_histogram(const int histogram[HEAT_LEVELS]);
-int get_user_timestep(void);
+        /*  Each row apart for --deterministic, see measure_change. */
+        if (deterministic)
+            delta_temp = sum_sq = 0;
+        for (j = 1; j < fine->cols - 1; j++) {
+            const int left = j / 2, right = (j + 1) / 2;
 
+            correction = 0.25 * (
+                top[left] + top[right] + bottom[left] + bottom[right]
+            );
+            u[j] += correction;
+            correction = fabs(correction);
+            delta_temp += correction;
+            sum_sq += correction * correction;
+            if (correction > max)
+                max = correction;
+        }
+        if (deterministic) {
+            fine->partial[i] = delta_temp;
+            fine->partial[fine->rows + i] = sum_sq;
+        }
+    }
+    if (deterministic) {
+        delta_temp = sum_partials(fine->partial + 1, fine->rows - 2);
+        sum_sq = sum_partials(fine->partial + fine->rows + 1, fine->rows - 2);
+    }
+    result.sum = delta_temp;
+    result.sum_sq = sum_sq;
+    result.max = max;
 
-int main(void) {
-    double plate_temp[ROWS][COLS];
-    int norm_plate_temp[ROWS][COLS];
-    int histogram[HEAT_LEVELS];
-    double delta_temp;
-    int time_print, time = 0;
+    return result;
+}
 
-    init_plate(plate_temp);
-    time_print = get_user_timestep();
-    do {
-        time++;
-        delta_temp = calc_temp(plate_temp);
-        if (time_print == time) {
-            print_plate(plate_temp, time);
-            normalize_plate(plate_temp, norm_plate_temp);
-            print_norm_plate(norm_plate_temp);
-            create_histogram(norm_plate_temp, histogram);
-            print_histogram(histogram);
-        }
-    } while (delta_temp >= THRESHOLD) ;
-    puts("Final State.");
-    print_plate(plate_temp, time);
+/**
+ * @brief Returns the 2-norm of a level's residual.
+ *
+ * @param[in] level The level, after compute_residual.
+ *
+ * @return The square root of the sum of the squared interior residuals.
+ */
+double residual_norm(const Mg_level_t * level) {
+    double sum = 0;
+    int i;
 
-    return EXIT_SUCCESS;
+    #pragma omp parallel for schedule(static) reduction(+:sum)
+    for (i = 1; i < level->rows - 1; i++) {
+        const double * r = level->r + i * level->pitch;
+        int j;
+
+        /*  Each row apart for --deterministic, see measure_change. */
+        if (deterministic)
+            sum = 0;
+        for (j = 1; j < level->cols - 1; j++) {
+            sum += r[j] * r[j];
+        }
+        if (deterministic)
+            level->partial[i] = sum;
+    }
+    if (deterministic)
+        sum = sum_partials(level->partial + 1, level->rows - 2);
+
+    return sqrt(sum);
 }
 
 /**
- * @brief Initializes the entire plate with boundary and inner temperatures.
- * @details Sets the edge temperatures and calculates corner temperatures as the
- * average of adjacent edges. The inner part of the plate is set to a
- * default temperature.
- * 
- * @param[out] plate The 2D array representing the plate to be initialized.
- */
-void init_plate(double plate[ROWS][COLS]) {
-    /* Calculate corner temperatures as the average of adjacent edges. */
-    double top_left_edge = (TEMP_LEFT + TEMP_TOP) / 2;
-    double top_right_edge = (TEMP_RIGHT + TEMP_TOP) / 2;
-    double bottom_left_edge = (TEMP_LEFT + TEMP_BOTTOM) / 2;
-    double bottom_right_edge = (TEMP_RIGHT + TEMP_BOTTOM) / 2;
+ * @brief Solves for the steady state of the plate in one shot.
+ * @details The steady state solves 9 u - (I + X)(I + Y) u = b on the
+ * interior, where X and Y add the left and right, and the up and down
+ * neighbours, and b collects the fixed edge cells (corners included)
+ * next to each interior cell. With zero edges the sine vectors
+ * sin(pi k j / (n + 1)) diagonalise X and Y, with eigenvalues 2 cos(pi k /
+ * (n + 1)). So b goes through a 2D sine transform, is divided by
+ * 9 - (1 + 2 cos a)(1 + 2 cos b) and goes back through the same
+ * transform. That is O(N log N) work for N cells.
+ *
+ * @param[in,out] plate The plate; its interior is overwritten with the
+ * steady state.
+ * @param[in] workspace Holds the transform plans and their buffers.
+ */
+void solve_direct(Plate_t * plate, Workspace_t * workspace) {
+    const double pi = 3.14159265358979323846;
+    const size_t pitch = plate->pitch;
+    const int ny = plate->rows - 2, nx = plate->cols - 2;
+    double * data = plate_data(plate);
     int i;
 
-    /*  There is a minor performance overhead from function calls.
-        This for loop is small so we don't care but usually, in HPC you 
-        avoid function calls inside large loops, this way you sacrifice 
-        clarity for efficiency. */
-    for (i = 0; i < ROWS; i++) {
-        if (i == 0)
-            init_row_plate(
-                plate, i, top_left_edge, TEMP_TOP, top_right_edge
-            );
-        else if (i == ROWS - 1)
-            init_row_plate(
-                plate, i, bottom_left_edge, TEMP_BOTTOM, bottom_right_edge
-            );
-        else
-            init_row_plate(
-                plate, i, TEMP_LEFT, TEMP_INNER, TEMP_RIGHT
+    /*  Right hand side: the edge cells around each interior cell. */
+    #pragma omp parallel for schedule(static)
+    for (i = 1; i <= ny; i++) {
+        int j, a, b;
+
+        for (j = 1; j <= nx; j++) {
+            double sum = 0;
+
+            for (a = -1; a <= 1; a++) {
+                for (b = -1; b <= 1; b++) {
+                    const int r = i + a, c = j + b;
+
+                    if (r == 0 || r == ny + 1 || c == 0 || c == nx + 1)
+                        sum += data[r * pitch + c];
+                }
+            }
+            data[i * pitch + j] = sum;
+        }
+    }
+
+#ifdef PLATE_USE_FFTW
+    {
+        double * buffer = workspace->fftw_buffer;
+        fftw_plan plan = workspace->fftw;
+
+        for (i = 0; i < ny; i++)
+            memcpy(
+                buffer + i * nx, data + (i + 1) * pitch + 1,
+                sizeof(double) * nx
             );
+        fftw_execute(plan);
+        for (i = 0; i < ny; i++) {
+            const double cos_b = cos(pi * (i + 1) / (ny + 1));
+            int j;
+
+            for (j = 0; j < nx; j++) {
+                buffer[i * nx + j] /= 9 - (1 + 2 * cos(pi * (j + 1) / (nx + 1)))
+                    * (1 + 2 * cos_b);
+            }
+        }
+        fftw_execute(plan);
+        for (i = 0; i < ny; i++) {
+            int j;
+
+            for (j = 0; j < nx; j++) {
+                data[(i + 1) * pitch + 1 + j] =
+                    buffer[i * nx + j] / (4.0 * (nx + 1) * (ny + 1));
+            }
+        }
+    }
+#else
+    {
+        const Dst_plan_t * row_plan = &workspace->dst_row;
+        const Dst_plan_t * col_plan = &workspace->dst_col;
+        const int work_size = row_plan->fft_size > col_plan->fft_size ?
+            row_plan->fft_size : col_plan->fft_size;
+        int pass;
+
+        for (pass = 0; pass < 2; pass++) {
+            #pragma omp parallel num_threads(workspace->dst_threads)
+            {
+                double complex * work = workspace->dst_work;
+                int r, c;
+
+#ifdef _OPENMP
+                work += (size_t) 2 * work_size * omp_get_thread_num();
+#endif
+
+                #pragma omp for schedule(static)
+                for (r = 1; r <= ny; r++)
+                    dst_transform(row_plan, data + r * pitch + 1, 1, work);
+                #pragma omp for schedule(static)
+                for (c = 1; c <= nx; c++)
+                    dst_transform(col_plan, data + pitch + c, pitch, work);
+            }
+            if (pass == 1)
+                break;
+            #pragma omp parallel for schedule(static)
+            for (i = 1; i <= ny; i++) {
+                const double cos_b = cos(pi * i / (ny + 1));
+                double * row = data + i * pitch;
+                int j;
+
+                for (j = 1; j <= nx; j++) {
+                    row[j] /= (9 - (1 + 2 * cos(pi * j / (nx + 1))) *
+                        (1 + 2 * cos_b)) * (4.0 * (nx + 1) * (ny + 1));
+                }
+            }
+        }
     }
+#endif
 
     return;
 }
 
 /**
- * @brief Initializes a single row of the plate with specified temperatures.
- * 
- * @param[out] plate The 2D array representing the plate.
- * @param[in] row_index The index of the row to initialize.
- * @param[in] left_edge_temp The temperature for the leftmost cell of the row.
- * @param[in] inner_temp The temperature for the inner cells of the row.
- * @param[in] right_edge_temp The temperature for the rightmost cell of the row.
- */
-void init_row_plate(
-    double plate[ROWS][COLS],
-    int row_index,
-    double left_edge_temp,
-    double inner_temp,
-    double right_edge_temp
-) {
-    int i;
+ * @brief Prepares a DST-I of length n.
+ * @details Precomputes the FFT roots of unity and, for lengths that are
+ * not a power of two, Bluestein's chirp and the transform of its
+ * convolution kernel.
+ *
+ * @param[out] plan The plan to set up.
+ * @param[in] n The transform length.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if an allocation failed.
+ */
+int create_dst_plan(Dst_plan_t * plan, int n) {
+    const double pi = 3.14159265358979323846;
+    int k, size = 2 * (n + 1), fft_size = 1;
 
-    plate[row_index][0] = left_edge_temp;
-    for (i = 1; i < COLS - 1; i++) {
-        plate[row_index][i] = inner_temp;
+    while (fft_size < size)
+        fft_size *= 2;
+    if (fft_size != size) {
+        fft_size = 1;
+        while (fft_size < 2 * size - 1)
+            fft_size *= 2;
     }
-    plate[row_index][COLS-1] = right_edge_temp;
+
+    plan->n = n;
+    plan->size = size;
+    plan->fft_size = fft_size;
+    plan->chirp = plan->kernel = NULL;
+    plan->roots = malloc(sizeof(double complex) * (fft_size / 2));
+    if (plan->roots == NULL)
+        return EXIT_FAILURE;
+    for (k = 0; k < fft_size / 2; k++) {
+        plan->roots[k] = cexp(-2 * pi * I * k / fft_size);
+    }
+    if (fft_size == size)
+        return EXIT_SUCCESS;
+
+    plan->chirp = malloc(sizeof(double complex) * size);
+    plan->kernel = calloc(fft_size, sizeof(double complex));
+    if (plan->chirp == NULL || plan->kernel == NULL) {
+        destroy_dst_plan(plan);
+        return EXIT_FAILURE;
+    }
+    for (k = 0; k < size; k++) {
+        /*  k * k mod 2 size keeps the angle small and exact. */
+        const long square = (long) k * k % (2 * size);
+
+        plan->chirp[k] = cexp(-pi * I * square / size);
+        plan->kernel[k] = conj(plan->chirp[k]);
+        if (k > 0)
+            plan->kernel[fft_size - k] = plan->kernel[k];
+    }
+    fft_radix2(plan->kernel, fft_size, plan->roots);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Releases what create_dst_plan allocated.
+ *
+ * @param[in,out] plan The plan to release.
+ */
+void destroy_dst_plan(Dst_plan_t * plan) {
+    free(plan->roots);
+    free(plan->chirp);
+    free(plan->kernel);
+    plan->roots = plan->chirp = plan->kernel = NULL;
 
     return;
 }
 
 /**
- * @brief Calculates one time step of the heat diffusion.
- * @details Updates each inner cell's temperature based on the average of 
- * its neighbors from the previous timestep (t-1).
- * 
- * * @param[in,out] plate The 2D array representing the plate, which will be
- * updated to the next time step (t).
- * 
- * @return The total absolute change in temperature across the plate during
- * this time step.
+ * @brief In-place DST-I, y(k) = 2 sum x(j) sin(pi (j + 1)(k + 1) / (n + 1)).
+ * @details This is FFTW's RODFT00, so applying it twice multiplies by
+ * 2 (n + 1). The odd extension of x is transformed and y is minus the
+ * imaginary part of its FFT.
+ *
+ * @param[in] plan The plan for the length of x.
+ * @param[in,out] x The n values, stride apart.
+ * @param[in] stride Distance between consecutive values of x.
+ * @param[out] work Room for 2 * plan->fft_size complex values.
  */
-double calc_temp(double plate[ROWS][COLS]) {
-    double tmp_plate[ROWS][COLS];
-    double delta_temp = 0;
-    int i, j;
+void dst_transform(
+    const Dst_plan_t * plan, double * x, size_t stride,
+    double complex * work
+) {
+    const int n = plan->n, size = plan->size;
+    double complex * y = work, * conv = work + plan->fft_size;
+    int k;
 
-    /*  Copies the plate temperatures in another array in order to 
-        create an array that holds the (t-1) values of the plate.  */
-    copy_plate(plate, tmp_plate);
-    /*  Calculates the temperature for the current state (t).  */
-    for (i = 1; i < ROWS - 1; i++) {
-        for (j = 1; j < COLS - 1; j++) {
-            plate[i][j] = 0.1 * (
-                tmp_plate[i-1][j-1] +
-                tmp_plate[i-1][j] +
-                tmp_plate[i-1][j+1] +
-                tmp_plate[i][j-1] +
-                2 * tmp_plate[i][j] +
-                tmp_plate[i][j+1] +
-                tmp_plate[i+1][j-1] +
-                tmp_plate[i+1][j] +
-                tmp_plate[i+1][j+1]
-            ) ;
+    y[0] = y[n + 1] = 0;
+    for (k = 0; k < n; k++) {
+        y[k + 1] = x[k * stride];
+        y[size - 1 - k] = -x[k * stride];
+    }
 
-            delta_temp += fabs(plate[i][j] - tmp_plate[i][j]);
+    if (plan->fft_size == size) {
+        fft_radix2(y, size, plan->roots);
+    } else {
+        /*  Bluestein: Y(k) = chirp(k) * (a conv conj(chirp))(k) with
+            a(j) = y(j) chirp(j). The inverse FFT is done by conjugating
+            around a forward one. */
+        for (k = 0; k < plan->fft_size; k++) {
+            conv[k] = k < size ? y[k] * plan->chirp[k] : 0;
+        }
+        fft_radix2(conv, plan->fft_size, plan->roots);
+        for (k = 0; k < plan->fft_size; k++) {
+            conv[k] = conj(conv[k] * plan->kernel[k]);
+        }
+        fft_radix2(conv, plan->fft_size, plan->roots);
+        for (k = 0; k < size; k++) {
+            y[k] = plan->chirp[k] * conj(conv[k]) / plan->fft_size;
         }
     }
 
-    return delta_temp;
+    for (k = 0; k < n; k++) {
+        x[k * stride] = -cimag(y[k + 1]);
+    }
+
+    return;
 }
 
 /**
- * @brief Copies the values of one plate to another using memcpy for efficiency.
- * @details This function performs a bulk memory copy of the entire 2D array.
- * As a 2D array in C is stored in a contiguous block of memory, a single
- * memcpy call is a highly efficient way to duplicate its contents.
- * 
- * @param[in] plate The source 2D array containing the temperature data.
- * @param[out] copied_plate The destination 2D array where the data will 
- * be copied.
+ * @brief In-place iterative radix-2 forward FFT.
+ *
+ * @param[in,out] a The n complex values.
+ * @param[in] n The length, a power of two.
+ * @param[in] roots exp(-2 pi i k / n) for k < n / 2.
  */
-void copy_plate(
-    const double plate[ROWS][COLS],
-    double copied_plate[ROWS][COLS]
-) {
-    memcpy(copied_plate, plate, sizeof(double) * ROWS * COLS);
+void fft_radix2(double complex * a, int n, const double complex * roots) {
+    double complex t;
+    int i, j, k, len, bit;
+
+    for (i = 1, j = 0; i < n; i++) {
+        for (bit = n >> 1; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+    }
+    for (len = 2; len <= n; len <<= 1) {
+        for (i = 0; i < n; i += len) {
+            for (k = 0; k < len / 2; k++) {
+                t = roots[k * (n / len)] * a[i + k + len / 2];
+                a[i + k + len / 2] = a[i + k] - t;
+                a[i + k] += t;
+            }
+        }
+    }
 
     return;
 }
 
 /**
- * @brief Normalizes the temperature plate to discrete integer levels (0-9).
- * @details Finds the min and max temperatures on the plate and scales all 
- * values linearly to fit within the defined number of HEAT_LEVELS.
- * 
- * @param[in] plate The 2D array of double-precision temperatures.
- * @param[out] norm_plate The 2D array of integers to store the normalized levels.
+ * @brief Estimates the best SOR relaxation factor for a plate size.
+ * @details Uses the classic 2 / (1 + sqrt(1 - rho^2)), where rho is the
+ * spectral radius of the Jacobi iteration of the 9-point mean. Its
+ * eigenvalues are ((1 + 2 cos a)(1 + 2 cos b) - 1) / 8 for the lowest
+ * sine modes a = pi / (cols - 1), b = pi / (rows - 1). The formula is exact
+ * for consistently ordered matrices only, so this is an estimate.
+ *
+ * @param[in] rows Number of plate rows, edges included.
+ * @param[in] cols Number of plate columns, edges included.
+ *
+ * @return The estimated relaxation factor.
+ */
+double estimate_omega(int rows, int cols) {
+    const double pi = 3.14159265358979323846;
+    double rho;
+
+    rho = ((1 + 2 * cos(pi / (cols - 1))) * (1 + 2 * cos(pi / (rows - 1)))
+        - 1) / 8;
+
+    return 2 / (1 + sqrt(1 - rho * rho));
+}
+
+/**
+ * @brief Fused analytics stage: range, heat levels and histogram.
+ * @details Two passes over the plate instead of three. The first finds
+ * the temperature range, the second quantizes every cell and counts it.
+ * The integer grid is only written if norm_plate is given.
+ *
+ * @param[in] plate The plate of double-precision temperatures.
+ * @param[in] bins The number of heat levels.
+ * @param[out] histogram bins counters, the number of cells at each level.
+ * @param[out] norm_plate A rows * cols array for the heat levels, stored
+ * row by row without padding, or NULL if it is not needed.
  */
-void normalize_plate(
-    const double plate[ROWS][COLS], int norm_plate[ROWS][COLS]
+void analyze_plate(
+    const Plate_t * plate, int bins, long * histogram, int * norm_plate
 ) {
-    double max_temp, min_temp, temp_range;
-    int i, j, heat_level;
+    double max_temp, min_temp;
 
     find_min_and_max(plate, &max_temp, &min_temp);
-    temp_range = max_temp - min_temp;
-
-    for (i = 0; i < ROWS; i++) {
-        for(j = 0; j < COLS; j++) {
-            /*  In case every temperature in the plate is the same, 
-                we don't have to do any calculations. */
-            if (temp_range == 0) {
-                norm_plate[i][j] = 0;
-                continue;
-            }
+    create_histogram(
+        plate, min_temp, max_temp, bins, histogram, norm_plate
+    );
 
-            heat_level = (int) (
-                ((plate[i][j] - min_temp) / temp_range) * HEAT_LEVELS
-            );
+    return;
+}
 
-            if (heat_level >= HEAT_LEVELS) {
-                heat_level = HEAT_LEVELS - 1;
-            }
+/**
+ * @brief Normalizes the temperature plate to discrete integer levels.
+ * @details Finds the min and max temperatures on the plate and scales all 
+ * values linearly to fit within bins levels, 0 to bins - 1.
+ * 
+ * @param[in] plate The plate of double-precision temperatures.
+ * @param[in] bins The number of heat levels.
+ * @param[out] norm_plate A rows * cols array of integers, stored row by row
+ * without padding, to store the normalized levels.
+ */
+void normalize_plate(const Plate_t * plate, int bins, int * norm_plate) {
+    double max_temp, min_temp;
 
-            norm_plate[i][j] = heat_level;
-        }
-    }
+    find_min_and_max(plate, &max_temp, &min_temp);
+    create_histogram(plate, min_temp, max_temp, bins, NULL, norm_plate);
 
     return;
 }
 
 /**
  * @brief Finds the minimum and maximum temperature values on the plate.
+ * @details One pass: the rows are shared between the threads and every
+ * row is scanned with SIMD min and max reductions.
  * 
- * @param[in] plate The 2D array of temperatures to search through.
+ * @param[in] plate The plate to search through.
  * @param[out] max Pointer to a double where the maximum temperature will be
  * stored.
  * @param[out] min Pointer to a double where the minimum temperature will be
  * stored.
  */
-void find_min_and_max(
-    const double plate[ROWS][COLS], double * max, double * min
-) {
-    int i, j;
+void find_min_and_max(const Plate_t * plate, double * max, double * min) {
+    const double * data = plate_data(plate);
+    double lo = data[0], hi = data[0];
+    int i;
+    TRACE_START(start);
 
-    *min = *max = plate[0][0];
-    for (i = 0; i < ROWS; i++) {
-        for (j = 0; j < COLS; j++) {
-            if (*max < plate[i][j])
-                *max = plate[i][j];
-            else if (*min > plate[i][j])
-                *min = plate[i][j];
+    #pragma omp parallel for schedule(static) reduction(min:lo) reduction(max:hi)
+    for (i = 0; i < plate->rows; i++) {
+        const double * row = data + (size_t) i * plate->pitch;
+        int j;
+
+        #pragma omp simd reduction(min:lo) reduction(max:hi)
+        for (j = 0; j < plate->cols; j++) {
+            lo = row[j] < lo ? row[j] : lo;
+            hi = row[j] > hi ? row[j] : hi;
         }
     }
+    *min = lo;
+    *max = hi;
+    TRACE_STOP(PHASE_NORMALIZE, start);
 
     return;
 }
 
 
 /**
- * @brief Creates a histogram from the normalized plate data.
- * @details Counts the number of cells at each discrete heat level and stores
- * the counts in the histogram array.
+ * @brief Quantizes the plate into heat levels and counts each level.
+ * @details A cell's level is (t - min) / (max - min) * bins, rounded down
+ * and capped at bins - 1; with max == min every cell is level 0. Each
+ * thread counts into its own bins, which are added up at the end, so the
+ * counting needs no atomics.
  * 
- * @param[in] norm_plate The 2D array containing normalized heat levels (0-9).
- * @param[out] histogram An array to store the frequency of each heat level.
+ * @param[in] plate The plate of temperatures.
+ * @param[in] min The lowest temperature on the plate.
+ * @param[in] max The highest temperature on the plate.
+ * @param[in] bins The number of heat levels.
+ * @param[out] histogram bins counters, or NULL if only the levels are
+ * wanted.
+ * @param[out] norm_plate A rows * cols array for the levels, or NULL if
+ * only the histogram is wanted.
  */
 void create_histogram(
-    const int norm_plate[ROWS][COLS],
-    int histogram[HEAT_LEVELS]
+    const Plate_t * plate, double min, double max, int bins,
+    long * histogram, int * norm_plate
 ) {
-    int i, j, index;
+    const double * data = plate_data(plate);
+    const double temp_range = max - min;
+    int i;
+    TRACE_START(start);
 
-    for (i = 0; i < HEAT_LEVELS; i++) {
-        histogram[i] = 0;
+    if (histogram != NULL) {
+        for (i = 0; i < bins; i++) {
+            histogram[i] = 0;
+        }
     }
 
-    for (i = 0; i < ROWS; i++) {
-        for (j = 0; j < COLS; j++) {
-            index = norm_plate[i][j];
-            histogram[index]++;
+    #pragma omp parallel
+    {
+        long * counts = histogram == NULL ? NULL : calloc(bins, sizeof(long));
+        int j, heat_level;
+
+        #pragma omp for schedule(static)
+        for (i = 0; i < plate->rows; i++) {
+            const double * row = data + (size_t) i * plate->pitch;
+            int * norm_row = norm_plate == NULL ?
+                NULL : norm_plate + (size_t) i * plate->cols;
+
+            for (j = 0; j < plate->cols; j++) {
+                /*  In case every temperature in the plate is the same, 
+                    we don't have to do any calculations. */
+                if (temp_range == 0) {
+                    heat_level = 0;
+                } else {
+                    heat_level = (int) (
+                        ((row[j] - min) / temp_range) * bins
+                    );
+                    if (heat_level >= bins) {
+                        heat_level = bins - 1;
+                    }
+                }
+
+                if (norm_row != NULL)
+                    norm_row[j] = heat_level;
+                if (counts != NULL) {
+                    counts[heat_level]++;
+                } else if (histogram != NULL) {
+                    /*  No private bins could be allocated. */
+                    #pragma omp atomic
+                    histogram[heat_level]++;
+                }
+            }
+        }
+
+        if (counts != NULL) {
+            #pragma omp critical
+            for (j = 0; j < bins; j++) {
+                histogram[j] += counts[j];
+            }
+            free(counts);
         }
     }
+    TRACE_STOP(PHASE_HISTOGRAM, start);
 
     return;
 }
 
+/**
+ * @brief Creates a snapshot file and writes its header.
+ * @details An existing file is replaced.
+ *
+ * @param[out] writer The writer to set up.
+ * @param[in] plate The plate that will be written; only its size is used.
+ * @param[in] config The file, encoding, cadence and temperatures.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the file or the buffers could
+ * not be created. Nothing needs to be closed after a failure.
+ */
+int create_snapshot(
+    Snapshot_writer_t * writer, const Plate_t * plate, const Config_t * config
+) {
+    const Snapshot_encoding_t encoding = config->snapshot_encoding;
+    const size_t cells = (size_t) plate->rows * plate->cols;
+    Snapshot_header_t header;
+
+    writer->encoding = encoding;
+    writer->rows = plate->rows;
+    writer->cols = plate->cols;
+    writer->frames = 0;
+    writer->bytes = 0;
+    writer->previous = NULL;
+    writer->buffer = NULL;
+    /*  A delta payload is at most one run header per literal word. */
+    if (encoding == SNAPSHOT_DELTA) {
+        writer->previous = malloc(sizeof(double) * cells);
+        writer->buffer = malloc(2 * sizeof(uint64_t) * cells);
+    } else if (encoding == SNAPSHOT_LOSSY) {
+        writer->buffer = malloc(sizeof(uint16_t) * cells);
+    }
+    writer->file = fopen(config->snapshot, "wb");
+    if (writer->file == NULL || (encoding != SNAPSHOT_RAW && (
+            writer->buffer == NULL ||
+            (encoding == SNAPSHOT_DELTA && writer->previous == NULL)))) {
+        if (writer->file != NULL)
+            fclose(writer->file);
+        writer->file = NULL;
+        free(writer->previous);
+        free(writer->buffer);
+        return EXIT_FAILURE;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.dtype = SNAPSHOT_FLOAT64;
+    header.encoding = encoding;
+    header.rows = plate->rows;
+    header.cols = plate->cols;
+    header.temp_top = config->boundary.top;
+    header.temp_bottom = config->boundary.bottom;
+    header.temp_left = config->boundary.left;
+    header.temp_right = config->boundary.right;
+    header.temp_inner = config->boundary.inner;
+    header.cadence = config->snapshot_every;
+    if (fwrite(&header, sizeof(header), 1, writer->file) != 1) {
+        close_snapshot(writer);
+        return EXIT_FAILURE;
+    }
+    writer->bytes = sizeof(header);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Appends the plate to a snapshot file as one frame.
+ * @details Raw frames are written straight from the plate rows. A delta
+ * file starts again with a raw frame every SNAPSHOT_KEYFRAME frames.
+ *
+ * @param[in,out] writer The writer of the file.
+ * @param[in] plate The plate to write.
+ * @param[in] time The simulation time of the plate.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the file could not be written.
+ */
+int write_snapshot(Snapshot_writer_t * writer, const Plate_t * plate, int time) {
+    static const unsigned char padding[8];
+    const double * data = plate_data(plate);
+    Snapshot_frame_t frame;
+    int i, ok = 1;
+    TRACE_START(start);
+
+    memset(&frame, 0, sizeof(frame));
+    frame.time = time;
+    frame.encoding = writer->encoding;
+    if (frame.encoding == SNAPSHOT_DELTA &&
+        writer->frames % SNAPSHOT_KEYFRAME == 0)
+        frame.encoding = SNAPSHOT_RAW;
+
+    if (frame.encoding == SNAPSHOT_RAW)
+        frame.size = sizeof(double) * (size_t) plate->rows * plate->cols;
+    else if (frame.encoding == SNAPSHOT_DELTA)
+        frame.size = encode_delta(writer, plate, writer->buffer);
+    else {
+        find_min_and_max(plate, &frame.max, &frame.min);
+        frame.size = encode_lossy(plate, frame.min, frame.max, writer->buffer);
+    }
+
+    ok = fwrite(&frame, sizeof(frame), 1, writer->file) == 1;
+    if (frame.encoding == SNAPSHOT_RAW) {
+        for (i = 0; ok && i < plate->rows; i++) {
+            ok = fwrite(
+                data + (size_t) i * plate->pitch, sizeof(double),
+                plate->cols, writer->file
+            ) == (size_t) plate->cols;
+        }
+    } else {
+        ok = ok && fwrite(writer->buffer, 1, frame.size, writer->file)
+            == frame.size;
+    }
+    if (ok && frame.size % 8 != 0)
+        ok = fwrite(padding, 1, 8 - frame.size % 8, writer->file)
+            == 8 - frame.size % 8;
+    if (!ok) {
+        TRACE_STOP(PHASE_OUTPUT, start);
+        return EXIT_FAILURE;
+    }
+
+    if (writer->encoding == SNAPSHOT_DELTA) {
+        for (i = 0; i < plate->rows; i++) {
+            memcpy(
+                writer->previous + (size_t) i * plate->cols,
+                data + (size_t) i * plate->pitch,
+                sizeof(double) * plate->cols
+            );
+        }
+    }
+    writer->frames++;
+    writer->bytes += sizeof(frame) + (frame.size + 7) / 8 * 8;
+    TRACE_STOP(PHASE_OUTPUT, start);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Flushes and closes a snapshot file and frees the writer's buffers.
+ * @details Closing a writer that is already closed does nothing.
+ *
+ * @param[in,out] writer The writer to close.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if buffered frames could not be
+ * written.
+ */
+int close_snapshot(Snapshot_writer_t * writer) {
+    int status = EXIT_SUCCESS;
+
+    if (writer->file == NULL)
+        return EXIT_SUCCESS;
+    if (fclose(writer->file) != 0)
+        status = EXIT_FAILURE;
+    writer->file = NULL;
+    free(writer->previous);
+    free(writer->buffer);
+    writer->previous = NULL;
+    writer->buffer = NULL;
+
+    return status;
+}
+
+/**
+ * @brief Encodes the plate as a SNAPSHOT_DELTA payload.
+ * @details Each cell's bits are XORed with the previous frame's. Runs of
+ * zero words (unchanged cells) are only counted; the rest are copied.
+ *
+ * @param[in] writer The writer, holding the previous frame.
+ * @param[in] plate The plate to encode.
+ * @param[out] out Room for 16 bytes per cell.
+ *
+ * @return The size of the payload in bytes.
+ */
+size_t encode_delta(
+    const Snapshot_writer_t * writer, const Plate_t * plate,
+    unsigned char * out
+) {
+    const double * data = plate_data(plate);
+    const double * previous = writer->previous;
+    size_t head = 0, size;
+    uint32_t counts[2] = { 0, 0 };
+    uint64_t now, before;
+    int i, j;
+
+    /*  counts[0] zero words, then counts[1] literal words. A zero after
+        literals closes the pair and starts the next one. */
+    size = sizeof(counts);
+    for (i = 0; i < plate->rows; i++) {
+        const double * row = data + (size_t) i * plate->pitch;
+
+        for (j = 0; j < plate->cols; j++, previous++) {
+            memcpy(&now, row + j, sizeof(now));
+            memcpy(&before, previous, sizeof(before));
+            now ^= before;
+            if (now == 0) {
+                if (counts[1] > 0) {
+                    memcpy(out + head, counts, sizeof(counts));
+                    head = size;
+                    size += sizeof(counts);
+                    counts[0] = counts[1] = 0;
+                }
+                counts[0]++;
+            } else {
+                memcpy(out + size, &now, sizeof(now));
+                size += sizeof(now);
+                counts[1]++;
+            }
+        }
+    }
+    memcpy(out + head, counts, sizeof(counts));
+
+    return size;
+}
+
+/**
+ * @brief Encodes the plate as a SNAPSHOT_LOSSY payload.
+ *
+ * @param[in] plate The plate to encode.
+ * @param[in] min The lowest temperature on the plate.
+ * @param[in] max The highest temperature on the plate.
+ * @param[out] out Room for 2 bytes per cell.
+ *
+ * @return The size of the payload in bytes.
+ */
+size_t encode_lossy(
+    const Plate_t * plate, double min, double max, unsigned char * out
+) {
+    const double * data = plate_data(plate);
+    const double scale = max > min ? 65535.0 / (max - min) : 0;
+    uint16_t * codes = (uint16_t *) out;
+    int i;
+
+    #pragma omp parallel for schedule(static)
+    for (i = 0; i < plate->rows; i++) {
+        const double * row = data + (size_t) i * plate->pitch;
+        uint16_t * code = codes + (size_t) i * plate->cols;
+        int j;
+
+        for (j = 0; j < plate->cols; j++) {
+            code[j] = (uint16_t) ((row[j] - min) * scale + 0.5);
+        }
+    }
+
+    return sizeof(uint16_t) * (size_t) plate->rows * plate->cols;
+}
+/**
+ * @brief Starts the analysis thread and allocates its ring of buffers.
+ * @details The thread reports with its own histogram and normalized plate
+ * and becomes the only user of the snapshot writer until finish_pipeline.
+ *
+ * @param[out] pipeline The pipeline to start.
+ * @param[in] plate The plate that will be published; only its size is
+ * used.
+ * @param[in] config The ring size, the drop policy and the bins.
+ * @param[in,out] snapshot The open snapshot writer, or one whose file is
+ * NULL.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the buffers or the thread
+ * could not be created. Nothing needs to be finished after a failure.
+ */
+int create_pipeline(
+    Pipeline_t * pipeline, const Plate_t * plate, const Config_t * config,
+    Snapshot_writer_t * snapshot
+) {
+    int i, ok;
+
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->slots = config->pipeline;
+    pipeline->drop = config->pipeline_drop;
+    pipeline->snapshot = snapshot;
+    pipeline->bins = config->bins;
+    pipeline->histogram = malloc(sizeof(long) * config->bins);
+    pipeline->norm_plate = malloc(sizeof(int) * plate->rows * plate->cols);
+    pipeline->slot = calloc(pipeline->slots, sizeof(Pipeline_slot_t));
+    ok = pipeline->histogram != NULL && pipeline->norm_plate != NULL &&
+        pipeline->slot != NULL;
+    for (i = 0; ok && i < pipeline->slots; i++) {
+        ok = create_plate(
+            &pipeline->slot[i].plate, plate->rows, plate->cols, 1
+        ) == EXIT_SUCCESS;
+    }
+    if (ok && pthread_mutex_init(&pipeline->lock, NULL) != 0)
+        ok = 0;
+    else if (ok && pthread_cond_init(&pipeline->changed, NULL) != 0) {
+        pthread_mutex_destroy(&pipeline->lock);
+        ok = 0;
+    } else if (ok && pthread_create(
+            &pipeline->thread, NULL, run_pipeline, pipeline
+        ) != 0) {
+        pthread_cond_destroy(&pipeline->changed);
+        pthread_mutex_destroy(&pipeline->lock);
+        ok = 0;
+    }
+    if (!ok) {
+        for (i = 0; pipeline->slot != NULL && i < pipeline->slots; i++) {
+            if (pipeline->slot[i].plate.grid[0] != NULL)
+                destroy_plate(&pipeline->slot[i].plate);
+        }
+        free(pipeline->slot);
+        free(pipeline->norm_plate);
+        free(pipeline->histogram);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Hands a copy of the plate to the analysis thread.
+ * @details When every slot is taken the solver waits for one to be freed
+ * (backpressure). With --pipeline-drop it skips the frame instead, unless
+ * work has FRAME_KEEP.
+ *
+ * @param[in,out] pipeline The pipeline.
+ * @param[in] plate The plate to publish.
+ * @param[in] time The simulation time of the plate.
+ * @param[in] work FRAME_* bits telling what to do with the copy.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE once the analysis thread has
+ * failed to write a snapshot.
+ */
+int publish_plate(Pipeline_t * pipeline, const Plate_t * plate, int time,
+    int work) {
+    Pipeline_slot_t * slot;
+    double start;
+
+    pthread_mutex_lock(&pipeline->lock);
+    if (pipeline->used == pipeline->slots &&
+        pipeline->drop && !(work & FRAME_KEEP)) {
+        pipeline->dropped++;
+        pthread_mutex_unlock(&pipeline->lock);
+        return EXIT_SUCCESS;
+    }
+    start = wall_seconds();
+    while (pipeline->used == pipeline->slots && !pipeline->failed) {
+        pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+    }
+    pipeline->wait_seconds += wall_seconds() - start;
+    if (pipeline->failed) {
+        pthread_mutex_unlock(&pipeline->lock);
+        return EXIT_FAILURE;
+    }
+    slot = &pipeline->slot[
+        (pipeline->head + pipeline->used) % pipeline->slots
+    ];
+    pthread_mutex_unlock(&pipeline->lock);
+
+    /*  The slot is the solver's until it is counted as used. */
+    start = wall_seconds();
+    copy_plate(&slot->plate, plate);
+    slot->time = time;
+    slot->work = work;
+
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->copy_seconds += wall_seconds() - start;
+    pipeline->used++;
+    pipeline->published++;
+    if (pipeline->used > pipeline->peak)
+        pipeline->peak = pipeline->used;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->lock);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Lets the analysis thread handle every published plate, stops it
+ * and frees the ring. The metrics stay readable.
+ *
+ * @param[in,out] pipeline The pipeline.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if a snapshot could not be
+ * written.
+ */
+int finish_pipeline(Pipeline_t * pipeline) {
+    int i;
+
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->done = 1;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->lock);
+    pthread_join(pipeline->thread, NULL);
+
+    pthread_cond_destroy(&pipeline->changed);
+    pthread_mutex_destroy(&pipeline->lock);
+    for (i = 0; i < pipeline->slots; i++) {
+        destroy_plate(&pipeline->slot[i].plate);
+    }
+    free(pipeline->slot);
+    free(pipeline->norm_plate);
+    free(pipeline->histogram);
+    pipeline->slot = NULL;
+    pipeline->norm_plate = NULL;
+    pipeline->histogram = NULL;
+
+    return pipeline->failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief The analysis thread: handles the published plates in order.
+ * @details It runs its OpenMP regions on one thread, leaving the cores to
+ * the solver. After a failed snapshot write it only frees slots.
+ *
+ * @param[in,out] argument The Pipeline_t.
+ *
+ * @return NULL.
+ */
+void * run_pipeline(void * argument) {
+    Pipeline_t * pipeline = argument;
+    Pipeline_slot_t * slot;
+    double start;
+    int status;
+
+#ifdef _OPENMP
+    omp_set_num_threads(1);
+#endif
+    pthread_mutex_lock(&pipeline->lock);
+    while (1) {
+        while (pipeline->used == 0 && !pipeline->done) {
+            pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+        }
+        if (pipeline->used == 0)
+            break;
+        slot = &pipeline->slot[pipeline->head];
+        pthread_mutex_unlock(&pipeline->lock);
+
+        start = wall_seconds();
+        status = pipeline->failed ? EXIT_FAILURE : process_frame(
+            &slot->plate, slot->time, slot->work, pipeline->snapshot,
+            pipeline->bins, pipeline->histogram, pipeline->norm_plate
+        );
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->busy_seconds += wall_seconds() - start;
+        if (status != EXIT_SUCCESS)
+            pipeline->failed = 1;
+        pipeline->head = (pipeline->head + 1) % pipeline->slots;
+        pipeline->used--;
+        pthread_cond_broadcast(&pipeline->changed);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Reports a plate and/or writes it to the snapshot file.
+ * @details The report is the plate, its heat levels and their histogram.
+ * It is printed with stdout locked, so lines of other threads cannot end
+ * up in the middle of it.
+ *
+ * @param[in] plate The plate.
+ * @param[in] time The simulation time of the plate.
+ * @param[in] work FRAME_REPORT and/or FRAME_SNAPSHOT.
+ * @param[in,out] snapshot The snapshot writer for FRAME_SNAPSHOT.
+ * @param[in] bins The number of heat levels.
+ * @param[out] histogram Room for bins counters.
+ * @param[out] norm_plate Room for the heat level of every cell.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the snapshot could not be
+ * written.
+ */
+int process_frame(
+    const Plate_t * plate, int time, int work, Snapshot_writer_t * snapshot,
+    int bins, long * histogram, int * norm_plate
+) {
+    if (work & FRAME_REPORT) {
+        analyze_plate(plate, bins, histogram, norm_plate);
+        flockfile(stdout);
+        print_plate(plate, time);
+        print_norm_plate(norm_plate, plate->rows, plate->cols);
+        print_histogram(histogram, bins);
+        funlockfile(stdout);
+    }
+    if (work & FRAME_SNAPSHOT)
+        return write_snapshot(snapshot, plate, time);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Copies the latest state of a plate into another plate of the
+ * same size.
+ *
+ * @param[out] copy The plate to overwrite; its current grid is written.
+ * @param[in] plate The plate to copy.
+ */
+void copy_plate(Plate_t * copy, const Plate_t * plate) {
+    TRACE_START(start);
+
+    memcpy(
+        plate_data(copy) - PLATE_LEAD, plate_data(plate) - PLATE_LEAD,
+        sizeof(double) * plate->pitch * plate->rows
+    );
+    TRACE_STOP(PHASE_COPY, start);
+
+    return;
+}
 /**
  * @brief Prints the plate's raw temperature values to the console.
  * 
- * @param[in] plate The 2D array of temperatures to print.
+ * @param[in] plate The plate whose temperatures are printed.
  * @param[in] time The current simulation time (in seconds) to display.
  */
-void print_plate(const double plate[ROWS][COLS], int time) {
+void print_plate(const Plate_t * plate, int time) {
+    const double * data = plate_data(plate);
     int i, j;
+    TRACE_START(start);
 
     printf("\n || Time in seconds: %d ||\n", time);
     putchar('\n');
-    for (i = 0; i < ROWS; i++) {
-        for (j = 0; j < COLS; j++) {
-            printf("%6.2f ", plate[i][j]);
+    for (i = 0; i < plate->rows; i++) {
+        const double * row = data + (size_t) i * plate->pitch;
+
+        for (j = 0; j < plate->cols; j++) {
+            printf("%6.2f ", row[j]);
         }
         putchar('\n');
     }
     putchar('\n');
+    TRACE_STOP(PHASE_OUTPUT, start);
 
     return;
 }
@@ -325,18 +7796,22 @@ void print_plate(const double plate[ROWS][COLS], int time) {
 /**
  * @brief Prints the plate with the normalized integer values.
  * 
- * @param[in] norm_plate The 2D array of integer heat levels to print.
+ * @param[in] norm_plate The array of integer heat levels to print.
+ * @param[in] rows Number of rows in norm_plate.
+ * @param[in] cols Number of columns in norm_plate.
  */
-void print_norm_plate(const int norm_plate[ROWS][COLS]) {
+void print_norm_plate(const int * norm_plate, int rows, int cols) {
     int i, j;
+    TRACE_START(start);
 
-    for (i = 0; i < ROWS; i++) {
-        for(j = 0; j < COLS; j++) {
-            printf(" %d ", norm_plate[i][j]);
+    for (i = 0; i < rows; i++) {
+        for(j = 0; j < cols; j++) {
+            printf(" %d ", norm_plate[(size_t) i * cols + j]);
         }
         putchar('\n');
     }
     putchar('\n');
+    TRACE_STOP(PHASE_OUTPUT, start);
 
     return;
 }
@@ -346,17 +7821,21 @@ void print_norm_plate(const int norm_plate[ROWS][COLS]) {
  * 
  * @param[in] histogram An array where each index represents a heat level and 
  * the value is the frequency of that level.
+ * @param[in] bins The number of heat levels.
  */
-void print_histogram(const int histogram[HEAT_LEVELS]) {
-    int i, j;
+void print_histogram(const long * histogram, int bins) {
+    long j;
+    int i;
+    TRACE_START(start);
 
-    for (i = 0; i < HEAT_LEVELS; i++) {
+    for (i = 0; i < bins; i++) {
         printf("%d: ", i);
         for (j = 0; j < histogram[i]; j++) {
             putchar('#');
         }
         putchar('\n');
     }
+    TRACE_STOP(PHASE_OUTPUT, start);
 
     return;
 }
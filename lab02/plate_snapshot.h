@@ -0,0 +1,87 @@
+/*******************************************************************************
+ *                                                                             *
+ *  @file   plate_snapshot.h                                                   *
+ *  @author Christos Kaldis                                                    *
+ *  @date   17 Sept 2025                                                       *
+ *                                                                             *
+ *  @brief      Binary snapshot format of the plate heat simulation.           *
+ *  @details    A snapshot file is one Snapshot_header_t followed by frames.   *
+ *  Every frame is a Snapshot_frame_t and its payload, padded to a multiple    *
+ *  of 8 bytes, so a raw frame in a mapped file is a properly aligned array    *
+ *  of doubles. Cells are stored row by row without padding, in the byte      *
+ *  order of the machine that wrote the file (see SNAPSHOT_BYTE_ORDER).        *
+ *                                                                             *
+ ******************************************************************************/
+
+#ifndef PLATE_SNAPSHOT_H
+#define PLATE_SNAPSHOT_H
+
+#include <stdint.h>
+
+#define SNAPSHOT_MAGIC "PLATESNP"
+#define SNAPSHOT_VERSION 1
+/*  Written as a native uint32_t; a reader on a machine of the other byte
+    order sees 0x04030201. */
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+/*  A delta frame needs every frame back to the last raw one, so a raw
+    key frame is written every SNAPSHOT_KEYFRAME frames to bound the work
+    of reading a frame in the middle of a file. */
+#define SNAPSHOT_KEYFRAME 16
+
+/*  Cell type of the stored plate. */
+typedef enum snapshot_dtype_t {
+    SNAPSHOT_FLOAT64 = 1
+} Snapshot_dtype_t;
+
+/*  How a frame's payload encodes its cells.
+    SNAPSHOT_RAW:   rows * cols doubles.
+    SNAPSHOT_DELTA: the bits of every cell XORed with the bits of the same
+                    cell in the previous frame, then run-length coded as
+                    pairs of uint32_t counts (zero words, literal words)
+                    each followed by its literal uint64_t words. Lossless;
+                    cells that did not change cost nothing.
+    SNAPSHOT_LOSSY: one uint16_t per cell, the temperature mapped linearly
+                    from [min, max] of the frame to [0, 65535]. The error
+                    is at most (max - min) / 131070. */
+typedef enum snapshot_encoding_t {
+    SNAPSHOT_RAW = 0,
+    SNAPSHOT_DELTA = 1,
+    SNAPSHOT_LOSSY = 2
+} Snapshot_encoding_t;
+
+/*  The start of the file, 96 bytes. */
+typedef struct snapshot_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t dtype;
+    uint32_t encoding;
+    uint32_t rows;
+    uint32_t cols;
+    /*  Boundary and initial temperatures of the run. */
+    double temp_top;
+    double temp_bottom;
+    double temp_left;
+    double temp_right;
+    double temp_inner;
+    /*  Time steps between two frames. */
+    uint32_t cadence;
+    uint32_t reserved[5];
+} Snapshot_header_t;
+
+/*  The start of every frame, 40 bytes. */
+typedef struct snapshot_frame_t {
+    /*  Simulation time of the plate, in time steps. */
+    int64_t time;
+    /*  Snapshot_encoding_t of this frame; delta files hold raw key frames. */
+    uint32_t encoding;
+    uint32_t reserved;
+    /*  Payload bytes that follow, before the padding. */
+    uint64_t size;
+    /*  SNAPSHOT_LOSSY: the temperature of code 0; code 65535 is max. */
+    double min;
+    double max;
+} Snapshot_frame_t;
+
+#endif
@@ -0,0 +1,390 @@
+/*******************************************************************************
+ *                                                                             *
+ *  @file   plate_snapshot_reader.c                                            *
+ *  @author Christos Kaldis                                                    *
+ *  @date   17 Sept 2025                                                       *
+ *                                                                             *
+ *  @brief      Reads the snapshot files of the plate heat simulation.         *
+ *  @details    The file is memory mapped, not read. Raw frames are handed     *
+ *  out as pointers into the mapping; delta and lossy frames are decoded       *
+ *  into one buffer owned by the reader. Without options it lists the          *
+ *  frames; --frame N prints one frame like the simulation prints a plate.     *
+ *                                                                             *
+ ******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "plate_snapshot.h"
+
+/*  A mapped snapshot file and the frames found in it. */
+typedef struct snapshot_t {
+    const unsigned char * map;
+    size_t length;
+    const Snapshot_header_t * header;
+    long frames;
+    const Snapshot_frame_t ** frame;
+    /*  Cells of the last decoded frame, and its index or -1. */
+    double * decoded;
+    long decoded_frame;
+} Snapshot_t;
+
+int open_snapshot(Snapshot_t * snapshot, const char * path);
+void close_snapshot(Snapshot_t * snapshot);
+const double * snapshot_frame(Snapshot_t * snapshot, long index);
+int decode_delta(const Snapshot_frame_t * frame, double * cells, size_t n);
+void decode_lossy(const Snapshot_frame_t * frame, double * cells, size_t n);
+void print_frames(Snapshot_t * snapshot);
+void print_frame(Snapshot_t * snapshot, long index);
+
+
+int main(int argc, char * argv[]) {
+    Snapshot_t snapshot;
+    long index = -1;
+    char * end;
+
+    if (argc == 4 && strcmp(argv[2], "--frame") == 0) {
+        errno = 0;
+        index = strtol(argv[3], &end, 10);
+        if (end == argv[3] || *end != '\0' || errno != 0 || index < 0) {
+            fprintf(stderr, "'%s' is not a frame number.\n", argv[3]);
+            return EXIT_FAILURE;
+        }
+    } else if (argc != 2) {
+        fprintf(stderr, "Usage: %s FILE [--frame N]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (open_snapshot(&snapshot, argv[1]) != EXIT_SUCCESS) {
+        fprintf(stderr, "'%s' is not a readable snapshot file.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (index >= snapshot.frames) {
+        fprintf(stderr, "There are only %ld frames.\n", snapshot.frames);
+        close_snapshot(&snapshot);
+        return EXIT_FAILURE;
+    }
+
+    if (index < 0)
+        print_frames(&snapshot);
+    else
+        print_frame(&snapshot, index);
+
+    close_snapshot(&snapshot);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Maps a snapshot file and indexes its frames.
+ * @details A frame cut short at the end of the file (a run that was
+ * stopped while writing) is left out. Every frame must have the encoding
+ * of the header, or be a raw key frame of a delta file.
+ *
+ * @param[out] snapshot The snapshot to open.
+ * @param[in] path The file to map.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be mapped or
+ * is not a snapshot this reader understands.
+ */
+int open_snapshot(Snapshot_t * snapshot, const char * path) {
+    const Snapshot_header_t * header;
+    struct stat info;
+    size_t offset, cells;
+    long capacity = 0;
+    void * map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return EXIT_FAILURE;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(*header)) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /*  The mapping keeps the file open by itself. */
+    close(fd);
+    if (map == MAP_FAILED)
+        return EXIT_FAILURE;
+    posix_madvise(map, info.st_size, POSIX_MADV_SEQUENTIAL);
+
+    snapshot->map = map;
+    snapshot->length = info.st_size;
+    snapshot->header = header = map;
+    snapshot->frames = 0;
+    snapshot->frame = NULL;
+    snapshot->decoded = NULL;
+    snapshot->decoded_frame = -1;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SNAPSHOT_VERSION ||
+        header->byte_order != SNAPSHOT_BYTE_ORDER ||
+        header->dtype != SNAPSHOT_FLOAT64 ||
+        header->rows == 0 || header->cols == 0) {
+        close_snapshot(snapshot);
+        return EXIT_FAILURE;
+    }
+
+    cells = (size_t) header->rows * header->cols;
+    if (header->encoding != SNAPSHOT_RAW) {
+        snapshot->decoded = malloc(sizeof(double) * cells);
+        if (snapshot->decoded == NULL) {
+            close_snapshot(snapshot);
+            return EXIT_FAILURE;
+        }
+    }
+    offset = sizeof(*header);
+    while (offset + sizeof(Snapshot_frame_t) <= snapshot->length) {
+        const Snapshot_frame_t * frame = (const void *) (snapshot->map + offset);
+        size_t padded = (frame->size + 7) / 8 * 8;
+
+        if (padded > snapshot->length - offset - sizeof(*frame))
+            break;
+        if (frame->encoding != header->encoding &&
+            (frame->encoding != SNAPSHOT_RAW ||
+                header->encoding != SNAPSHOT_DELTA)) {
+            close_snapshot(snapshot);
+            return EXIT_FAILURE;
+        }
+        if (frame->encoding == SNAPSHOT_RAW ?
+                frame->size != sizeof(double) * cells :
+                frame->encoding == SNAPSHOT_LOSSY ?
+                frame->size != sizeof(uint16_t) * cells :
+                frame->encoding != SNAPSHOT_DELTA ||
+                snapshot->frames == 0)
+            break;
+        if (snapshot->frames == capacity) {
+            const Snapshot_frame_t ** grown;
+
+            capacity = capacity > 0 ? 2 * capacity : 64;
+            grown = realloc(snapshot->frame, sizeof(*grown) * capacity);
+            if (grown == NULL) {
+                close_snapshot(snapshot);
+                return EXIT_FAILURE;
+            }
+            snapshot->frame = grown;
+        }
+        snapshot->frame[snapshot->frames++] = frame;
+        offset += sizeof(*frame) + padded;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Unmaps a snapshot file and frees the reader's buffers.
+ * @details Frame views handed out before are no longer valid.
+ *
+ * @param[in,out] snapshot The snapshot to close.
+ */
+void close_snapshot(Snapshot_t * snapshot) {
+    munmap((void *) snapshot->map, snapshot->length);
+    free(snapshot->frame);
+    free(snapshot->decoded);
+    snapshot->map = NULL;
+    snapshot->frame = NULL;
+    snapshot->decoded = NULL;
+
+    return;
+}
+
+/**
+ * @brief Returns the cells of one frame, row by row without padding.
+ * @details A raw frame is a view into the mapped file and costs nothing.
+ * Other frames are decoded into the reader's buffer, which the next call
+ * may overwrite. A delta frame is rebuilt from the last raw key frame,
+ * or from the frame before it if that one is still decoded, so reading
+ * frames in order decodes each of them once.
+ *
+ * @param[in,out] snapshot The snapshot to read.
+ * @param[in] index The frame, from 0 to frames - 1.
+ *
+ * @return The cells, or NULL if the frame is damaged.
+ */
+const double * snapshot_frame(Snapshot_t * snapshot, long index) {
+    const size_t cells =
+        (size_t) snapshot->header->rows * snapshot->header->cols;
+    const Snapshot_frame_t * frame = snapshot->frame[index];
+    long first;
+
+    if (frame->encoding == SNAPSHOT_RAW)
+        return (const double *) (frame + 1);
+    if (snapshot->decoded_frame == index)
+        return snapshot->decoded;
+    if (frame->encoding == SNAPSHOT_LOSSY) {
+        decode_lossy(frame, snapshot->decoded, cells);
+        snapshot->decoded_frame = index;
+        return snapshot->decoded;
+    }
+
+    if (snapshot->decoded_frame >= 0 && snapshot->decoded_frame < index &&
+        index - snapshot->decoded_frame <= SNAPSHOT_KEYFRAME) {
+        first = snapshot->decoded_frame + 1;
+    } else {
+        first = index;
+        while (snapshot->frame[first]->encoding == SNAPSHOT_DELTA)
+            first--;
+        memcpy(
+            snapshot->decoded, snapshot->frame[first] + 1,
+            sizeof(double) * cells
+        );
+        first++;
+    }
+    /*  Any raw frame on the way simply restarts the chain. */
+    for (; first <= index; first++) {
+        frame = snapshot->frame[first];
+        if (frame->encoding == SNAPSHOT_RAW) {
+            memcpy(snapshot->decoded, frame + 1, sizeof(double) * cells);
+        } else if (decode_delta(frame, snapshot->decoded, cells)
+            != EXIT_SUCCESS) {
+            snapshot->decoded_frame = -1;
+            return NULL;
+        }
+    }
+    snapshot->decoded_frame = index;
+
+    return snapshot->decoded;
+}
+
+/**
+ * @brief Applies a SNAPSHOT_DELTA payload to the previous frame's cells.
+ *
+ * @param[in] frame The delta frame.
+ * @param[in,out] cells The previous frame's cells, turned into this one's.
+ * @param[in] n The number of cells.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the runs do not fit the frame.
+ */
+int decode_delta(const Snapshot_frame_t * frame, double * cells, size_t n) {
+    const unsigned char * in = (const unsigned char *) (frame + 1);
+    const unsigned char * end = in + frame->size;
+    size_t cell = 0;
+    uint32_t counts[2];
+    uint64_t word, bits;
+    uint32_t k;
+
+    while (in < end) {
+        if ((size_t) (end - in) < sizeof(counts))
+            return EXIT_FAILURE;
+        memcpy(counts, in, sizeof(counts));
+        in += sizeof(counts);
+        if (counts[0] > n - cell || counts[1] > n - cell - counts[0] ||
+            (size_t) (end - in) < sizeof(word) * counts[1])
+            return EXIT_FAILURE;
+        cell += counts[0];
+        for (k = 0; k < counts[1]; k++, cell++) {
+            memcpy(&word, in, sizeof(word));
+            in += sizeof(word);
+            memcpy(&bits, cells + cell, sizeof(bits));
+            bits ^= word;
+            memcpy(cells + cell, &bits, sizeof(bits));
+        }
+    }
+
+    return cell == n ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Turns a SNAPSHOT_LOSSY payload back into temperatures.
+ *
+ * @param[in] frame The lossy frame.
+ * @param[out] cells The decoded cells.
+ * @param[in] n The number of cells.
+ */
+void decode_lossy(const Snapshot_frame_t * frame, double * cells, size_t n) {
+    const uint16_t * codes = (const uint16_t *) (frame + 1);
+    const double step = (frame->max - frame->min) / 65535.0;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        cells[i] = frame->min + codes[i] * step;
+    }
+
+    return;
+}
+
+/**
+ * @brief Prints the header and one line per frame.
+ *
+ * @param[in,out] snapshot The snapshot to list.
+ */
+void print_frames(Snapshot_t * snapshot) {
+    static const char * names[] = { "raw", "delta", "lossy" };
+    const Snapshot_header_t * header = snapshot->header;
+    const size_t cells = (size_t) header->rows * header->cols;
+    long i;
+
+    printf(
+        "%u x %u plate, %s frames every %u steps\n"
+        "edges: top %.2f, bottom %.2f, left %.2f, right %.2f; inner %.2f\n",
+        header->rows, header->cols,
+        header->encoding <= SNAPSHOT_LOSSY ? names[header->encoding] : "?",
+        header->cadence, header->temp_top, header->temp_bottom,
+        header->temp_left, header->temp_right, header->temp_inner
+    );
+    for (i = 0; i < snapshot->frames; i++) {
+        const Snapshot_frame_t * frame = snapshot->frame[i];
+        const double * data = snapshot_frame(snapshot, i);
+        double min, max, sum = 0;
+        size_t j;
+
+        if (data == NULL) {
+            printf("%6ld: damaged\n", i);
+            continue;
+        }
+        min = max = data[0];
+        for (j = 0; j < cells; j++) {
+            if (data[j] < min)
+                min = data[j];
+            if (data[j] > max)
+                max = data[j];
+            sum += data[j];
+        }
+        printf(
+            "%6ld: time %lld, %-5s %10llu bytes, min %.4f, max %.4f, "
+            "mean %.6f\n", i, (long long) frame->time,
+            names[frame->encoding], (unsigned long long) frame->size,
+            min, max, sum / cells
+        );
+    }
+
+    return;
+}
+
+/**
+ * @brief Prints the temperatures of one frame.
+ *
+ * @param[in,out] snapshot The snapshot to read.
+ * @param[in] index The frame to print.
+ */
+void print_frame(Snapshot_t * snapshot, long index) {
+    const double * data = snapshot_frame(snapshot, index);
+    unsigned i, j;
+
+    if (data == NULL) {
+        puts("The frame is damaged.");
+        return;
+    }
+    printf(
+        "\n || Time in seconds: %lld ||\n",
+        (long long) snapshot->frame[index]->time
+    );
+    putchar('\n');
+    for (i = 0; i < snapshot->header->rows; i++) {
+        for (j = 0; j < snapshot->header->cols; j++) {
+            printf("%6.2f ", *data++);
+        }
+        putchar('\n');
+    }
+    putchar('\n');
+
+    return;
+}
@@ -0,0 +1,1050 @@
+/*******************************************************************************
+ *                                                                             *
+ *  @file   plate_solver.c                                                     *
+ *  @author Christos Kaldis                                                    *
+ *  @date   17 Sept 2025                                                       *
+ *                                                                             *
+ *  @brief      The solver core of the plate heat simulation.                  *
+ *  @details    Allocates, initializes and steps plates with the row kernel    *
+ *  chosen for the CPU. Both the simulation and libplate are built from it;    *
+ *  see plate_solver.h.                                                        *
+ *                                                                             *
+ ******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+/*  MAP_HUGETLB and MADV_HUGEPAGE for --huge-pages. */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+
+#include "plate_solver.h"
+#ifdef PLATE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/*  Row kernels, best first. The scalar one must stay last. */
+const Kernel_t kernels[] = {
+#ifdef PLATE_X86_KERNELS
+    {
+        "avx512", "avx512f", stencil_row_avx512, stencil_row_float_avx512,
+        ensemble_row_avx512
+    },
+    {
+        "avx2", "avx2", stencil_row_avx2, stencil_row_float_avx2,
+        ensemble_row_avx2
+    },
+    {
+        "sse2", "sse2", stencil_row_sse2, stencil_row_float_sse2,
+        ensemble_row_sse2
+    },
+#endif
+    {
+        "scalar", NULL, stencil_row_scalar, stencil_row_float_scalar,
+        ensemble_row_scalar
+    }
+};
+const int kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+/*  The row kernels calc_temp, stencil_step_float and ensemble_step use,
+    chosen once at startup. */
+Row_kernel_t row_kernel = stencil_row_scalar;
+Row_kernel_float_t row_kernel_float = stencil_row_float_scalar;
+Ensemble_kernel_t ensemble_kernel = ensemble_row_scalar;
+
+/*  Non-zero for --deterministic: every sum over the plate is taken per
+    row (or tile) and the partial sums are added in a fixed order, so the
+    result does not depend on the number of threads. */
+int deterministic = 0;
+
+/*  How create_plate allocates and places new plates, see --placement and
+    --huge-pages. */
+Placement_t placement = PLACEMENT_FIRST_TOUCH;
+Huge_pages_t huge_pages = HUGE_PAGES_NONE;
+
+/**
+ * @brief Allocates the grids of a rows x cols plate.
+ * @details The row pitch is rounded up to a whole number of cache lines and
+ * the grids are aligned to PLATE_ALIGN, so the first interior cell of
+ * every row is aligned. Both grids are one allocation, of the pages chosen
+ * by --huge-pages. Padding cells are zeroed and never read.
+ * The interior rows are zeroed by the threads that will step them (the
+ * same rows and static schedule as stencil_step), which places them on
+ * those threads' NUMA nodes, unless --placement serial is given. The
+ * edge rows, which no step writes, are zeroed by the calling thread.
+ *
+ * @param[out] plate The plate to set up.
+ * @param[in] rows Number of rows, edges included.
+ * @param[in] cols Number of columns, edges included.
+ * @param[in] grids 2 for explicit time steps, 1 for in-place solvers.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the allocation failed.
+ */
+int create_plate(Plate_t * plate, int rows, int cols, int grids) {
+    const int line = PLATE_ALIGN / sizeof(double);
+    size_t cells, bytes;
+    double * memory;
+    int i;
+
+    plate->rows = rows;
+    plate->cols = cols;
+    plate->pitch = (PLATE_LEAD + cols + line - 1) / line * line;
+    plate->grids = grids;
+    plate->grid[1] = NULL;
+    plate->current = 0;
+    plate->partial = malloc(sizeof(double) * 2 * rows);
+    if (plate->partial == NULL)
+        return EXIT_FAILURE;
+    cells = (size_t) plate->pitch * rows;
+    bytes = sizeof(double) * cells * grids;
+    memory = allocate_grids(&bytes, &plate->mapped);
+    if (memory == NULL) {
+        free(plate->partial);
+        return EXIT_FAILURE;
+    }
+    plate->grid[0] = memory + PLATE_LEAD;
+    if (grids == 2)
+        plate->grid[1] = memory + cells + PLATE_LEAD;
+
+    #pragma omp parallel for schedule(static) \
+        if (placement == PLACEMENT_FIRST_TOUCH)
+    for (i = 1; i < rows - 1; i++) {
+        int g;
+
+        for (g = 0; g < grids; g++) {
+            memset(
+                plate->grid[g] + (size_t) i * plate->pitch - PLATE_LEAD, 0,
+                sizeof(double) * plate->pitch
+            );
+        }
+    }
+    for (i = 0; i < grids; i++) {
+        memset(
+            plate->grid[i] - PLATE_LEAD, 0, sizeof(double) * plate->pitch
+        );
+        memset(
+            plate->grid[i] + (size_t) (rows - 1) * plate->pitch - PLATE_LEAD,
+            0, sizeof(double) * plate->pitch
+        );
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Allocates untouched memory for the grids of a plate.
+ * @details Transparent huge pages are asked for with madvise on memory
+ * aligned to HUGE_PAGE; the kernel may still back it with small pages.
+ * Explicit huge pages come from an anonymous MAP_HUGETLB mapping and fail
+ * if not enough are reserved.
+ *
+ * @param[in,out] bytes The size wanted; rounded up to whole huge pages
+ * when they are used.
+ * @param[out] mapped The size of the mapping to munmap, or 0 if the memory
+ * is to be freed with free.
+ *
+ * @return The memory, aligned to PLATE_ALIGN at least, or NULL.
+ */
+void * allocate_grids(size_t * bytes, size_t * mapped) {
+    void * memory = NULL;
+
+    *mapped = 0;
+    if (huge_pages != HUGE_PAGES_NONE)
+        *bytes = (*bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    if (huge_pages == HUGE_PAGES_EXPLICIT) {
+#ifdef MAP_HUGETLB
+        memory = mmap(
+            NULL, *bytes, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+        );
+        if (memory == MAP_FAILED)
+            return NULL;
+        *mapped = *bytes;
+#endif
+        return memory;
+    }
+    if (posix_memalign(
+            &memory, huge_pages == HUGE_PAGES_TRANSPARENT ?
+                HUGE_PAGE : PLATE_ALIGN, *bytes
+        ) != 0)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    if (huge_pages == HUGE_PAGES_TRANSPARENT)
+        madvise(memory, *bytes, MADV_HUGEPAGE);
+#endif
+
+    return memory;
+}
+
+/**
+ * @brief Releases the grids of a plate created with create_plate or
+ * create_plate_mapped.
+ *
+ * @param[in,out] plate The plate to release.
+ */
+void destroy_plate(Plate_t * plate) {
+    if (plate->mapped > 0)
+        munmap(plate->grid[0] - PLATE_LEAD, plate->mapped);
+    else
+        free(plate->grid[0] - PLATE_LEAD);
+    plate->grid[0] = plate->grid[1] = NULL;
+    free(plate->partial);
+    plate->partial = NULL;
+
+    return;
+}
+
+/**
+ * @brief Returns the grid holding the latest plate state.
+ * @details Cell (i, j) is at index i * pitch + j.
+ *
+ * @param[in] plate The plate.
+ *
+ * @return Pointer to cell (0, 0) of the current grid.
+ */
+double * plate_data(const Plate_t * plate) {
+    return plate->grid[plate->current];
+}
+
+/**
+ * @brief Returns the grid the next time step is written to.
+ *
+ * @param[in] plate The plate.
+ *
+ * @return Pointer to cell (0, 0) of the back grid.
+ */
+double * plate_back(const Plate_t * plate) {
+    return plate->grid[1 - plate->current];
+}
+
+/**
+ * @brief Makes the back grid the current one.
+ *
+ * @param[in,out] plate The plate.
+ */
+void swap_plate(Plate_t * plate) {
+    plate->current = 1 - plate->current;
+
+    return;
+}
+
+/**
+ * @brief Initializes the entire plate with boundary and inner temperatures.
+ * @details Sets the edge temperatures and calculates corner temperatures as the
+ * average of adjacent edges. The inner part of the plate is set to a
+ * default temperature. All grids are initialized, so the edges are in place
+ * whichever grid a time step writes to.
+ * 
+ * @param[out] plate The plate to be initialized.
+ * @param[in] boundary The edge and inner temperatures.
+ */
+void init_plate(Plate_t * plate, const Boundary_t * boundary) {
+    /* Calculate corner temperatures as the average of adjacent edges. */
+    double top_left_edge = (boundary->left + boundary->top) / 2;
+    double top_right_edge = (boundary->right + boundary->top) / 2;
+    double bottom_left_edge = (boundary->left + boundary->bottom) / 2;
+    double bottom_right_edge = (boundary->right + boundary->bottom) / 2;
+    int i;
+
+    /*  There is a minor performance overhead from function calls.
+        This for loop is small so we don't care but usually, in HPC you 
+        avoid function calls inside large loops, this way you sacrifice 
+        clarity for efficiency.
+        Each thread writes the interior rows it will step, as in
+        create_plate, and the edge rows are written afterwards. */
+    #pragma omp parallel for schedule(static) \
+        if (placement == PLACEMENT_FIRST_TOUCH)
+    for (i = 1; i < plate->rows - 1; i++) {
+        init_row_plate(
+            plate, i, boundary->left, boundary->inner, boundary->right
+        );
+    }
+    init_row_plate(plate, 0, top_left_edge, boundary->top, top_right_edge);
+    init_row_plate(
+        plate, plate->rows - 1, bottom_left_edge, boundary->bottom,
+        bottom_right_edge
+    );
+
+    return;
+}
+
+/**
+ * @brief Initializes a single row of the plate with specified temperatures.
+ * @details The row is written in every grid of the plate.
+ * 
+ * @param[out] plate The plate.
+ * @param[in] row_index The index of the row to initialize.
+ * @param[in] left_edge_temp The temperature for the leftmost cell of the row.
+ * @param[in] inner_temp The temperature for the inner cells of the row.
+ * @param[in] right_edge_temp The temperature for the rightmost cell of the row.
+ */
+void init_row_plate(
+    Plate_t * plate,
+    int row_index,
+    double left_edge_temp,
+    double inner_temp,
+    double right_edge_temp
+) {
+    const int cols = plate->cols;
+    double * row;
+    int g, i;
+
+    for (g = 0; g < plate->grids; g++) {
+        row = plate->grid[g] + (size_t) row_index * plate->pitch;
+        row[0] = left_edge_temp;
+        for (i = 1; i < cols - 1; i++) {
+            row[i] = inner_temp;
+        }
+        row[cols-1] = right_edge_temp;
+    }
+
+    return;
+}
+
+/**
+ * @brief Calculates one time step of the heat diffusion.
+ * @details Updates each inner cell's temperature based on the average of 
+ * its neighbors from the previous timestep (t-1). The (t-1) values are read
+ * from the current grid and the new values are written to the back grid,
+ * then the grids are swapped, so no copy of the plate is made.
+ * 
+ * @param[in,out] plate The plate, which will be advanced to the next
+ * time step (t).
+ * 
+ * @return The total absolute change in temperature across the plate during
+ * this time step.
+ */
+double calc_temp(Plate_t * plate) {
+    return stencil_step(plate, 1);
+}
+
+/**
+ * @brief One time step, with or without measuring the change.
+ * @details The interior rows are split into one contiguous band per OpenMP
+ * thread. The team is created once and reused on every step, and each
+ * thread sums its own band's change, so the total needs no atomic updates.
+ * Without measuring there is no reduction at all. With --deterministic
+ * every row's change is kept and added up by sum_partials instead.
+ *
+ * @param[in,out] plate The plate, advanced to the next time step.
+ * @param[in] measure Non-zero to sum the absolute changes.
+ *
+ * @return The total absolute change, or 0 if measure is zero.
+ */
+double stencil_step(Plate_t * plate, int measure) {
+    const size_t pitch = plate->pitch;
+    const int rows = plate->rows, cols = plate->cols;
+    const double * old = plate_data(plate);
+    double * new = plate_back(plate);
+    double delta_temp = 0;
+    int i;
+    TRACE_START(start);
+
+    if (measure && deterministic) {
+        #pragma omp parallel for schedule(static)
+        for (i = 1; i < rows - 1; i++) {
+            plate->partial[i] = row_kernel(
+                old + (i - 1) * pitch, old + i * pitch, old + (i + 1) * pitch,
+                new + i * pitch, cols - 2, 1
+            );
+        }
+        {
+            TRACE_START(sum);
+
+            delta_temp = sum_partials(plate->partial + 1, rows - 2);
+            TRACE_STOP(PHASE_REDUCTION, sum);
+        }
+    } else if (measure) {
+        #pragma omp parallel for schedule(static) reduction(+:delta_temp)
+        for (i = 1; i < rows - 1; i++) {
+            delta_temp += row_kernel(
+                old + (i - 1) * pitch, old + i * pitch, old + (i + 1) * pitch,
+                new + i * pitch, cols - 2, 1
+            );
+        }
+    } else {
+        #pragma omp parallel for schedule(static)
+        for (i = 1; i < rows - 1; i++) {
+            row_kernel(
+                old + (i - 1) * pitch, old + i * pitch, old + (i + 1) * pitch,
+                new + i * pitch, cols - 2, 0
+            );
+        }
+    }
+    swap_plate(plate);
+    TRACE_STOP(PHASE_STENCIL, start);
+
+    return delta_temp;
+}
+
+/**
+ * @brief Adds up per-row (or per-tile) sums in a fixed order.
+ * @details The sums are added as a balanced binary tree whose shape only
+ * depends on count, so the result is the same however many threads
+ * produced them, and the rounding error grows with log(count) instead of
+ * count.
+ *
+ * @param[in] partial The sums.
+ * @param[in] count The number of sums.
+ *
+ * @return Their total.
+ */
+double sum_partials(const double * partial, int count) {
+    double total = 0;
+    int i;
+
+    if (count > 8)
+        return sum_partials(partial, count / 2) +
+            sum_partials(partial + count / 2, count - count / 2);
+    for (i = 0; i < count; i++) {
+        total += partial[i];
+    }
+
+    return total;
+}
+
+/**
+ * @brief Chooses the row kernel calc_temp uses.
+ * @details "auto" picks the widest kernel the CPU reports through CPUID.
+ * A kernel asked for by name is only accepted if the CPU supports it.
+ *
+ * @param[in] name A kernel name from the kernels table, or "auto".
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the kernel is unknown or not
+ * supported by this CPU.
+ */
+int select_kernel(const char * name) {
+    const int count = sizeof(kernels) / sizeof(kernels[0]);
+    int i, is_auto = strcmp(name, "auto") == 0;
+
+    for (i = 0; i < count; i++) {
+        if (!is_auto && strcmp(name, kernels[i].name) != 0)
+            continue;
+        if (kernels[i].cpu_feature != NULL &&
+            !cpu_has_feature(kernels[i].cpu_feature)) {
+            if (is_auto)
+                continue;
+            return EXIT_FAILURE;
+        }
+        row_kernel = kernels[i].run;
+        row_kernel_float = kernels[i].run_float;
+        ensemble_kernel = kernels[i].run_ensemble;
+        return EXIT_SUCCESS;
+    }
+
+    return EXIT_FAILURE;
+}
+
+/**
+ * @brief Asks CPUID whether the CPU has an instruction set extension.
+ *
+ * @param[in] feature "sse2", "avx2" or "avx512f".
+ *
+ * @return Non-zero if the feature is present.
+ */
+int cpu_has_feature(const char * feature) {
+#ifdef PLATE_X86_KERNELS
+    /*  The builtin only takes string literals. */
+    __builtin_cpu_init();
+    if (strcmp(feature, "sse2") == 0)
+        return __builtin_cpu_supports("sse2");
+    if (strcmp(feature, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if (strcmp(feature, "avx512f") == 0)
+        return __builtin_cpu_supports("avx512f");
+#endif
+    (void) feature;
+
+    return 0;
+}
+
+/**
+ * @brief Reference row kernel of the 9-point stencil.
+ * @details The new temperature is 0.1 times the sum of the eight neighbours
+ * plus twice the cell itself. The vector kernels add the terms in exactly
+ * this order and never fuse multiply and add, so they produce bit-identical
+ * temperatures. They do keep one partial change sum per lane, so the
+ * returned change may differ from this kernel's in the last bits; the
+ * relative difference is bounded by n * DBL_EPSILON.
+ *
+ * @param[in] up The row above, starting at its column 0.
+ * @param[in] mid The row being updated, at the previous time step.
+ * @param[in] down The row below.
+ * @param[out] out Receives the new values of cells 1 .. n.
+ * @param[in] n The number of interior cells in the row.
+ * @param[in] measure Non-zero to sum the absolute changes.
+ *
+ * @return The sum of the absolute changes of the row, or 0 if measure is
+ * zero.
+ */
+double stencil_row_scalar(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int measure
+) {
+    double delta_temp = 0;
+    int j;
+
+    for (j = 1; j <= n; j++) {
+        out[j] = 0.1 * (
+            up[j-1] +
+            up[j] +
+            up[j+1] +
+            mid[j-1] +
+            2 * mid[j] +
+            mid[j+1] +
+            down[j-1] +
+            down[j] +
+            down[j+1]
+        ) ;
+
+        if (measure)
+            delta_temp += fabs(out[j] - mid[j]);
+    }
+
+    return delta_temp;
+}
+
+/**
+ * @brief Reference row kernel of a single-precision plate.
+ * @details The arithmetic of stencil_row_scalar, in float. The vector
+ * kernels follow the same order, so every kernel gives the same cells.
+ *
+ * @param[in] up The row above, starting at its column 0.
+ * @param[in] mid The row being updated, at the previous time step.
+ * @param[in] down The row below.
+ * @param[out] out Receives the new values of cells 1 .. n.
+ * @param[in] n The number of interior cells in the row.
+ * @param[in] measure MEASURE_NONE, or MEASURE_SINGLE or MEASURE_DOUBLE
+ * to sum the absolute changes in float or in double.
+ *
+ * @return The sum of the absolute changes of the row, or 0.
+ */
+double stencil_row_float_scalar(
+    const float * up, const float * mid, const float * down,
+    float * out, int n, int measure
+) {
+    float delta_single = 0;
+    double delta_double = 0;
+    int j;
+
+    for (j = 1; j <= n; j++) {
+        out[j] = 0.1f * (
+            up[j-1] +
+            up[j] +
+            up[j+1] +
+            mid[j-1] +
+            2 * mid[j] +
+            mid[j+1] +
+            down[j-1] +
+            down[j] +
+            down[j+1]
+        ) ;
+
+        if (measure == MEASURE_SINGLE)
+            delta_single += fabsf(out[j] - mid[j]);
+        else if (measure == MEASURE_DOUBLE)
+            delta_double += fabsf(out[j] - mid[j]);
+    }
+
+    return delta_single + delta_double;
+}
+
+/**
+ * @brief Reference row kernel of an ensemble.
+ * @details Every lane gets the arithmetic of stencil_row_scalar, and its
+ * change is summed from left to right like that kernel does. The vector
+ * kernels do the same per lane, so all of them give identical results.
+ *
+ * @param[in] up The row above, starting at its column 0.
+ * @param[in] mid The row being updated, at the previous time step.
+ * @param[in] down The row below.
+ * @param[out] out Receives the new values of cells 1 .. n.
+ * @param[in] n The number of interior cells in the row.
+ * @param[in] width The lanes per cell, a multiple of ENSEMBLE_LANES.
+ * @param[in] mask Per lane, a NaN to update it or +0.0 to keep it.
+ * @param[out] change width sums of the absolute changes, or NULL.
+ */
+void ensemble_row_scalar(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int width, const double * mask, double * change
+) {
+    const size_t w = width;
+    double value;
+    size_t c;
+    int j, m;
+
+    if (change != NULL) {
+        for (m = 0; m < width; m++) {
+            change[m] = 0;
+        }
+    }
+    for (j = 1; j <= n; j++) {
+        for (m = 0; m < width; m++) {
+            c = j * w + m;
+            value = 0.1 * (
+                up[c-w] +
+                up[c] +
+                up[c+w] +
+                mid[c-w] +
+                2 * mid[c] +
+                mid[c+w] +
+                down[c-w] +
+                down[c] +
+                down[c+w]
+            ) ;
+            if (!isnan(mask[m]))
+                value = mid[c];
+            out[c] = value;
+
+            if (change != NULL)
+                change[m] += fabs(value - mid[c]);
+        }
+    }
+
+    return;
+}
+
+#ifdef PLATE_X86_KERNELS
+/**
+ * @brief SSE2 row kernel, two cells per instruction.
+ * @details See stencil_row_scalar for the arithmetic. The cells left over
+ * after the last full vector are done by the scalar kernel.
+ */
+__attribute__((target("sse2")))
+double stencil_row_sse2(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int measure
+) {
+    const __m128d weight = _mm_set1_pd(0.1);
+    const __m128d sign = _mm_set1_pd(-0.0);
+    __m128d delta = _mm_setzero_pd(), sum, centre, value;
+    double lanes[2];
+    int j;
+
+    for (j = 1; j + 1 <= n; j += 2) {
+        centre = _mm_loadu_pd(mid + j);
+        sum = _mm_add_pd(_mm_loadu_pd(up + j - 1), _mm_loadu_pd(up + j));
+        sum = _mm_add_pd(sum, _mm_loadu_pd(up + j + 1));
+        sum = _mm_add_pd(sum, _mm_loadu_pd(mid + j - 1));
+        sum = _mm_add_pd(sum, _mm_add_pd(centre, centre));
+        sum = _mm_add_pd(sum, _mm_loadu_pd(mid + j + 1));
+        sum = _mm_add_pd(sum, _mm_loadu_pd(down + j - 1));
+        sum = _mm_add_pd(sum, _mm_loadu_pd(down + j));
+        sum = _mm_add_pd(sum, _mm_loadu_pd(down + j + 1));
+        value = _mm_mul_pd(weight, sum);
+        _mm_storeu_pd(out + j, value);
+        if (measure)
+            delta = _mm_add_pd(
+                delta, _mm_andnot_pd(sign, _mm_sub_pd(value, centre))
+            );
+    }
+    _mm_storeu_pd(lanes, delta);
+
+    return lanes[0] + lanes[1] + stencil_row_scalar(
+        up + j - 1, mid + j - 1, down + j - 1, out + j - 1, n - j + 1,
+        measure
+    );
+}
+
+/**
+ * @brief AVX2 row kernel, four cells per instruction.
+ * @details See stencil_row_scalar for the arithmetic.
+ */
+__attribute__((target("avx2")))
+double stencil_row_avx2(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int measure
+) {
+    const __m256d weight = _mm256_set1_pd(0.1);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d delta = _mm256_setzero_pd(), sum, centre, value;
+    double lanes[4];
+    int j;
+
+    for (j = 1; j + 3 <= n; j += 4) {
+        centre = _mm256_loadu_pd(mid + j);
+        sum = _mm256_add_pd(
+            _mm256_loadu_pd(up + j - 1), _mm256_loadu_pd(up + j)
+        );
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(up + j + 1));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(mid + j - 1));
+        sum = _mm256_add_pd(sum, _mm256_add_pd(centre, centre));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(mid + j + 1));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + j - 1));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + j));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + j + 1));
+        value = _mm256_mul_pd(weight, sum);
+        _mm256_storeu_pd(out + j, value);
+        if (measure)
+            delta = _mm256_add_pd(
+                delta, _mm256_andnot_pd(sign, _mm256_sub_pd(value, centre))
+            );
+    }
+    _mm256_storeu_pd(lanes, delta);
+
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + stencil_row_scalar(
+        up + j - 1, mid + j - 1, down + j - 1, out + j - 1, n - j + 1,
+        measure
+    );
+}
+
+/**
+ * @brief AVX-512 row kernel, eight cells per instruction.
+ * @details See stencil_row_scalar for the arithmetic. With the default
+ * padding every full vector store hits one aligned cache line.
+ */
+__attribute__((target("avx512f")))
+double stencil_row_avx512(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int measure
+) {
+    const __m512d weight = _mm512_set1_pd(0.1);
+    __m512d delta = _mm512_setzero_pd(), sum, centre, value;
+    int j;
+
+    for (j = 1; j + 7 <= n; j += 8) {
+        centre = _mm512_loadu_pd(mid + j);
+        sum = _mm512_add_pd(
+            _mm512_loadu_pd(up + j - 1), _mm512_loadu_pd(up + j)
+        );
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(up + j + 1));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(mid + j - 1));
+        sum = _mm512_add_pd(sum, _mm512_add_pd(centre, centre));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(mid + j + 1));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(down + j - 1));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(down + j));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(down + j + 1));
+        value = _mm512_mul_pd(weight, sum);
+        _mm512_storeu_pd(out + j, value);
+        if (measure)
+            delta = _mm512_add_pd(
+                delta, _mm512_abs_pd(_mm512_sub_pd(value, centre))
+            );
+    }
+
+    return _mm512_reduce_add_pd(delta) + stencil_row_scalar(
+        up + j - 1, mid + j - 1, down + j - 1, out + j - 1, n - j + 1,
+        measure
+    );
+}
+
+/**
+ * @brief SSE2 row kernel of a single-precision plate, four cells per
+ * instruction.
+ * @details See stencil_row_float_scalar for the arithmetic.
+ */
+__attribute__((target("sse2")))
+double stencil_row_float_sse2(
+    const float * up, const float * mid, const float * down,
+    float * out, int n, int measure
+) {
+    const __m128 weight = _mm_set1_ps(0.1f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 delta = _mm_setzero_ps(), sum, centre, value, change;
+    __m128d wide = _mm_setzero_pd();
+    float lanes[4];
+    double wide_lanes[2];
+    int j;
+
+    for (j = 1; j + 3 <= n; j += 4) {
+        centre = _mm_loadu_ps(mid + j);
+        sum = _mm_add_ps(_mm_loadu_ps(up + j - 1), _mm_loadu_ps(up + j));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(up + j + 1));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(mid + j - 1));
+        sum = _mm_add_ps(sum, _mm_add_ps(centre, centre));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(mid + j + 1));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(down + j - 1));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(down + j));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(down + j + 1));
+        value = _mm_mul_ps(weight, sum);
+        _mm_storeu_ps(out + j, value);
+        if (measure == MEASURE_NONE)
+            continue;
+        change = _mm_andnot_ps(sign, _mm_sub_ps(value, centre));
+        if (measure == MEASURE_SINGLE) {
+            delta = _mm_add_ps(delta, change);
+        } else {
+            wide = _mm_add_pd(wide, _mm_cvtps_pd(change));
+            wide = _mm_add_pd(
+                wide, _mm_cvtps_pd(_mm_movehl_ps(change, change))
+            );
+        }
+    }
+    _mm_storeu_ps(lanes, delta);
+    _mm_storeu_pd(wide_lanes, wide);
+
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+        (wide_lanes[0] + wide_lanes[1]) + stencil_row_float_scalar(
+            up + j - 1, mid + j - 1, down + j - 1, out + j - 1, n - j + 1,
+            measure
+        );
+}
+
+/**
+ * @brief AVX2 row kernel of a single-precision plate, eight cells per
+ * instruction.
+ * @details See stencil_row_float_scalar for the arithmetic.
+ */
+__attribute__((target("avx2")))
+double stencil_row_float_avx2(
+    const float * up, const float * mid, const float * down,
+    float * out, int n, int measure
+) {
+    const __m256 weight = _mm256_set1_ps(0.1f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 delta = _mm256_setzero_ps(), sum, centre, value, change;
+    __m256d wide = _mm256_setzero_pd();
+    float lanes[8];
+    double wide_lanes[4];
+    int j;
+
+    for (j = 1; j + 7 <= n; j += 8) {
+        centre = _mm256_loadu_ps(mid + j);
+        sum = _mm256_add_ps(
+            _mm256_loadu_ps(up + j - 1), _mm256_loadu_ps(up + j)
+        );
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(up + j + 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(mid + j - 1));
+        sum = _mm256_add_ps(sum, _mm256_add_ps(centre, centre));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(mid + j + 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(down + j - 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(down + j));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(down + j + 1));
+        value = _mm256_mul_ps(weight, sum);
+        _mm256_storeu_ps(out + j, value);
+        if (measure == MEASURE_NONE)
+            continue;
+        change = _mm256_andnot_ps(sign, _mm256_sub_ps(value, centre));
+        if (measure == MEASURE_SINGLE) {
+            delta = _mm256_add_ps(delta, change);
+        } else {
+            wide = _mm256_add_pd(
+                wide, _mm256_cvtps_pd(_mm256_castps256_ps128(change))
+            );
+            wide = _mm256_add_pd(
+                wide, _mm256_cvtps_pd(_mm256_extractf128_ps(change, 1))
+            );
+        }
+    }
+    _mm256_storeu_ps(lanes, delta);
+    _mm256_storeu_pd(wide_lanes, wide);
+
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+        ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])) +
+        (wide_lanes[0] + wide_lanes[1]) + (wide_lanes[2] + wide_lanes[3]) +
+        stencil_row_float_scalar(
+            up + j - 1, mid + j - 1, down + j - 1, out + j - 1, n - j + 1,
+            measure
+        );
+}
+
+/**
+ * @brief AVX-512 row kernel of a single-precision plate, sixteen cells
+ * per instruction.
+ * @details See stencil_row_float_scalar for the arithmetic.
+ */
+__attribute__((target("avx512f")))
+double stencil_row_float_avx512(
+    const float * up, const float * mid, const float * down,
+    float * out, int n, int measure
+) {
+    const __m512 weight = _mm512_set1_ps(0.1f);
+    __m512 delta = _mm512_setzero_ps(), sum, centre, value, change;
+    __m512d wide = _mm512_setzero_pd();
+    int j;
+
+    for (j = 1; j + 15 <= n; j += 16) {
+        centre = _mm512_loadu_ps(mid + j);
+        sum = _mm512_add_ps(
+            _mm512_loadu_ps(up + j - 1), _mm512_loadu_ps(up + j)
+        );
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(up + j + 1));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(mid + j - 1));
+        sum = _mm512_add_ps(sum, _mm512_add_ps(centre, centre));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(mid + j + 1));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(down + j - 1));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(down + j));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(down + j + 1));
+        value = _mm512_mul_ps(weight, sum);
+        _mm512_storeu_ps(out + j, value);
+        if (measure == MEASURE_NONE)
+            continue;
+        change = _mm512_abs_ps(_mm512_sub_ps(value, centre));
+        if (measure == MEASURE_SINGLE) {
+            delta = _mm512_add_ps(delta, change);
+        } else {
+            wide = _mm512_add_pd(
+                wide, _mm512_cvtps_pd(_mm512_castps512_ps256(change))
+            );
+            wide = _mm512_add_pd(wide, _mm512_cvtps_pd(_mm256_castpd_ps(
+                _mm512_extractf64x4_pd(_mm512_castps_pd(change), 1)
+            )));
+        }
+    }
+
+    return _mm512_reduce_add_ps(delta) + _mm512_reduce_add_pd(wide) +
+        stencil_row_float_scalar(
+            up + j - 1, mid + j - 1, down + j - 1, out + j - 1, n - j + 1,
+            measure
+        );
+}
+
+/**
+ * @brief SSE2 row kernel of an ensemble, two lanes per instruction.
+ * @details See ensemble_row_scalar.
+ */
+__attribute__((target("sse2")))
+void ensemble_row_sse2(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int width, const double * mask, double * change
+) {
+    const __m128d weight = _mm_set1_pd(0.1);
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const size_t w = width;
+    __m128d sum, centre, value, keep;
+    size_t c;
+    int j, m;
+
+    if (change != NULL) {
+        for (m = 0; m < width; m++) {
+            change[m] = 0;
+        }
+    }
+    for (j = 1; j <= n; j++) {
+        for (m = 0; m < width; m += 2) {
+            c = j * w + m;
+            centre = _mm_loadu_pd(mid + c);
+            sum = _mm_add_pd(_mm_loadu_pd(up + c - w), _mm_loadu_pd(up + c));
+            sum = _mm_add_pd(sum, _mm_loadu_pd(up + c + w));
+            sum = _mm_add_pd(sum, _mm_loadu_pd(mid + c - w));
+            sum = _mm_add_pd(sum, _mm_add_pd(centre, centre));
+            sum = _mm_add_pd(sum, _mm_loadu_pd(mid + c + w));
+            sum = _mm_add_pd(sum, _mm_loadu_pd(down + c - w));
+            sum = _mm_add_pd(sum, _mm_loadu_pd(down + c));
+            sum = _mm_add_pd(sum, _mm_loadu_pd(down + c + w));
+            value = _mm_mul_pd(weight, sum);
+            keep = _mm_loadu_pd(mask + m);
+            value = _mm_or_pd(
+                _mm_and_pd(keep, value), _mm_andnot_pd(keep, centre)
+            );
+            _mm_storeu_pd(out + c, value);
+            if (change != NULL)
+                _mm_storeu_pd(change + m, _mm_add_pd(
+                    _mm_loadu_pd(change + m),
+                    _mm_andnot_pd(sign, _mm_sub_pd(value, centre))
+                ));
+        }
+    }
+
+    return;
+}
+
+/**
+ * @brief AVX2 row kernel of an ensemble, four lanes per instruction.
+ * @details See ensemble_row_scalar.
+ */
+__attribute__((target("avx2")))
+void ensemble_row_avx2(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int width, const double * mask, double * change
+) {
+    const __m256d weight = _mm256_set1_pd(0.1);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const size_t w = width;
+    __m256d sum, centre, value, keep;
+    size_t c;
+    int j, m;
+
+    if (change != NULL) {
+        for (m = 0; m < width; m++) {
+            change[m] = 0;
+        }
+    }
+    for (j = 1; j <= n; j++) {
+        for (m = 0; m < width; m += 4) {
+            c = j * w + m;
+            centre = _mm256_loadu_pd(mid + c);
+            sum = _mm256_add_pd(
+                _mm256_loadu_pd(up + c - w), _mm256_loadu_pd(up + c)
+            );
+            sum = _mm256_add_pd(sum, _mm256_loadu_pd(up + c + w));
+            sum = _mm256_add_pd(sum, _mm256_loadu_pd(mid + c - w));
+            sum = _mm256_add_pd(sum, _mm256_add_pd(centre, centre));
+            sum = _mm256_add_pd(sum, _mm256_loadu_pd(mid + c + w));
+            sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + c - w));
+            sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + c));
+            sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + c + w));
+            value = _mm256_mul_pd(weight, sum);
+            keep = _mm256_loadu_pd(mask + m);
+            value = _mm256_or_pd(
+                _mm256_and_pd(keep, value), _mm256_andnot_pd(keep, centre)
+            );
+            _mm256_storeu_pd(out + c, value);
+            if (change != NULL)
+                _mm256_storeu_pd(change + m, _mm256_add_pd(
+                    _mm256_loadu_pd(change + m),
+                    _mm256_andnot_pd(sign, _mm256_sub_pd(value, centre))
+                ));
+        }
+    }
+
+    return;
+}
+
+/**
+ * @brief AVX-512 row kernel of an ensemble, eight lanes per instruction.
+ * @details See ensemble_row_scalar. Every cell is one aligned cache line
+ * per group of eight members.
+ */
+__attribute__((target("avx512f")))
+void ensemble_row_avx512(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int width, const double * mask, double * change
+) {
+    const __m512d weight = _mm512_set1_pd(0.1);
+    const size_t w = width;
+    __m512d sum, centre, value;
+    __mmask8 keep;
+    size_t c;
+    int j, m;
+
+    if (change != NULL) {
+        for (m = 0; m < width; m++) {
+            change[m] = 0;
+        }
+    }
+    for (j = 1; j <= n; j++) {
+        for (m = 0; m < width; m += 8) {
+            c = j * w + m;
+            centre = _mm512_load_pd(mid + c);
+            sum = _mm512_add_pd(
+                _mm512_load_pd(up + c - w), _mm512_load_pd(up + c)
+            );
+            sum = _mm512_add_pd(sum, _mm512_load_pd(up + c + w));
+            sum = _mm512_add_pd(sum, _mm512_load_pd(mid + c - w));
+            sum = _mm512_add_pd(sum, _mm512_add_pd(centre, centre));
+            sum = _mm512_add_pd(sum, _mm512_load_pd(mid + c + w));
+            sum = _mm512_add_pd(sum, _mm512_load_pd(down + c - w));
+            sum = _mm512_add_pd(sum, _mm512_load_pd(down + c));
+            sum = _mm512_add_pd(sum, _mm512_load_pd(down + c + w));
+            value = _mm512_mul_pd(weight, sum);
+            /*  A NaN is unordered with itself: those lanes are updated. */
+            keep = _mm512_cmp_pd_mask(
+                _mm512_loadu_pd(mask + m), _mm512_loadu_pd(mask + m),
+                _CMP_UNORD_Q
+            );
+            value = _mm512_mask_blend_pd(keep, centre, value);
+            _mm512_store_pd(out + c, value);
+            if (change != NULL)
+                _mm512_storeu_pd(change + m, _mm512_add_pd(
+                    _mm512_loadu_pd(change + m),
+                    _mm512_abs_pd(_mm512_sub_pd(value, centre))
+                ));
+        }
+    }
+
+    return;
+}
+#endif
@@ -0,0 +1,231 @@
+/*******************************************************************************
+ *                                                                             *
+ *  @file   plate_solver.h                                                     *
+ *  @author Christos Kaldis                                                    *
+ *  @date   17 Sept 2025                                                       *
+ *                                                                             *
+ *  @brief      The solver core shared by the plate heat simulation and        *
+ *              libplate.                                                      *
+ *  @details    The plate and its allocation, initialization and explicit      *
+ *  time step, and the row kernels of plate_solver.c. The simulation links     *
+ *  it into its program and libplate into the library, where everything but    *
+ *  the API of plate.h is hidden.                                              *
+ *                                                                             *
+ ******************************************************************************/
+
+#ifndef PLATE_SOLVER_H
+#define PLATE_SOLVER_H
+
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PLATE_X86_KERNELS
+#endif
+
+/*  Every row starts on a cache line boundary. The first interior cell of
+    each row (column 1) is the aligned one, so the row is shifted right
+    by PLATE_LEAD cells and the edge cell sits in the padding in front. */
+#define PLATE_ALIGN 64
+#define PLATE_LEAD ((int) (PLATE_ALIGN / sizeof(double)) - 1)
+
+/*  Size of a huge page, see --huge-pages. */
+#define HUGE_PAGE (2 << 20)
+
+/*  A rows x cols plate. The outer ring of cells holds the fixed edge
+    temperatures and is the halo of the interior. Explicit time steps need
+    two grids, one read and one written; `current` selects the grid
+    holding the latest state. In-place solvers use a single grid. */
+typedef struct plate_t {
+    int rows;
+    int cols;
+    int pitch;
+    int grids;
+    double * grid[2];
+    int current;
+    /*  Two per-row sums for --deterministic, see sum_partials. */
+    double * partial;
+    /*  Bytes of the mapping holding the grids, a file for
+        create_plate_mapped or explicit huge pages, or 0 if they are on
+        the heap. */
+    size_t mapped;
+} Plate_t;
+
+/*  The edge temperatures of a plate and the starting temperature of its
+    interior. The corners are the average of their two edges. A volume
+    also has a front and a back face (layers 0 and layers - 1), and a cell
+    on several faces gets the average of their temperatures. */
+typedef struct boundary_t {
+    double top;
+    double bottom;
+    double left;
+    double right;
+    double inner;
+    double front;
+    double back;
+} Boundary_t;
+
+/*  Who first writes a new plate, and so on which NUMA node its pages
+    land. PLACEMENT_FIRST_TOUCH has every thread write the rows it steps,
+    PLACEMENT_SERIAL writes the whole plate from the main thread. */
+typedef enum placement_t {
+    PLACEMENT_FIRST_TOUCH,
+    PLACEMENT_SERIAL
+} Placement_t;
+
+/*  Pages the grids of a plate are allocated in. HUGE_PAGES_EXPLICIT needs
+    2 MB pages reserved in /proc/sys/vm/nr_hugepages. */
+typedef enum huge_pages_t {
+    HUGE_PAGES_NONE,
+    HUGE_PAGES_TRANSPARENT,
+    HUGE_PAGES_EXPLICIT
+} Huge_pages_t;
+
+/*  How a single-precision row kernel sums the change: not at all, in
+    float or in double. */
+#define MEASURE_NONE 0
+#define MEASURE_SINGLE 1
+#define MEASURE_DOUBLE 2
+
+/*  Updates cells 1 .. n of one row from the rows above, at and below it.
+    If measure is non-zero it returns the sum of the absolute changes,
+    otherwise 0 without computing them. */
+typedef double (* Row_kernel_t)(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int measure
+);
+
+/*  The same for a single-precision plate. measure is one of MEASURE_*;
+    the row's sum is returned as a double either way. */
+typedef double (* Row_kernel_float_t)(
+    const float * up, const float * mid, const float * down,
+    float * out, int n, int measure
+);
+
+/*  Updates cells 1 .. n of one row of an ensemble, width lanes per cell.
+    Lanes whose mask is +0.0 keep their value. If change is not NULL it
+    receives the sum of the absolute changes of every lane. */
+typedef void (* Ensemble_kernel_t)(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int width, const double * mask, double * change
+);
+
+typedef struct kernel_t {
+    const char * name;
+    const char * cpu_feature;
+    Row_kernel_t run;
+    Row_kernel_float_t run_float;
+    Ensemble_kernel_t run_ensemble;
+} Kernel_t;
+
+#ifdef PLATE_TRACE
+/*  The parts of a run make TRACE=1 times. */
+typedef enum phase_t {
+    PHASE_STENCIL,
+    PHASE_REDUCTION,
+    PHASE_COPY,
+    PHASE_NORMALIZE,
+    PHASE_HISTOGRAM,
+    PHASE_OUTPUT,
+    PHASE_COUNT
+} Phase_t;
+#endif
+
+/*  Row kernels, best first, and how many there are. */
+extern const Kernel_t kernels[];
+extern const int kernel_count;
+
+/*  The row kernels calc_temp, stencil_step_float and ensemble_step use,
+    see select_kernel. */
+extern Row_kernel_t row_kernel;
+extern Row_kernel_float_t row_kernel_float;
+extern Ensemble_kernel_t ensemble_kernel;
+
+/*  --deterministic, --placement and --huge-pages. */
+extern int deterministic;
+extern Placement_t placement;
+extern Huge_pages_t huge_pages;
+
+int create_plate(Plate_t * plate, int rows, int cols, int grids);
+void * allocate_grids(size_t * bytes, size_t * mapped);
+void destroy_plate(Plate_t * plate);
+double * plate_data(const Plate_t * plate);
+double * plate_back(const Plate_t * plate);
+void swap_plate(Plate_t * plate);
+void init_plate(Plate_t * plate, const Boundary_t * boundary);
+void init_row_plate(
+    Plate_t * plate, int row_index,
+    double left_edge_temp, double inner_temp, double right_edge_temp
+);
+double calc_temp(Plate_t * plate);
+double stencil_step(Plate_t * plate, int measure);
+double sum_partials(const double * partial, int count);
+int select_kernel(const char * name);
+int cpu_has_feature(const char * feature);
+double stencil_row_scalar(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int measure
+);
+double stencil_row_float_scalar(
+    const float * up, const float * mid, const float * down,
+    float * out, int n, int measure
+);
+void ensemble_row_scalar(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int width, const double * mask, double * change
+);
+#ifdef PLATE_X86_KERNELS
+double stencil_row_sse2(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int measure
+);
+double stencil_row_avx2(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int measure
+);
+double stencil_row_avx512(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int measure
+);
+double stencil_row_float_sse2(
+    const float * up, const float * mid, const float * down,
+    float * out, int n, int measure
+);
+double stencil_row_float_avx2(
+    const float * up, const float * mid, const float * down,
+    float * out, int n, int measure
+);
+double stencil_row_float_avx512(
+    const float * up, const float * mid, const float * down,
+    float * out, int n, int measure
+);
+void ensemble_row_sse2(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int width, const double * mask, double * change
+);
+void ensemble_row_avx2(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int width, const double * mask, double * change
+);
+void ensemble_row_avx512(
+    const double * up, const double * mid, const double * down,
+    double * out, int n, int width, const double * mask, double * change
+);
+#endif
+#ifdef PLATE_TRACE
+/*  The tracer of the simulation, see trace_record. */
+long long trace_now(void);
+void trace_record(Phase_t phase, long long start);
+
+/*  TRACE_START(name) declares name as the time a phase starts and
+    TRACE_STOP(phase, name) records the phase from then to now in the
+    calling thread's ring. They wrap whole calls, parallel loops
+    included, so they time the phases as the calling thread sees them.
+    Without make TRACE=1 both compile to nothing. */
+#define TRACE_START(name) const long long name = trace_now()
+#define TRACE_STOP(phase, name) trace_record(phase, name)
+#else
+#define TRACE_START(name)
+#define TRACE_STOP(phase, name)
+#endif
+
+#endif